@@ -0,0 +1,130 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <map>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "toolslib/files/AsyncIO.h"
+#include "toolslib/files/HandleFile.h"
+#include "toolslib/files/MemoryFile.h"
+
+using namespace std;
+using namespace toolslib;
+using namespace toolslib::files;
+
+namespace
+{
+	class TAsyncIO
+	: public ::testing::Test
+	{
+	public:
+		TAsyncIO()
+		: m_filename("asyncio_test.tmp")
+		, m_data(300000)
+		{
+			for(size_t i = 0; i < m_data.size(); i++)
+				m_data[i] = (char)(i * 3);
+		}
+
+		void SetUp() override
+		{
+			HandleFile file(m_filename);
+			IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+			ASSERT_TRUE(file.open(md));
+			ASSERT_EQ((int64_t)m_data.size(), file.write(&m_data[0], m_data.size()));
+		}
+
+		void TearDown() override
+		{
+			remove(m_filename.c_str());
+		}
+
+		/**
+		 * Reads the file in blocks through several files at once, and the tail with a
+		 * request which goes beyond the end.
+		 */
+		void readBlocks(AsyncIO &oAsync)
+		{
+			const int64_t block = 10000;
+
+			vector<unique_ptr<HandleFile>> files;
+			for(int i = 0; i < 4; i++)
+			{
+				files.emplace_back(new HandleFile(m_filename));
+				ASSERT_TRUE(files.back()->open(IFile::open_default));
+			}
+
+			MemoryFile memory;
+			memory.adopt(vector<uint8_t>(m_data.begin(), m_data.end()));
+			ASSERT_TRUE(memory.open(IFile::open_default));
+
+			vector<char> buffer(m_data.size() + block);
+			vector<char> memoryBuffer(100);
+			map<AsyncIO::token_t, int64_t> expected;
+			for(int64_t offset = 0; offset < (int64_t)m_data.size(); offset += block)
+			{
+				IFile &file = *files[(size_t)(offset / block) % files.size()];
+				int64_t len = (offset + block < (int64_t)m_data.size()) ? block : block * 2;
+				expected[oAsync.submitRead(file, offset, &buffer[(size_t)offset], len)] = min(len, (int64_t)m_data.size() - offset);
+			}
+
+			AsyncIO::token_t token = oAsync.submitRead(memory, 1000, &memoryBuffer[0], memoryBuffer.size());
+			EXPECT_EQ((int64_t)memoryBuffer.size(), oAsync.wait(token));
+			EXPECT_TRUE(equal(memoryBuffer.begin(), memoryBuffer.end(), m_data.begin() + 1000));
+
+			AsyncIO::completion_t completions[8];
+			while(oAsync.getPending())
+			{
+				size_t n = oAsync.wait(completions, 8);
+				ASSERT_GT(n, 0u);
+				for(size_t i = 0; i < n; i++)
+				{
+					EXPECT_EQ(expected[completions[i].Token], completions[i].Result);
+					expected.erase(completions[i].Token);
+				}
+			}
+
+			EXPECT_TRUE(expected.empty());
+			EXPECT_TRUE(equal(m_data.begin(), m_data.end(), buffer.begin()));
+		}
+
+		string m_filename;
+		vector<char> m_data;
+	};
+
+	TEST_F(TAsyncIO, KernelQueue)
+	{
+		AsyncIO async(8);
+		readBlocks(async);
+	}
+
+	TEST_F(TAsyncIO, ThreadPool)
+	{
+		AsyncIO async(8, 3, false);
+		EXPECT_FALSE(async.isKernelQueue());
+		readBlocks(async);
+	}
+
+	TEST_F(TAsyncIO, Write)
+	{
+		HandleFile file(m_filename);
+		IFile::open_mode md = { true,	true,	true,	false,	false,   false };
+		ASSERT_TRUE(file.open(md));
+
+		vector<char> patch(5000, 'x');
+		{
+			AsyncIO async;
+			async.submitWrite(file, 1000, &patch[0], patch.size());
+			async.submitWrite(file, 200000, &patch[0], patch.size());
+			// The destructor waits for both.
+		}
+
+		vector<char> buffer(patch.size());
+		EXPECT_EQ((int64_t)buffer.size(), file.readAt(200000, &buffer[0], buffer.size()));
+		EXPECT_EQ(patch, buffer);
+		EXPECT_EQ((int64_t)buffer.size(), file.readAt(1000, &buffer[0], buffer.size()));
+		EXPECT_EQ(patch, buffer);
+	}
+}
@@ -0,0 +1,104 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <cstdint>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "toolslib/files/BufferPool.h"
+#include "toolslib/files/MemoryFile.h"
+
+using namespace std;
+using namespace toolslib;
+using namespace toolslib::files;
+
+namespace
+{
+	class TBufferPool
+	: public ::testing::Test
+	{
+	public:
+		TBufferPool()
+		: m_pool(1024*1024)
+		{
+		}
+
+	protected:
+		BufferPool m_pool;
+	};
+
+	class RecordingPool
+	: public BufferPool
+	{
+	public:
+		char *allocate(size_t nSize) override
+		{
+			Sizes.push_back(nSize);
+			return BufferPool::allocate(nSize);
+		}
+
+		vector<size_t> Sizes;
+	};
+
+	TEST_F(TBufferPool, SizeClasses)
+	{
+		EXPECT_EQ(BufferPool::page_size, BufferPool::roundSize(1));
+		EXPECT_EQ(BufferPool::page_size, BufferPool::roundSize(BufferPool::page_size));
+		EXPECT_EQ(2*BufferPool::page_size, BufferPool::roundSize(BufferPool::page_size+32));
+		EXPECT_EQ(1024*1024u, BufferPool::roundSize(1000*1000));
+	}
+
+	TEST_F(TBufferPool, Reuse)
+	{
+		char *p = m_pool.allocate(100*1024);
+		ASSERT_NE(nullptr, p);
+		EXPECT_EQ(0u, (uintptr_t)p % BufferPool::page_size);
+
+		p[0] = 1;
+		p[100*1024-1] = 2;
+		m_pool.release(p, 100*1024);
+
+		// The same size class returns the recycled buffer.
+		char *q = m_pool.allocate(120*1024);
+		EXPECT_EQ(p, q);
+		m_pool.release(q, 120*1024);
+	}
+
+	TEST_F(TBufferPool, CacheLimit)
+	{
+		// Larger than the cache limit, so it is freed immediately.
+		size_t size = 16*1024*1024;
+		char *p = m_pool.allocate(size);
+		ASSERT_NE(nullptr, p);
+		EXPECT_EQ(0u, (uintptr_t)p % BufferPool::page_size);
+
+		m_pool.release(p, size);
+		EXPECT_EQ(0u, m_pool.getCachedBytes());
+
+		// Too large for any class.
+		size = 100*1024*1024;
+		p = m_pool.allocate(size);
+		ASSERT_NE(nullptr, p);
+		m_pool.release(p, size);
+		EXPECT_EQ(0u, m_pool.getCachedBytes());
+	}
+
+	TEST_F(TBufferPool, FileBuffers)
+	{
+		RecordingPool pool;
+		BufferPool::setDefault(&pool);
+
+		// A page sized buffer must stay in its class.
+		MemoryFile file;
+		file.setFileBufferSize(BufferPool::page_size);
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		EXPECT_TRUE(file.open(md));
+		file.close();
+
+		BufferPool::setDefault(NULL);
+
+		ASSERT_EQ(1u, pool.Sizes.size());
+		EXPECT_EQ(BufferPool::page_size, BufferPool::roundSize(pool.Sizes[0]));
+	}
+}
@@ -0,0 +1,93 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "toolslib/files/ByteStream.h"
+#include "toolslib/files/MemoryFile.h"
+
+using namespace std;
+using namespace toolslib;
+using namespace toolslib::files;
+
+namespace
+{
+	class TByteStream
+	: public ::testing::Test
+	{
+	public:
+		TByteStream()
+		{
+			for(size_t i = 0; i < 1000; i++)
+				m_data.push_back((char)(i % 253));
+
+			IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+			m_file.open(md);
+			m_file.write(&m_data[0], m_data.size());
+			m_file.seek(0, IFile::set);
+		}
+
+		vector<char> m_data;
+		MemoryFile m_file;
+	};
+
+	TEST_F(TByteStream, GetPeekUnget)
+	{
+		// A tiny buffer, so the refills happen all the time.
+		ByteStream stream(m_file, 7);
+
+		EXPECT_EQ(0, stream.peek());
+		EXPECT_FALSE(stream.unget());
+
+		for(size_t i = 0; i < m_data.size(); i++)
+		{
+			int c = stream.get();
+			ASSERT_EQ((unsigned char)m_data[i], c);
+
+			if(i % 5 == 4)
+			{
+				EXPECT_TRUE(stream.unget());
+				EXPECT_TRUE(stream.unget());
+				EXPECT_EQ((unsigned char)m_data[i - 1], stream.get());
+				EXPECT_EQ(c, stream.get());
+			}
+		}
+
+		EXPECT_FALSE(stream.isEOF());
+		EXPECT_EQ(EOF, stream.peek());
+		EXPECT_EQ(EOF, stream.get());
+		EXPECT_TRUE(stream.isEOF());
+		EXPECT_EQ((int64_t)m_data.size(), stream.tell());
+
+		EXPECT_TRUE(stream.unget());
+		EXPECT_EQ((unsigned char)m_data.back(), stream.get());
+	}
+
+	TEST_F(TByteStream, SkipReadSync)
+	{
+		ByteStream stream(m_file, 16);
+
+		EXPECT_EQ(3, stream.skip(3));
+		EXPECT_EQ(3, stream.get());
+		EXPECT_EQ(100, stream.skip(100));
+		EXPECT_EQ(104, stream.tell());
+		EXPECT_EQ(104, stream.get());
+
+		char buffer[200];
+		EXPECT_EQ(10, stream.read(buffer, 10));
+		EXPECT_EQ(0, memcmp(buffer, &m_data[105], 10));
+		EXPECT_EQ((int64_t)sizeof(buffer), stream.read(buffer, sizeof(buffer)));
+		EXPECT_EQ(0, memcmp(buffer, &m_data[115], sizeof(buffer)));
+
+		// Give the read ahead back, so the file continues where the stream is.
+		EXPECT_EQ((unsigned char)m_data[315], stream.get());
+		EXPECT_TRUE(stream.sync());
+		EXPECT_EQ(316, m_file.tell());
+
+		EXPECT_EQ(1000 - 316, stream.skip(2000));
+		EXPECT_EQ(EOF, stream.get());
+		EXPECT_TRUE(stream.isEOF());
+	}
+}
@@ -0,0 +1,90 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "toolslib/files/ChecksumFile.h"
+#include "toolslib/files/MemoryFile.h"
+
+using namespace std;
+using namespace toolslib;
+using namespace toolslib::files;
+
+namespace
+{
+	class TChecksumFile
+	: public ::testing::Test
+	{
+	public:
+		TChecksumFile()
+		: m_data(200000)
+		{
+			for(size_t i = 0; i < m_data.size(); i++)
+				m_data[i] = (char)((i * 31) ^ (i >> 7));
+		}
+
+	protected:
+		vector<char> m_data;
+	};
+}
+
+TEST_F(TChecksumFile, KnownValues)
+{
+	EXPECT_EQ(0xCBF43926u, Checksum::compute(Checksum::CS_CRC32, "123456789", 9));
+	EXPECT_EQ(0x11E60398u, Checksum::compute(Checksum::CS_ADLER32, "Wikipedia", 9));
+	EXPECT_EQ(0xEF46DB3751D8E999ull, Checksum::compute(Checksum::CS_XXH64, "", 0));
+	EXPECT_EQ(0x44BC2CF5AD770999ull, Checksum::compute(Checksum::CS_XXH64, "abc", 3));
+}
+
+TEST_F(TChecksumFile, Transfers)
+{
+	for(int i = 0; i < Checksum::CS_MAX; i++)
+	{
+		Checksum::Algorithm algorithm = (Checksum::Algorithm)i;
+		uint64_t expected = Checksum::compute(algorithm, &m_data[0], m_data.size());
+
+		MemoryFile memory;
+		ChecksumFile file(memory, algorithm);
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		ASSERT_TRUE(file.open(md));
+
+		// Odd sizes, so the stripes of XXH64 are split.
+		int64_t pos = 0;
+		int64_t size = (int64_t)m_data.size();
+		for(int64_t len = 1; pos < size; len = len * 3 + 1)
+		{
+			int64_t n = min(len, size - pos);
+			ASSERT_EQ(n, file.write(&m_data[(size_t)pos], n));
+			pos += n;
+		}
+
+		EXPECT_EQ(expected, file.getDigest());
+		EXPECT_EQ(size, file.getChecksum().getLength());
+
+		// Reading back with all kinds of operations.
+		file.seek(0, IFile::set);
+		file.reset();
+
+		vector<char> buffer(m_data.size());
+		ASSERT_EQ(1000, file.read(&buffer[0], 1000));
+		ASSERT_NE(EOF, file.getChar());
+
+		int64_t avail = 0;
+		ASSERT_NE(nullptr, file.peek(100, avail));
+		ASSERT_EQ(100, file.consume(100));
+
+		// Beyond the view the data is read.
+		EXPECT_EQ(50000, file.consume(50000));
+
+		IFile::buffer_span spans[2] = { { &buffer[0], 7 }, { &buffer[7], 20000 } };
+		EXPECT_EQ(20007, file.readv(spans, 2));
+
+		while(file.read(&buffer[0], 4096) > 0)
+			;
+
+		EXPECT_EQ(expected, file.getDigest());
+		EXPECT_EQ(size, file.getChecksum().getLength());
+	}
+}
@@ -0,0 +1,103 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "toolslib/files/Coroutines.h"
+
+// The test project is built as C++20, so the coroutines must not silently drop out.
+#if defined(_MSC_VER) && !defined(TOOLSLIB_COROUTINES)
+#error The coroutine tests need C++20 (LanguageStandard stdcpp20).
+#endif
+
+#ifdef TOOLSLIB_COROUTINES
+
+#include "toolslib/files/File.h"
+#include "toolslib/files/HandleFile.h"
+#include "toolslib/files/MemoryFile.h"
+
+using namespace std;
+using namespace toolslib;
+using namespace toolslib::files;
+
+namespace
+{
+	class TCoroutines
+	: public ::testing::Test
+	{
+	public:
+		TCoroutines()
+		: m_filename("coroutines_test.tmp")
+		, m_data(100000)
+		{
+			for(size_t i = 0; i < m_data.size(); i++)
+				m_data[i] = (char)(i * 7);
+		}
+
+		void SetUp() override
+		{
+			HandleFile file(m_filename);
+			IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+			ASSERT_TRUE(file.open(md));
+			ASSERT_EQ((int64_t)m_data.size(), file.write(&m_data[0], m_data.size()));
+		}
+
+		void TearDown() override
+		{
+			remove(m_filename.c_str());
+		}
+
+		static Task<int64_t> readAll(IFile &oFile, vector<char> &oData)
+		{
+			char buffer[3000];
+			int64_t rd;
+			while((rd = co_await readAsync(oFile, buffer, sizeof(buffer))) > 0)
+				oData.insert(oData.end(), buffer, buffer + rd);
+
+			co_return (int64_t)oData.size();
+		}
+
+		static Task<void> copy(IFile &oFile, vector<char> &oData, int64_t &nTotal)
+		{
+			nTotal = co_await readAll(oFile, oData);
+		}
+
+	protected:
+		string m_filename;
+		vector<char> m_data;
+	};
+}
+
+TEST_F(TCoroutines, ReadFiles)
+{
+	HandleFile handle(m_filename);
+	File file(m_filename);
+	MemoryFile memory(m_data.data(), (int64_t)m_data.size());
+	ASSERT_TRUE(handle.open(IFile::open_default));
+	ASSERT_TRUE(file.open(IFile::open_default));
+	ASSERT_TRUE(memory.open(IFile::open_default));
+
+	vector<char> data[3];
+	int64_t total[3] = { 0, 0, 0 };
+
+	IOExecutor executor;
+	executor.spawn(copy(handle, data[0], total[0]));
+	executor.spawn(copy(file, data[1], total[1]));
+	executor.spawn(copy(memory, data[2], total[2]));
+	executor.run();
+
+	EXPECT_EQ(nullptr, IOExecutor::current());
+	for(size_t i = 0; i < 3; i++)
+	{
+		EXPECT_EQ((int64_t)m_data.size(), total[i]);
+		EXPECT_TRUE(data[i] == m_data);
+	}
+
+	// The position follows the transfers.
+	EXPECT_EQ((int64_t)m_data.size(), handle.tell());
+	EXPECT_EQ((int64_t)m_data.size(), file.tell());
+}
+
+#endif // TOOLSLIB_COROUTINES
@@ -0,0 +1,151 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "toolslib/files/DirectFile.h"
+
+using namespace std;
+using namespace toolslib;
+using namespace toolslib::files;
+
+namespace
+{
+	class TDirectFile
+	: public ::testing::Test
+	{
+	public:
+		TDirectFile()
+		: m_filename("directfile_test.tmp")
+		{
+			m_file.setFilename(m_filename);
+		}
+
+		void TearDown() override
+		{
+			m_file.close();
+			remove(m_filename.c_str());
+		}
+
+		string m_filename;
+		DirectFile m_file;
+	};
+
+	TEST_F(TDirectFile, UnalignedTransfers)
+	{
+		// Small buffer, so the data spans several windows.
+		vector<char> data(50000);
+		for(size_t i = 0; i < data.size(); i++)
+			data[i] = (char)(i * 13);
+
+		m_file.setFileBufferSize(16*1024);
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		EXPECT_TRUE(m_file.open(md));
+		EXPECT_EQ(3, m_file.write(&data[0], 3));
+		EXPECT_EQ((int64_t)data.size() - 3, m_file.write(&data[3], data.size() - 3));
+		EXPECT_EQ((int64_t)data.size(), m_file.length());
+		m_file.close();
+
+		// The padding of the last block must be cut off.
+		md = { true,	true,	true,	false,	false,   false };
+		EXPECT_TRUE(m_file.open(md));
+		EXPECT_EQ((int64_t)data.size(), m_file.length());
+
+		// Overwrite across a block boundary, without touching the neighbours.
+		vector<char> patch(5000, 'x');
+		EXPECT_EQ(4000, m_file.seek(4000, IFile::set));
+		EXPECT_EQ((int64_t)patch.size(), m_file.write(&patch[0], patch.size()));
+		copy(patch.begin(), patch.end(), data.begin() + 4000);
+
+		// Read back, partially from the modified window.
+		vector<char> buffer(data.size());
+		EXPECT_EQ(10, m_file.seek(10, IFile::set));
+		EXPECT_EQ((int64_t)data.size() - 10, m_file.read(&buffer[10], data.size()));
+		EXPECT_TRUE(m_file.isEOF());
+		EXPECT_EQ(0, m_file.seek(0, IFile::set));
+		EXPECT_EQ(10, m_file.read(&buffer[0], 10));
+		EXPECT_EQ(data, buffer);
+
+		// Extend behind the end with a gap.
+		EXPECT_EQ((int64_t)data.size() + 100, m_file.seek(-100, IFile::end));
+		EXPECT_EQ(1, m_file.write("z", 1));
+		m_file.close();
+
+		md = IFile::open_default;
+		EXPECT_TRUE(m_file.open(md));
+		EXPECT_EQ((int64_t)data.size() + 101, m_file.length());
+
+		buffer.resize(data.size() + 101);
+		EXPECT_EQ((int64_t)buffer.size(), m_file.read(&buffer[0], buffer.size() + 10));
+		EXPECT_TRUE(equal(data.begin(), data.end(), buffer.begin()));
+		EXPECT_EQ(0, buffer[data.size() + 50]);
+		EXPECT_EQ('z', buffer.back());
+	}
+
+#ifndef _WIN32
+	TEST_F(TDirectFile, WriteError)
+	{
+		// Every write to /dev/full fails with ENOSPC.
+		DirectFile file("/dev/full");
+		IFile::open_mode md = IFile::open_default;
+		md.read = false;
+		md.write = true;
+		ASSERT_TRUE(file.open(md));
+
+		EXPECT_EQ(4, file.write("data", 4));
+		EXPECT_FALSE(file.hasWriteError());
+		file.flush();
+		EXPECT_TRUE(file.hasWriteError());
+
+		// The data is kept, but nothing more is accepted.
+		EXPECT_EQ(invalid64_t, file.write("more", 4));
+		file.close();
+		EXPECT_TRUE(file.hasWriteError());
+
+		// The error is also reported if it only happens in close().
+		ASSERT_TRUE(file.open(md));
+		EXPECT_FALSE(file.hasWriteError());
+		EXPECT_EQ(4, file.write("data", 4));
+		file.close();
+		EXPECT_TRUE(file.hasWriteError());
+	}
+#endif
+
+#ifdef __linux__
+	TEST_F(TDirectFile, BufferedFallback)
+	{
+		// tmpfs supports O_DIRECT only since Linux 6.6, before that the file has to
+		// fall back to the cache.
+		string path = "/dev/shm/directfile_test.tmp";
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		sysio::handle_t probe = sysio::openFile(path, md, true);
+		bool direct = (probe != sysio::invalid_handle);
+		sysio::closeFile(probe);
+
+		vector<char> data(20000);
+		for(size_t i = 0; i < data.size(); i++)
+			data[i] = (char)(i * 7);
+
+		DirectFile file(path);
+		file.setFileBufferSize(16*1024);
+		ASSERT_TRUE(file.open(md));
+		EXPECT_EQ(direct, file.isUnbuffered());
+		EXPECT_EQ((int64_t)data.size(), file.write(&data[0], data.size()));
+		file.close();
+
+		md = IFile::open_default;
+		ASSERT_TRUE(file.open(md));
+		EXPECT_EQ(direct, file.isUnbuffered());
+		EXPECT_EQ((int64_t)data.size(), file.length());
+
+		vector<char> buffer(data.size());
+		EXPECT_EQ((int64_t)data.size(), file.read(&buffer[0], buffer.size() + 10));
+		EXPECT_EQ(data, buffer);
+		file.close();
+
+		remove(path.c_str());
+	}
+#endif
+}
@@ -0,0 +1,202 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <cstring>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "toolslib/files/File.h"
+
+using namespace std;
+using namespace toolslib;
+using namespace toolslib::files;
+
+namespace
+{
+	class TFile
+	: public ::testing::Test
+	{
+	public:
+		TFile()
+		: m_filename("file_test.tmp")
+		{
+			m_file.setFilename(m_filename);
+		}
+
+		void TearDown() override
+		{
+			m_file.close();
+			remove(m_filename.c_str());
+		}
+
+		string m_filename;
+		File m_file;
+	};
+
+	TEST_F(TFile, ReadAhead)
+	{
+		vector<uint32_t> data(300000);
+		for(size_t i = 0; i < data.size(); i++)
+			data[i] = (uint32_t)i;
+
+		int64_t size = (int64_t)(data.size() * sizeof(uint32_t));
+
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		EXPECT_TRUE(m_file.open(md));
+		EXPECT_EQ(size, m_file.write(&data[0], size));
+		m_file.close();
+
+		// Small chunks, so the consumer runs through the ring a few times.
+		md = IFile::open_default;
+		md.readahead = true;
+		m_file.setReadAhead(3, 64*1024);
+		EXPECT_TRUE(m_file.open(md));
+
+		vector<uint32_t> buffer(data.size());
+		char *p = (char *)&buffer[0];
+		EXPECT_EQ(10, m_file.read(p, 10));
+		EXPECT_EQ(10, m_file.tell());
+		EXPECT_EQ(size - 10, m_file.read(&p[10], size));
+		EXPECT_TRUE(m_file.isEOF());
+		EXPECT_EQ(data, buffer);
+		EXPECT_EQ(0, m_file.read(p, 1));
+
+		// Forward within the prefetched data and backwards again.
+		EXPECT_EQ(0, m_file.seek(400, IFile::set));
+		EXPECT_FALSE(m_file.isEOF());
+		uint32_t val;
+		EXPECT_EQ(4, m_file.read(&val, 4));
+		EXPECT_EQ(100u, val);
+		EXPECT_EQ(0, m_file.seek(396, IFile::cur));
+		EXPECT_EQ(4, m_file.read(&val, 4));
+		EXPECT_EQ(200u, val);
+		EXPECT_EQ(0, m_file.seek(-8, IFile::end));
+		EXPECT_EQ(4, m_file.read(&val, 4));
+		EXPECT_EQ(data[data.size() - 2], val);
+		EXPECT_EQ(0, m_file.seek(4, IFile::set));
+		EXPECT_EQ(1, m_file.getChar());
+	}
+
+	TEST_F(TFile, WriteBehind)
+	{
+		IFile::open_mode md = IFile::open_mode::init();
+		md.binary = true;
+		md.write = true;
+		md.create = true;
+		md.truncate = true;
+		md.writebehind = true;
+
+		// Small buffers, so the producer has to wait for the thread now and then.
+		m_file.setWriteBehind(2, 4096);
+		EXPECT_TRUE(m_file.open(md));
+
+		for(uint32_t i = 0; i < 100000; i++)
+			ASSERT_EQ(4, m_file.write(&i, sizeof(i)));
+
+		EXPECT_EQ(400000, m_file.tell());
+		EXPECT_EQ(400000, m_file.length());
+
+		// Overwrite a value, which is still pending.
+		uint32_t val = 0xffffffff;
+		EXPECT_EQ(0, m_file.seek(40, IFile::set));
+		EXPECT_EQ(4, m_file.write(&val, sizeof(val)));
+		m_file.close();
+		EXPECT_FALSE(m_file.hasWriteError());
+
+		EXPECT_TRUE(m_file.open(IFile::open_default));
+		vector<uint32_t> data(100000);
+		EXPECT_EQ(400000, m_file.read(&data[0], 400000));
+		for(uint32_t i = 0; i < 100000; i++)
+			ASSERT_EQ(i == 10 ? val : i, data[i]);
+	}
+
+	TEST_F(TFile, Consume)
+	{
+		vector<char> data(100000);
+		for(size_t i = 0; i < data.size(); i++)
+			data[i] = (char)(i % 251);
+
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		EXPECT_TRUE(m_file.open(md));
+		EXPECT_EQ((int64_t)data.size(), m_file.write(&data[0], (int64_t)data.size()));
+		m_file.close();
+
+		// The stream has no view, so only consume() works.
+		EXPECT_TRUE(m_file.open(IFile::open_default));
+		int64_t avail;
+		EXPECT_EQ(nullptr, m_file.peek(100, avail));
+		EXPECT_EQ(0, avail);
+
+		char c[10];
+		EXPECT_EQ(40000, m_file.consume(40000));
+		EXPECT_EQ(40000, m_file.tell());
+		EXPECT_EQ(10, m_file.read(c, sizeof(c)));
+		EXPECT_EQ(0, memcmp(c, &data[40000], sizeof(c)));
+		EXPECT_EQ((int64_t)data.size() - 40010, m_file.consume(1000000));
+		EXPECT_EQ(0, m_file.consume(1));
+		m_file.close();
+
+		md = IFile::open_mode::init();
+		md.read = true;
+		md.readahead = true;
+		m_file.setReadAhead(2, 4096);
+		EXPECT_TRUE(m_file.open(md));
+		EXPECT_EQ(50000, m_file.consume(50000));
+		EXPECT_EQ(10, m_file.read(c, sizeof(c)));
+		EXPECT_EQ(0, memcmp(c, &data[50000], sizeof(c)));
+	}
+
+	TEST_F(TFile, BufferSize)
+	{
+		vector<char> data(10000, 'x');
+
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		EXPECT_TRUE(m_file.open(md));
+		EXPECT_EQ((int64_t)data.size(), m_file.write(&data[0], (int64_t)data.size()));
+		m_file.close();
+
+		// The proposal for a small file which is only read, doesn't exceed the file.
+		EXPECT_TRUE(m_file.open(IFile::open_default));
+		EXPECT_GE(m_file.getFileBufferSize(), 4096u);
+		EXPECT_LE(m_file.getFileBufferSize(), 12288u);
+		m_file.close();
+
+		// A requested size is kept over open().
+		m_file.setFileBufferSize(100000);
+		EXPECT_TRUE(m_file.open(IFile::open_default));
+		EXPECT_EQ(100000u, m_file.getFileBufferSize());
+		vector<char> buffer(data.size());
+		EXPECT_EQ((int64_t)data.size(), m_file.read(&buffer[0], (int64_t)buffer.size()));
+		EXPECT_EQ(data, buffer);
+		m_file.close();
+
+		// The read ahead doesn't use the stream buffer, so it isn't enlarged.
+		m_file.setFileBufferSize();
+		md = IFile::open_mode::init();
+		md.read = true;
+		md.readahead = true;
+		EXPECT_TRUE(m_file.open(md));
+		EXPECT_EQ(4096u, m_file.getFileBufferSize());
+		EXPECT_EQ((int64_t)data.size(), m_file.read(&buffer[0], (int64_t)buffer.size()));
+		EXPECT_EQ(data, buffer);
+	}
+
+#ifndef _WIN32
+	TEST_F(TFile, WriteBehindError)
+	{
+		IFile::open_mode md = IFile::open_mode::init();
+		md.write = true;
+		md.writebehind = true;
+
+		File full("/dev/full");
+		EXPECT_TRUE(full.open(md));
+		EXPECT_EQ(10, full.write("0123456789", 10));
+
+		// The error is reported with a delay.
+		full.flush();
+		EXPECT_TRUE(full.hasWriteError());
+		EXPECT_EQ(invalid64_t, full.write("0123456789", 10));
+	}
+#endif
+}
@@ -1,9 +1,16 @@
 #define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
 #define _CRT_SECURE_NO_WARNINGS
 
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
 #include "gtest/gtest.h"
 
 #include "toolslib/files/FileFactory.h"
+#include "toolslib/files/HandleFile.h"
 
 using namespace std;
 using namespace toolslib;
@@ -16,7 +23,25 @@ namespace
 	, public ::testing::Test
 	{
 	public:
-		TFileFactory() {}
+		TFileFactory()
+		{
+			// Registers the supported containers.
+			FileFactory::getInstance();
+		}
+
+		static vector<char> readFile(string const &oFilename)
+		{
+			HandleFile file(oFilename);
+			vector<char> data;
+			if(!file.open(IFile::open_default))
+				return data;
+
+			data.resize((size_t)file.length());
+			if(!data.empty())
+				file.read(&data[0], data.size());
+
+			return data;
+		}
 	};
 
 	TEST_F(TFileFactory, BasicTests)
@@ -26,4 +51,62 @@ namespace
 		unique_ptr<IFile> file(getFile(filename));
 		ASSERT_NE(nullptr, file.get());
 	}
+
+	TEST_F(TFileFactory, Copy)
+	{
+		string source = "copy_source.tmp";
+		string target = "copy_target.tmp";
+		string compressed = "copy_target.tmp.gz";
+		string restored = "copy_restored.tmp";
+
+		// Data, a hole, more data and a hole at the end.
+		vector<char> data(100000);
+		for(size_t i = 0; i < data.size(); i++)
+			data[i] = (char)(i * 13);
+
+		{
+			HandleFile file(source);
+			IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+			ASSERT_TRUE(file.open(md));
+			ASSERT_EQ((int64_t)data.size(), file.writeAt(0, &data[0], data.size()));
+			ASSERT_EQ((int64_t)data.size(), file.writeAt(8*1024*1024, &data[0], data.size()));
+			ASSERT_TRUE(sysio::truncateFile(file.getNativeHandle(), 16*1024*1024));
+		}
+
+		vector<char> expected = readFile(source);
+		ASSERT_EQ((size_t)16*1024*1024, expected.size());
+
+		EXPECT_EQ((int64_t)expected.size(), copy(source, target));
+		EXPECT_TRUE(readFile(target) == expected);
+
+#ifndef _WIN32
+		// If the source is sparse, the copy has to be sparse as well.
+		struct stat st0;
+		struct stat st1;
+		ASSERT_EQ(0, stat(source.c_str(), &st0));
+		ASSERT_EQ(0, stat(target.c_str(), &st1));
+		if(st0.st_blocks * 512 < st0.st_size)
+		{
+			EXPECT_LT(st1.st_blocks * 512, st1.st_size);
+		}
+#endif
+
+		// Through the codec and back.
+		EXPECT_EQ((int64_t)expected.size(), copy(source, compressed));
+		EXPECT_LT(readFile(compressed).size(), expected.size());
+		EXPECT_EQ((int64_t)expected.size(), copy(compressed, restored));
+		EXPECT_TRUE(readFile(restored) == expected);
+
+		EXPECT_EQ(invalid64_t, copy(string("copy_missing.tmp"), target));
+
+		// A copy onto itself would truncate the source first.
+		EXPECT_EQ(invalid64_t, copy(source, source));
+		EXPECT_EQ(invalid64_t, copy(source, "./" + source));
+		EXPECT_TRUE(readFile(source) == expected);
+
+		remove(source.c_str());
+		remove(target.c_str());
+		remove(compressed.c_str());
+		remove(restored.c_str());
+	}
 }
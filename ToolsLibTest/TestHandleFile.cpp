@@ -0,0 +1,351 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "toolslib/files/HandleFile.h"
+
+using namespace std;
+using namespace toolslib;
+using namespace toolslib::files;
+
+namespace
+{
+	class THandleFile
+	: public ::testing::Test
+	{
+	public:
+		THandleFile()
+		: m_filename("handlefile_test.tmp")
+		{
+			m_file.setFilename(m_filename);
+		}
+
+		void TearDown() override
+		{
+			m_file.close();
+			remove(m_filename.c_str());
+		}
+
+		string m_filename;
+		HandleFile m_file;
+	};
+
+	TEST_F(THandleFile, BasicTests)
+	{
+		EXPECT_FALSE(m_file.isOpen());
+		EXPECT_EQ(invalid64_t, m_file.tell());
+		EXPECT_EQ(invalid64_t, m_file.length());
+
+		// Doesn't exist yet
+		EXPECT_FALSE(m_file.open());
+
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		EXPECT_TRUE(m_file.open(md));
+		EXPECT_EQ(0, m_file.length());
+		EXPECT_EQ(0, m_file.tell());
+	}
+
+	TEST_F(THandleFile, ReadWriteFile)
+	{
+		char buffer[32] = { 0 };
+		char cmp[32] = { 0 };
+
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		EXPECT_TRUE(m_file.open(md));
+
+		memset(cmp, 0xda, sizeof(cmp));
+		EXPECT_EQ((int64_t)sizeof(cmp), m_file.write(cmp, sizeof(cmp)));
+		EXPECT_EQ((int64_t)sizeof(cmp), m_file.length());
+
+		EXPECT_EQ(0, m_file.seek(0, IFile::set));
+		EXPECT_EQ((int64_t)sizeof(buffer), m_file.read(buffer, sizeof(buffer)));
+		EXPECT_FALSE(m_file.isEOF());
+		EXPECT_EQ(0, memcmp(buffer, cmp, sizeof(buffer)));
+
+		EXPECT_EQ(0, m_file.read(buffer, sizeof(buffer)));
+		EXPECT_TRUE(m_file.isEOF());
+
+		int32_t val = 0x1d1d1d1d;
+		EXPECT_EQ(14, m_file.seek(14, IFile::set));
+		EXPECT_EQ((int64_t)sizeof(val), m_file.write(&val, sizeof(val)));
+		memcpy(&cmp[14], &val, sizeof(val));
+
+		EXPECT_EQ(14, m_file.seek(14, IFile::set));
+		EXPECT_EQ(0x1d, m_file.getChar());
+		EXPECT_EQ(0, m_file.seek(0, IFile::set));
+		EXPECT_EQ((int64_t)sizeof(buffer), m_file.read(buffer, sizeof(buffer)));
+		EXPECT_EQ(0, memcmp(buffer, cmp, sizeof(buffer)));
+		EXPECT_EQ(EOF, m_file.getChar());
+	}
+
+	TEST_F(THandleFile, LargeTransfers)
+	{
+		// Larger than the buffer, so the data bypasses it.
+		vector<char> data(100000);
+		for(size_t i = 0; i < data.size(); i++)
+			data[i] = (char)i;
+
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		EXPECT_TRUE(m_file.open(md));
+		EXPECT_EQ((int64_t)data.size(), m_file.write(&data[0], data.size()));
+		m_file.close();
+
+		md = { true,	true,	false,	false,	false,   false };
+		EXPECT_TRUE(m_file.open(md));
+		EXPECT_EQ((int64_t)data.size(), m_file.length());
+
+		vector<char> buffer(data.size());
+		EXPECT_EQ(10, m_file.read(&buffer[0], 10));
+		EXPECT_EQ((int64_t)data.size() - 10, m_file.read(&buffer[10], data.size()));
+		EXPECT_TRUE(m_file.isEOF());
+		EXPECT_EQ(data, buffer);
+
+		EXPECT_EQ(invalid64_t, m_file.write(&data[0], 1));
+	}
+
+	TEST_F(THandleFile, PositionalTransfers)
+	{
+		vector<uint32_t> data(64*1024);
+		for(size_t i = 0; i < data.size(); i++)
+			data[i] = (uint32_t)i;
+
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		EXPECT_TRUE(m_file.open(md));
+		int64_t chunk = (data.size() / 4) * sizeof(uint32_t);
+		for(int i = 3; i >= 0; i--)
+			EXPECT_EQ(chunk, m_file.writeAt(i * chunk, (char *)&data[0] + i * chunk, chunk));
+
+		EXPECT_EQ(0, m_file.tell());
+		EXPECT_EQ(4 * chunk, m_file.length());
+
+		// Each thread reads its own range, without touching the file position.
+		vector<uint32_t> buffer(data.size());
+		vector<int64_t> result(4);
+		vector<thread> threads;
+		for(int i = 0; i < 4; i++)
+		{
+			threads.push_back(thread([&, i]()
+			{
+				result[i] = m_file.readAt(i * chunk, (char *)&buffer[0] + i * chunk, chunk);
+			}));
+		}
+
+		for(thread &t : threads)
+			t.join();
+
+		for(int i = 0; i < 4; i++)
+			EXPECT_EQ(chunk, result[i]);
+
+		EXPECT_EQ(data, buffer);
+		EXPECT_EQ(0, m_file.tell());
+		EXPECT_EQ(0, m_file.readAt(m_file.length(), &buffer[0], 1));
+
+		// Writers and readers in parallel, while the buffer holds the start of the file,
+		// which the first writer has to drop.
+		uint32_t first;
+		EXPECT_EQ(4, m_file.read(&first, sizeof(first)));
+		fill(buffer.begin(), buffer.end(), 0);
+		threads.clear();
+		for(int i = 0; i < 4; i++)
+		{
+			threads.push_back(thread([&, i]()
+			{
+				result[i] = m_file.writeAt(i * chunk, (char *)&data[0] + i * chunk, chunk);
+				if(result[i] == chunk)
+					result[i] = m_file.readAt(i * chunk, (char *)&buffer[0] + i * chunk, chunk);
+			}));
+		}
+
+		for(thread &t : threads)
+			t.join();
+
+		for(int i = 0; i < 4; i++)
+			EXPECT_EQ(chunk, result[i]);
+
+		EXPECT_EQ(data, buffer);
+		EXPECT_EQ(4, m_file.tell());
+	}
+
+	TEST_F(THandleFile, PositionalCoherence)
+	{
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		EXPECT_TRUE(m_file.open(md));
+
+		string data(100, 'a');
+		EXPECT_EQ(100, m_file.write(data.c_str(), 100));
+		m_file.flush();
+
+		// The buffer holds the data from the read, which must not hide the new one.
+		char buffer[4] = { 0 };
+		EXPECT_EQ(0, m_file.seek(0, IFile::set));
+		EXPECT_EQ(2, m_file.read(buffer, 2));
+		EXPECT_EQ(2, m_file.writeAt(20, "XX", 2));
+		EXPECT_EQ(20, m_file.seek(20, IFile::set));
+		EXPECT_EQ(2, m_file.read(buffer, 2));
+		EXPECT_EQ(0, memcmp(buffer, "XX", 2));
+
+		// Pending writes must not overwrite the new data when they are flushed, and
+		// readAt() must see them.
+		EXPECT_EQ(50, m_file.seek(50, IFile::set));
+		EXPECT_EQ(4, m_file.write("bbbb", 4));
+		EXPECT_EQ(2, m_file.writeAt(51, "ZZ", 2));
+		EXPECT_EQ(4, m_file.write("cccc", 4));
+		EXPECT_EQ(4, m_file.readAt(54, buffer, 4));
+		EXPECT_EQ(0, memcmp(buffer, "cccc", 4));
+		m_file.close();
+		EXPECT_FALSE(m_file.hasWriteError());
+
+		EXPECT_TRUE(m_file.open(IFile::open_default));
+		vector<char> content(100);
+		EXPECT_EQ(100, m_file.read(&content[0], 100));
+		EXPECT_EQ(0, memcmp(&content[20], "XX", 2));
+		EXPECT_EQ(0, memcmp(&content[50], "bZZbcccc", 8));
+	}
+
+#ifndef _WIN32
+	TEST_F(THandleFile, WriteError)
+	{
+		// Every write to /dev/full fails with ENOSPC.
+		HandleFile file("/dev/full");
+		IFile::open_mode md = IFile::open_default;
+		md.read = false;
+		md.write = true;
+		ASSERT_TRUE(file.open(md));
+
+		EXPECT_EQ(4, file.write("data", 4));
+		EXPECT_FALSE(file.hasWriteError());
+		file.flush();
+		EXPECT_TRUE(file.hasWriteError());
+
+		file.close();
+		EXPECT_TRUE(file.hasWriteError());
+
+		// The error is also reported if it only happens in close().
+		ASSERT_TRUE(file.open(md));
+		EXPECT_FALSE(file.hasWriteError());
+		EXPECT_EQ(4, file.write("data", 4));
+		file.close();
+		EXPECT_TRUE(file.hasWriteError());
+	}
+#endif
+
+	TEST_F(THandleFile, VectoredTransfers)
+	{
+		char header[8];
+		char trailer[4];
+		vector<char> payload(10000);
+
+		memset(header, 'h', sizeof(header));
+		memset(trailer, 't', sizeof(trailer));
+		memset(&payload[0], 'p', payload.size());
+
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		EXPECT_TRUE(m_file.open(md));
+
+		// A small record is buffered, the large one is written together with it.
+		IFile::const_buffer_span small[] = { { header, sizeof(header) }, { trailer, sizeof(trailer) } };
+		IFile::const_buffer_span large[] = { { header, sizeof(header) }, { &payload[0], (int64_t)payload.size() }, { trailer, sizeof(trailer) } };
+		int64_t largeSize = sizeof(header) + payload.size() + sizeof(trailer);
+
+		EXPECT_EQ(12, m_file.writev(small, 2));
+		EXPECT_EQ(largeSize, m_file.writev(large, 3));
+		EXPECT_EQ(12 + largeSize, m_file.tell());
+		EXPECT_EQ(12 + largeSize, m_file.length());
+
+		char h[8];
+		char t[4];
+		vector<char> p(payload.size());
+		IFile::buffer_span rsmall[] = { { h, sizeof(h) }, { t, sizeof(t) } };
+		IFile::buffer_span rlarge[] = { { h, sizeof(h) }, { &p[0], (int64_t)p.size() }, { t, sizeof(t) } };
+
+		EXPECT_EQ(0, m_file.seek(0, IFile::set));
+		EXPECT_EQ(12, m_file.readv(rsmall, 2));
+		EXPECT_EQ(0, memcmp(h, header, sizeof(h)));
+		EXPECT_EQ(0, memcmp(t, trailer, sizeof(t)));
+
+		EXPECT_EQ(largeSize, m_file.readv(rlarge, 3));
+		EXPECT_EQ(0, memcmp(h, header, sizeof(h)));
+		EXPECT_EQ(payload, p);
+		EXPECT_EQ(0, memcmp(t, trailer, sizeof(t)));
+
+		EXPECT_EQ(0, m_file.readv(rsmall, 2));
+		EXPECT_TRUE(m_file.isEOF());
+	}
+
+	TEST_F(THandleFile, PeekConsume)
+	{
+		vector<char> data(10000);
+		for(size_t i = 0; i < data.size(); i++)
+			data[i] = (char)(i % 251);
+
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		EXPECT_TRUE(m_file.open(md));
+		EXPECT_EQ((int64_t)data.size(), m_file.write(&data[0], data.size()));
+		EXPECT_EQ(0, m_file.seek(0, IFile::set));
+
+		// Walk through the file only with views into the buffer.
+		vector<char> result;
+		int64_t avail;
+		const char *p;
+		while((p = m_file.peek(100, avail)) != nullptr)
+		{
+			EXPECT_GE(avail, 1);
+			int64_t n = min(avail, (int64_t)77);
+			result.insert(result.end(), p, p + n);
+			EXPECT_EQ(n, m_file.consume(n));
+		}
+
+		EXPECT_EQ(data, result);
+		EXPECT_EQ((int64_t)data.size(), m_file.tell());
+		EXPECT_EQ(0, m_file.consume(1));
+
+		// Moves the position like seek(), so the EOF is cleared the same way.
+		EXPECT_EQ((int64_t)data.size() - 100, m_file.seek(-100, IFile::cur));
+		vector<char> buffer(200);
+		EXPECT_EQ(100, m_file.read(&buffer[0], (int64_t)buffer.size()));
+		EXPECT_TRUE(m_file.isEOF());
+		EXPECT_EQ(0, m_file.consume(1));
+		EXPECT_FALSE(m_file.isEOF());
+	}
+
+	TEST_F(THandleFile, AccessHints)
+	{
+		vector<char> data(100000);
+		for(size_t i = 0; i < data.size(); i++)
+			data[i] = (char)(i * 7);
+
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		md.sequential = true;
+		md.dontneed = true;
+		EXPECT_TRUE(m_file.open(md));
+		EXPECT_EQ((int64_t)data.size(), m_file.write(&data[0], data.size()));
+		m_file.close();
+
+		// The hints must never change what is read.
+		md = IFile::open_default;
+		md.dontneed = true;
+		md.willneed = true;
+		EXPECT_TRUE(m_file.open(md));
+
+		vector<char> buffer(data.size());
+		for(size_t i = 0; i < buffer.size(); i += 1000)
+			EXPECT_EQ(1000, m_file.read(&buffer[i], 1000));
+		EXPECT_EQ(data, buffer);
+		m_file.close();
+
+		md = IFile::open_default;
+		md.random = true;
+		EXPECT_TRUE(m_file.open(md));
+
+		char c;
+		EXPECT_EQ(1, m_file.readAt(54321, &c, 1));
+		EXPECT_EQ(data[54321], c);
+		EXPECT_EQ(12345, m_file.seek(12345, IFile::set));
+		EXPECT_EQ(1, m_file.read(&c, 1));
+		EXPECT_EQ(data[12345], c);
+	}
+}
@@ -0,0 +1,105 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "toolslib/files/File.h"
+#include "toolslib/files/LineReader.h"
+#include "toolslib/files/MemoryFile.h"
+
+using namespace std;
+using namespace toolslib;
+using namespace toolslib::files;
+
+namespace
+{
+	class TLineReader
+	: public ::testing::Test
+	{
+	public:
+		TLineReader()
+		{
+			// Short, empty and long lines, so the lines cross the buffers in all variations.
+			for (size_t i = 0; i < 500; i++)
+			{
+				string line(i * 7 % 300, (char)('a' + i % 26));
+				if (i % 3 == 0)
+					m_text += line + "\r\n";
+				else
+					m_text += line + "\n";
+
+				m_lines.push_back(line);
+			}
+
+			m_text += "last";
+			m_lines.push_back("last");
+		}
+
+		void readAll(IFile &oFile, size_t nBufferSize)
+		{
+			LineReader reader(oFile, true, nBufferSize);
+			vector<string> lines;
+			string_view line;
+
+			while (reader.readLine(line))
+				lines.push_back(string(line));
+
+			EXPECT_EQ(m_lines, lines);
+			EXPECT_EQ((int64_t)m_lines.size(), reader.getLineNumber());
+			EXPECT_FALSE(reader.readLine(line));
+		}
+
+		string m_text;
+		vector<string> m_lines;
+	};
+
+	TEST_F(TLineReader, MemoryViews)
+	{
+		MemoryFile file;
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		file.open(md);
+		file.write(m_text.c_str(), m_text.size());
+
+		file.seek(0, IFile::set);
+		readAll(file, 64);
+	}
+
+	TEST_F(TLineReader, BufferedFile)
+	{
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		File file("", tmpfile(), md);
+		file.write(m_text.c_str(), m_text.size());
+
+		// Smaller than the long lines, so the buffer has to grow.
+		file.seek(0, IFile::set);
+		readAll(file, 64);
+
+		file.seek(0, IFile::set);
+		readAll(file, LineReader::default_buffer_size);
+	}
+
+	TEST_F(TLineReader, ForEachLine)
+	{
+		MemoryFile file;
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		file.open(md);
+		file.write("one\r\ntwo\n\nfour\n", 15);
+		file.seek(0, IFile::set);
+
+		LineReader reader(file, false);
+		vector<string> lines;
+		EXPECT_EQ(3, reader.forEachLine([&](string_view oLine)
+		{
+			lines.push_back(string(oLine));
+			return lines.size() < 3;
+		}));
+
+		EXPECT_EQ("one\r", lines[0]);
+		EXPECT_EQ("two", lines[1]);
+		EXPECT_EQ("", lines[2]);
+		EXPECT_EQ(1, reader.forEachLine([](string_view) { return true; }));
+	}
+}
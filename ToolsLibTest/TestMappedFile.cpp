@@ -0,0 +1,116 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+#define _CRT_SECURE_NO_WARNINGS
+
+#include "gtest/gtest.h"
+
+#include "toolslib/files/MappedFile.h"
+
+using namespace std;
+using namespace toolslib;
+using namespace toolslib::files;
+
+namespace
+{
+	class TMappedFile
+	: public ::testing::Test
+	{
+	public:
+		TMappedFile()
+		: m_filename("mappedfile_test.tmp")
+		{
+		}
+
+		void TearDown() override
+		{
+			m_file.close();
+			remove(m_filename.c_str());
+		}
+
+		string m_filename;
+		MappedFile m_file;
+	};
+
+	TEST_F(TMappedFile, BasicTests)
+	{
+		m_file.setFilename(m_filename);
+
+		EXPECT_FALSE(m_file.isOpen());
+		EXPECT_EQ(invalid64_t, m_file.tell());
+		EXPECT_EQ(invalid64_t, m_file.length());
+
+		// Doesn't exist yet
+		EXPECT_FALSE(m_file.open());
+		EXPECT_FALSE(m_file.isOpen());
+
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		EXPECT_TRUE(m_file.open(md));
+		EXPECT_TRUE(m_file.isOpen());
+		EXPECT_EQ(0, m_file.length());
+		EXPECT_EQ(0, m_file.tell());
+		EXPECT_EQ(nullptr, m_file.getFileBuffer());
+	}
+
+	TEST_F(TMappedFile, ReadWriteFile)
+	{
+		char buffer[32] = { 0 };
+		char cmp[32] = { 0 };
+
+		m_file.setFilename(m_filename);
+
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		EXPECT_TRUE(m_file.open(md));
+
+		memset(cmp, 0xda, sizeof(cmp));
+		EXPECT_EQ((int64_t)sizeof(cmp), m_file.write(cmp, sizeof(cmp)));
+		EXPECT_EQ((int64_t)sizeof(cmp), m_file.length());
+		EXPECT_EQ((int64_t)sizeof(cmp), m_file.tell());
+
+		EXPECT_EQ(0, m_file.seek(0, IFile::set));
+		EXPECT_EQ((int64_t)sizeof(buffer), m_file.read(buffer, sizeof(buffer)));
+		EXPECT_FALSE(m_file.isEOF());
+		EXPECT_EQ(0, memcmp(buffer, cmp, sizeof(buffer)));
+
+		EXPECT_EQ(0, m_file.read(buffer, sizeof(buffer)));
+		EXPECT_TRUE(m_file.isEOF());
+
+		EXPECT_EQ(17, m_file.seek(-15, IFile::cur));
+		EXPECT_EQ(15, m_file.read(buffer, sizeof(buffer)));
+		EXPECT_EQ(31, m_file.seek(1, IFile::end));
+		EXPECT_EQ(0xda, m_file.getChar());
+		EXPECT_EQ(EOF, m_file.getChar());
+		m_file.close();
+
+		// The file is cut back to the written size, even though the mapping was larger.
+		md = { true,	true,	false,	false,	false,   false };
+		EXPECT_TRUE(m_file.open(md));
+		EXPECT_EQ((int64_t)sizeof(cmp), m_file.length());
+		EXPECT_EQ(sizeof(cmp), m_file.getFileBufferSize());
+		ASSERT_NE(nullptr, m_file.getFileBuffer());
+		EXPECT_EQ(0, memcmp(m_file.getFileBuffer(), cmp, sizeof(cmp)));
+
+		EXPECT_EQ(invalid64_t, m_file.write(cmp, sizeof(cmp)));
+		EXPECT_EQ(invalid64_t, m_file.seek(100, IFile::set));
+	}
+
+	TEST_F(TMappedFile, PositionalTransfers)
+	{
+		char buffer[32] = { 0 };
+
+		m_file.setFilename(m_filename);
+
+		IFile::open_mode md = { true,	true,	true,	false,	true,   true };
+		EXPECT_TRUE(m_file.open(md));
+
+		EXPECT_EQ(10, m_file.writeAt(100, "0123456789", 10));
+		EXPECT_EQ(110, m_file.length());
+		EXPECT_EQ(0, m_file.tell());
+		EXPECT_EQ(10, m_file.readAt(100, buffer, sizeof(buffer)));
+		EXPECT_EQ(0, memcmp(buffer, "0123456789", 10));
+		EXPECT_EQ(0, m_file.readAt(110, buffer, sizeof(buffer)));
+
+		// A negative length must never reach the copy.
+		EXPECT_EQ(invalid64_t, m_file.readAt(0, buffer, -1));
+		EXPECT_EQ(invalid64_t, m_file.writeAt(0, buffer, -1));
+		EXPECT_EQ(110, m_file.length());
+	}
+}
@@ -1,6 +1,10 @@
 #define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
 #define _CRT_SECURE_NO_WARNINGS
 
+#include <memory>
+#include <thread>
+#include <vector>
+
 #include "gtest/gtest.h"
 
 #include "toolslib/files/MemoryFile.h"
@@ -26,7 +30,7 @@ namespace
 
 		m_file.setFilename(file);
 
-		EXPECT_EQ(file, (string)m_file.getFilename());
+		EXPECT_EQ(file, m_file.getFilename().getOpenpath());
 		EXPECT_FALSE(m_file.isOpen());
 		EXPECT_TRUE(m_file.isEOF());
 		EXPECT_EQ(invalid64_t, m_file.tell());
@@ -160,4 +164,198 @@ namespace
 		EXPECT_EQ(invalid64_t, m_file.seek(100, IFile::end));
 		EXPECT_EQ(invalid64_t, m_file.seek(100, IFile::cur));
 	}
+
+	TEST_F(TMemoryFile, PositionalTransfers)
+	{
+		char buffer[32] = { 0 };
+		char cmp[32] = { 0 };
+
+		EXPECT_EQ(invalid64_t, m_file.readAt(0, buffer, sizeof(buffer)));
+
+		IFile::open_mode md = { true,	true,	true,	false,	false,   true };
+		EXPECT_TRUE(m_file.open(md));
+		memset(cmp, 0xda, sizeof(cmp));
+		EXPECT_EQ(16, m_file.writeAt(16, cmp, 16));
+		EXPECT_EQ(16, m_file.writeAt(0, cmp, 16));
+		EXPECT_EQ(0, m_file.tell());
+		EXPECT_EQ((int64_t)sizeof(cmp), m_file.length());
+
+		EXPECT_EQ(12, m_file.readAt(20, buffer, sizeof(buffer)));
+		EXPECT_EQ(0, memcmp(buffer, cmp, 12));
+		EXPECT_EQ(0, m_file.readAt(32, buffer, sizeof(buffer)));
+		EXPECT_EQ(invalid64_t, m_file.readAt(-1, buffer, sizeof(buffer)));
+		EXPECT_EQ(0, m_file.tell());
+	}
+
+	TEST_F(TMemoryFile, PeekConsume)
+	{
+		char cmp[32] = { 0 };
+		int64_t avail = -1;
+
+		EXPECT_EQ(nullptr, m_file.peek(1, avail));
+		EXPECT_EQ(0, avail);
+
+		IFile::open_mode md = { true,	true,	true,	false,	false,   true };
+		EXPECT_TRUE(m_file.open(md));
+		for(size_t i = 0; i < sizeof(cmp); i++)
+			cmp[i] = (char)i;
+		EXPECT_EQ((int64_t)sizeof(cmp), m_file.write(cmp, sizeof(cmp)));
+		EXPECT_EQ(0, m_file.seek(0, IFile::set));
+
+		const char *p = m_file.peek(4, avail);
+		ASSERT_NE(nullptr, p);
+		EXPECT_EQ((int64_t)sizeof(cmp), avail);
+		EXPECT_EQ(0, memcmp(p, cmp, sizeof(cmp)));
+		EXPECT_EQ(0, m_file.tell());
+
+		EXPECT_EQ(10, m_file.consume(10));
+		EXPECT_EQ(10, m_file.tell());
+		p = m_file.peek(4, avail);
+		ASSERT_NE(nullptr, p);
+		EXPECT_EQ(22, avail);
+		EXPECT_EQ(10, *p);
+
+		EXPECT_EQ(22, m_file.consume(100));
+		EXPECT_EQ(nullptr, m_file.peek(1, avail));
+		EXPECT_EQ(0, avail);
+	}
+
+	TEST_F(TMemoryFile, ChunkedStorage)
+	{
+		// Odd sized records, so they cross the chunk boundaries.
+		vector<char> record(99991);
+		for(size_t i = 0; i < record.size(); i++)
+			record[i] = (char)(i % 241);
+
+		IFile::open_mode md = { true,	true,	true,	false,	false,   true };
+		EXPECT_TRUE(m_file.open(md));
+		for(int i = 0; i < 30; i++)
+			EXPECT_EQ((int64_t)record.size(), m_file.write(&record[0], record.size()));
+
+		int64_t size = 30 * (int64_t)record.size();
+		EXPECT_EQ(size, m_file.length());
+
+		// A view never reaches beyond its segment.
+		int64_t avail;
+		EXPECT_EQ(MemoryFile::chunk_size - 10, m_file.seek(MemoryFile::chunk_size - 10, IFile::set));
+		const char *p = m_file.peek(100, avail);
+		ASSERT_NE(nullptr, p);
+		EXPECT_EQ(10, avail);
+
+		vector<char> buffer(record.size());
+		for(int i = 29; i >= 0; i--)
+		{
+			EXPECT_EQ((int64_t)buffer.size(), m_file.readAt(i * (int64_t)record.size(), &buffer[0], buffer.size()));
+			ASSERT_EQ(record, buffer);
+		}
+
+		const uint8_t *flat = m_file.contiguous();
+		for(int64_t i = 0; i < size; i++)
+			ASSERT_EQ((uint8_t)record[(size_t)(i % record.size())], flat[i]);
+
+		// Space after shrinking and growing again is cleared.
+		m_file.resize(100);
+		m_file.resize(3 * MemoryFile::chunk_size);
+		EXPECT_EQ(1, m_file.readAt(3 * MemoryFile::chunk_size - 1, &buffer[0], 10));
+		EXPECT_EQ(0, buffer[0]);
+		EXPECT_EQ(10, m_file.readAt(95, &buffer[0], 10));
+		EXPECT_EQ(0, memcmp(&buffer[0], &record[95], 5));
+		EXPECT_EQ(0, buffer[5]);
+	}
+
+	TEST_F(TMemoryFile, AdoptWrapRelease)
+	{
+		vector<uint8_t> data(1000);
+		for(size_t i = 0; i < data.size(); i++)
+			data[i] = (uint8_t)i;
+
+		vector<uint8_t> payload = data;
+		const uint8_t *p = &payload[0];
+
+		// The adopted memory is used directly and handed back without a copy.
+		MemoryFile adopted(move(payload));
+		EXPECT_TRUE(adopted.open());
+		EXPECT_EQ(1000, adopted.length());
+		EXPECT_EQ(p, adopted.contiguous());
+
+		vector<uint8_t> released = adopted.release();
+		EXPECT_EQ(p, &released[0]);
+		EXPECT_EQ(data, released);
+		EXPECT_EQ(0, adopted.length());
+
+		// A wrapped buffer is read only.
+		MemoryFile wrapped(&data[0], (int64_t)data.size());
+		IFile::open_mode md = { true,	true,	true,	false,	false,   false };
+		EXPECT_FALSE(wrapped.open(md));
+		EXPECT_TRUE(wrapped.open(IFile::open_default));
+		EXPECT_EQ(&data[0], wrapped.contiguous());
+
+		uint8_t buffer[10];
+		EXPECT_EQ(10, wrapped.readAt(500, buffer, sizeof(buffer)));
+		EXPECT_EQ(0, memcmp(buffer, &data[500], sizeof(buffer)));
+		EXPECT_EQ(invalid64_t, wrapped.write(buffer, sizeof(buffer)));
+
+		released = wrapped.release();
+		EXPECT_NE(&data[0], &released[0]);
+		EXPECT_EQ(data, released);
+		EXPECT_FALSE(wrapped.isWrapped());
+	}
+
+	TEST_F(TMemoryFile, Snapshots)
+	{
+		vector<char> data(3 * MemoryFile::chunk_size);
+		for(size_t i = 0; i < data.size(); i++)
+			data[i] = (char)(i % 239);
+
+		IFile::open_mode md = { true,	true,	true,	false,	false,   true };
+		EXPECT_TRUE(m_file.open(md));
+		EXPECT_EQ((int64_t)data.size(), m_file.write(&data[0], data.size()));
+
+		unique_ptr<MemoryFile> snapshot = m_file.snapshot();
+		EXPECT_TRUE(snapshot->isOpen());
+		EXPECT_TRUE(snapshot->isSnapshot());
+		EXPECT_EQ(0, snapshot->tell());
+		EXPECT_EQ((int64_t)data.size(), snapshot->length());
+		EXPECT_EQ(invalid64_t, snapshot->write("x", 1));
+
+		// The snapshot keeps the old content, while the original is modified.
+		char x[10];
+		memset(x, 'x', sizeof(x));
+		EXPECT_EQ(10, m_file.writeAt(5, x, sizeof(x)));
+		EXPECT_EQ(10, m_file.writeAt(MemoryFile::chunk_size * 2 - 5, x, sizeof(x)));
+		m_file.seek(0, IFile::end);
+		EXPECT_EQ(10, m_file.write(x, sizeof(x)));
+
+		vector<char> buffer(data.size() + 10);
+		EXPECT_EQ((int64_t)data.size(), snapshot->read(&buffer[0], buffer.size()));
+		buffer.resize(data.size());
+		EXPECT_EQ(data, buffer);
+
+		// Readers in other threads never see the writes of the original.
+		unique_ptr<MemoryFile> second = m_file.snapshot();
+		int64_t size = second->length();
+		vector<char> expected((size_t)size);
+		EXPECT_EQ(size, second->readAt(0, &expected[0], size));
+
+		bool equal = true;
+		thread reader([&]()
+		{
+			vector<char> content((size_t)size);
+			for(int i = 0; i < 10; i++)
+			{
+				second->seek(0, IFile::set);
+				equal = equal && second->read(&content[0], size) == size && content == expected;
+			}
+		});
+
+		for(int i = 0; i < 1000; i++)
+			m_file.writeAt((i * 7919) % size, "abcdefghij", 10);
+
+		reader.join();
+		EXPECT_TRUE(equal);
+
+		m_file.seek(0, IFile::set);
+		EXPECT_EQ(size, m_file.read(&buffer[0], size));
+		EXPECT_NE(0, memcmp(&buffer[0], &data[0], data.size()));
+	}
 }
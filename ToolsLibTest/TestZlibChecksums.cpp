@@ -0,0 +1,147 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include <zlib.h>
+
+#include "toolslib/utils/CPUFeatures.h"
+
+using namespace std;
+
+// Internals of the bundled zlib, to compare the accelerated versions against the
+// table implementations.
+extern "C"
+{
+	unsigned long crc32_generic(unsigned long crc, const unsigned char *buf, unsigned len);
+
+#ifdef TOOLSLIB_X86
+	extern int x86_cpu_has_pclmul;
+	extern int x86_cpu_has_ssse3;
+	extern int x86_cpu_has_avx2;
+	void cpu_check_features(void);
+#endif
+}
+
+namespace
+{
+	class TZlibChecksums
+	: public ::testing::Test
+	{
+	public:
+		TZlibChecksums()
+		: m_data(70000)
+		{
+			uint32_t x = 12345;
+			for(size_t i = 0; i < m_data.size(); i++)
+			{
+				x = x * 1103515245 + 12345;
+				m_data[i] = (unsigned char)(x >> 16);
+			}
+		}
+
+		/**
+		 * Compares all lengths up to 300 and some large ones, at all alignments.
+		 */
+		void compareCRC32(void)
+		{
+			const unsigned lengths[] = { 1000, 4095, 4096, 65536, 69000 };
+
+			for(unsigned offset = 0; offset < 16; offset++)
+			{
+				const unsigned char *p = &m_data[offset];
+				for(unsigned len = 0; len < 300; len++)
+					ASSERT_EQ(crc32_generic(0x1234567, p, len), zlib_crc32(0x1234567, p, len)) << "len " << len << " offset " << offset;
+
+				for(unsigned len : lengths)
+					ASSERT_EQ(crc32_generic(0, p, len), zlib_crc32(0, p, len)) << "len " << len << " offset " << offset;
+			}
+		}
+
+		/**
+		 * Returns the Adler-32 of all lengths up to 300 and some large ones, at all
+		 * alignments, for random data and for the worst case of 0xff bytes.
+		 */
+		vector<uLong> adler32All(void)
+		{
+			const unsigned lengths[] = { 1000, 5552, 5553, 65536, 69000 };
+			vector<unsigned char> ones(m_data.size(), 0xff);
+			vector<uLong> result;
+
+			for(unsigned offset = 0; offset < 16; offset++)
+			{
+				for(unsigned len = 0; len < 300; len++)
+					result.push_back(adler32(0x12345678, &m_data[offset], len));
+
+				for(unsigned len : lengths)
+				{
+					result.push_back(adler32(1, &m_data[offset], len));
+					result.push_back(adler32(0xfff0fff0, &ones[offset], len));
+				}
+			}
+
+			return result;
+		}
+
+	protected:
+		vector<unsigned char> m_data;
+	};
+}
+
+TEST_F(TZlibChecksums, CRC32)
+{
+	EXPECT_EQ(0xCBF43926u, zlib_crc32(0, (const Bytef *)"123456789", 9));
+
+	compareCRC32();
+
+#ifdef TOOLSLIB_X86
+	// Once more with the portable version.
+	cpu_check_features();
+	int pclmul = x86_cpu_has_pclmul;
+	x86_cpu_has_pclmul = 0;
+	compareCRC32();
+	x86_cpu_has_pclmul = pclmul;
+#endif
+}
+
+TEST_F(TZlibChecksums, CRC32Combine)
+{
+	const Bytef *p = &m_data[0];
+	uLong total = zlib_crc32(0, p, (uInt)m_data.size());
+
+	const uInt splits[] = { 0, 1, 7, 1000, 32768, 69999, 70000 };
+	for(uInt split : splits)
+	{
+		uLong crc1 = zlib_crc32(0, p, split);
+		uLong crc2 = zlib_crc32(0, p + split, (uInt)m_data.size() - split);
+		EXPECT_EQ(total, crc32_combine(crc1, crc2, (z_off_t)(m_data.size() - split))) << "split " << split;
+	}
+}
+
+TEST_F(TZlibChecksums, Adler32)
+{
+	EXPECT_EQ(0x11E60398u, adler32(1, (const Bytef *)"Wikipedia", 9));
+
+	vector<uLong> simd = adler32All();
+
+#ifdef TOOLSLIB_X86
+	// The same with the scalar version.
+	cpu_check_features();
+	int ssse3 = x86_cpu_has_ssse3;
+	int avx2 = x86_cpu_has_avx2;
+
+	x86_cpu_has_avx2 = 0;
+	vector<uLong> sse = adler32All();
+
+	x86_cpu_has_ssse3 = 0;
+	vector<uLong> scalar = adler32All();
+
+	x86_cpu_has_ssse3 = ssse3;
+	x86_cpu_has_avx2 = avx2;
+
+	EXPECT_TRUE(simd == scalar);
+	EXPECT_TRUE(sse == scalar);
+#endif
+}
@@ -0,0 +1,232 @@
+#define _SILENCE_TR1_NAMESPACE_DEPRECATION_WARNING
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include <zlib.h>
+
+#include "toolslib/utils/CPUFeatures.h"
+
+using namespace std;
+
+// Internals of the bundled zlib, to force the portable code paths.
+#ifdef TOOLSLIB_X86
+extern "C"
+{
+	extern int x86_cpu_has_sse42;
+	extern int x86_cpu_has_avx2;
+	void cpu_check_features(void);
+}
+#endif
+
+namespace
+{
+	class TZlibCompression
+	: public ::testing::Test
+	{
+	public:
+		TZlibCompression()
+		{
+			// Words, long runs and some noise, so there are matches of all lengths.
+			const char *words[] = { "file", "buffer", "stream", "deflate", "match", "window", "toolslib", " ", "\n" };
+			uint32_t x = 4711;
+			while(m_data.size() < 300000)
+			{
+				x = x * 1103515245 + 12345;
+				uint32_t r = x >> 16;
+				if(r % 97 == 0)
+					m_data.append(300 + r % 200, (char)r);
+				else if(r % 13 == 0)
+					m_data.push_back((char)(r >> 3));
+				else
+					m_data.append(words[r % (sizeof(words) / sizeof(words[0]))]);
+			}
+		}
+
+		static vector<Bytef> compress(string const &oData, int nLevel, int nStrategy = Z_DEFAULT_STRATEGY, int nWindowBits = 15)
+		{
+			z_stream strm = {};
+			EXPECT_EQ(Z_OK, deflateInit2(&strm, nLevel, Z_DEFLATED, nWindowBits, 8, nStrategy));
+
+			vector<Bytef> out(deflateBound(&strm, (uLong)oData.size()));
+			strm.next_in = (Bytef *)oData.data();
+			strm.avail_in = (uInt)oData.size();
+			strm.next_out = &out[0];
+			strm.avail_out = (uInt)out.size();
+			EXPECT_EQ(Z_STREAM_END, deflate(&strm, Z_FINISH));
+
+			out.resize(strm.total_out);
+			deflateEnd(&strm);
+
+			return out;
+		}
+
+		static string uncompress(vector<Bytef> const &oData, size_t nLength)
+		{
+			string out(nLength, 0);
+			uLongf len = (uLongf)out.size();
+			EXPECT_EQ(Z_OK, ::uncompress((Bytef *)&out[0], &len, &oData[0], (uLong)oData.size()));
+			out.resize(len);
+
+			return out;
+		}
+
+		/**
+		 * Inflates with the input and output handed over in pieces of the given sizes, so
+		 * matches are copied across the window and the ends of the buffers.
+		 */
+		static string inflateChunked(vector<Bytef> const &oData, size_t nInput, size_t nOutput, int nWindowBits = 15)
+		{
+			z_stream strm = {};
+			EXPECT_EQ(Z_OK, inflateInit2(&strm, nWindowBits));
+
+			string out;
+			vector<Bytef> buffer(nOutput);
+			size_t pos = 0;
+			int rc = Z_OK;
+			while(rc == Z_OK)
+			{
+				size_t n = min(nInput, oData.size() - pos);
+				strm.next_in = (Bytef *)&oData[pos];
+				strm.avail_in = (uInt)n;
+				strm.next_out = &buffer[0];
+				strm.avail_out = (uInt)buffer.size();
+
+				rc = inflate(&strm, Z_NO_FLUSH);
+				pos += n - strm.avail_in;
+				out.append((char *)&buffer[0], buffer.size() - strm.avail_out);
+				if(rc == Z_BUF_ERROR && pos < oData.size())
+					rc = Z_OK;
+			}
+			EXPECT_EQ(Z_STREAM_END, rc);
+			inflateEnd(&strm);
+
+			return out;
+		}
+
+	protected:
+		string m_data;
+	};
+}
+
+TEST_F(TZlibCompression, MatchVersions)
+{
+	const int levels[] = { 1, 4, 6, 9 };
+	for(int level : levels)
+	{
+		vector<Bytef> simd = compress(m_data, level);
+		EXPECT_TRUE(uncompress(simd, m_data.size()) == m_data);
+
+#ifdef TOOLSLIB_X86
+		// The match finder and the hash must not change the output.
+		cpu_check_features();
+		int sse42 = x86_cpu_has_sse42;
+		int avx2 = x86_cpu_has_avx2;
+
+		x86_cpu_has_avx2 = 0;
+		vector<Bytef> sse = compress(m_data, level);
+
+		x86_cpu_has_sse42 = 0;
+		vector<Bytef> scalar = compress(m_data, level);
+
+		x86_cpu_has_sse42 = sse42;
+		x86_cpu_has_avx2 = avx2;
+
+		EXPECT_TRUE(simd == scalar) << "level " << level;
+		EXPECT_TRUE(sse == scalar) << "level " << level;
+#endif
+	}
+}
+
+TEST_F(TZlibCompression, Levels)
+{
+	const int strategies[] = { Z_DEFAULT_STRATEGY, Z_FILTERED };
+	const int windows[] = { 9, 15 };
+	for(int strategy : strategies)
+	{
+		for(int window : windows)
+		{
+			for(int level = 1; level <= 9; level++)
+			{
+				vector<Bytef> data = compress(m_data, level, strategy, window);
+				EXPECT_TRUE(inflateChunked(data, 1 << 20, 1 << 20, window) == m_data) << level << " " << strategy << " " << window;
+			}
+		}
+	}
+
+	// Each level gets a part of the input, with an output buffer so small, that
+	// the blocks are flushed when it is full.
+	z_stream strm = {};
+	ASSERT_EQ(Z_OK, deflateInit(&strm, 1));
+
+	vector<Bytef> out;
+	Bytef buffer[97];
+	size_t part = m_data.size() / 9;
+	strm.next_in = (Bytef *)m_data.data();
+	for(int level = 1; level <= 9; level++)
+	{
+		if(level > 1)
+		{
+			strm.next_out = buffer;
+			strm.avail_out = sizeof(buffer);
+			int rc = deflateParams(&strm, level, Z_DEFAULT_STRATEGY);
+			while(rc == Z_BUF_ERROR)
+			{
+				out.insert(out.end(), buffer, strm.next_out);
+				strm.next_out = buffer;
+				strm.avail_out = sizeof(buffer);
+				rc = deflateParams(&strm, level, Z_DEFAULT_STRATEGY);
+			}
+			ASSERT_EQ(Z_OK, rc);
+			out.insert(out.end(), buffer, strm.next_out);
+		}
+
+		int flush = (level == 9) ? Z_FINISH : Z_NO_FLUSH;
+		strm.avail_in = (uInt)((level == 9) ? m_data.size() - strm.total_in : part);
+
+		int rc = Z_OK;
+		do
+		{
+			strm.next_out = buffer;
+			strm.avail_out = sizeof(buffer);
+			rc = deflate(&strm, flush);
+			out.insert(out.end(), buffer, strm.next_out);
+		}
+		while(strm.avail_in || (flush == Z_FINISH && rc == Z_OK));
+		ASSERT_EQ((level == 9) ? Z_STREAM_END : Z_OK, rc);
+	}
+	deflateEnd(&strm);
+
+	EXPECT_TRUE(uncompress(out, m_data.size()) == m_data);
+}
+
+TEST_F(TZlibCompression, InflateChunked)
+{
+	const size_t outputs[] = { 1, 273, 300, 4099, 1 << 20 };
+	const size_t inputs[] = { 8, 333, 1 << 20 };
+	const int windows[] = { 9, 15 };
+	for(int window : windows)
+	{
+		vector<Bytef> data = compress(m_data, 6, Z_DEFAULT_STRATEGY, window);
+		for(size_t output : outputs)
+		{
+			for(size_t input : inputs)
+				EXPECT_TRUE(inflateChunked(data, input, output, window) == m_data) << window << " " << output << " " << input;
+		}
+	}
+
+	// Runs are matches with a short distance, which overlap themselves.
+	string runs;
+	for(size_t dist = 1; dist < 40; dist++)
+	{
+		for(size_t i = 0; i < 2000; i++)
+			runs.push_back((char)('a' + (i % dist)));
+	}
+	vector<Bytef> data = compress(runs, 9);
+	EXPECT_TRUE(uncompress(data, runs.size()) == runs);
+	EXPECT_TRUE(inflateChunked(data, 8, 300) == runs);
+}
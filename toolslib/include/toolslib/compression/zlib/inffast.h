@@ -8,4 +8,15 @@
    subject to change. Applications should only use zlib.h.
  */
 
+/* inflate() and inflateBack() call inflate_fast() only with at least this much
+   input and output available. The C version reads the input eight bytes at a
+   time, and writes up to 15 bytes beyond a match. */
+#ifdef ASMINF
+#  define INFLATE_FAST_MIN_INPUT 6
+#  define INFLATE_FAST_MIN_OUTPUT 258
+#else
+#  define INFLATE_FAST_MIN_INPUT 8
+#  define INFLATE_FAST_MIN_OUTPUT (258 + 15)
+#endif
+
 void ZLIB_INTERNAL inflate_fast OF((z_streamp strm, unsigned start));
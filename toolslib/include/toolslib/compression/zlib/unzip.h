@@ -370,6 +370,16 @@ extern int ZEXPORT unzOpenCurrentFile3 OF((unzFile file,
 */
 
 
+extern int ZEXPORT unzSetReadBufferSize OF((unzFile file,
+                                            uInt size));
+/*
+  Set the size of the buffer for the compressed data, which is read from the
+  zipfile in one piece (UNZ_BUFSIZE by default). Takes effect with the next
+  unzOpenCurrentFile.
+  If there is no error, the return value is UNZ_OK.
+*/
+
+
 extern int ZEXPORT unzCloseCurrentFile OF((unzFile file));
 /*
   Close the file in zip opened with unzOpenCurrentFile
@@ -0,0 +1,43 @@
+/* zlib_cpu.h -- runtime detection of the CPU features for the SIMD code paths
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+#ifndef ZLIB_CPU_H
+#define ZLIB_CPU_H
+
+#include "zutil.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#  define ZLIB_X86
+#endif
+
+/* Functions using intrinsics beyond the baseline of the build are compiled for
+   their instruction set with ZLIB_TARGET, and must only be called after the
+   corresponding x86_cpu_has_ flag was checked. MSVC doesn't need this. */
+#if defined(__GNUC__) || defined(__clang__)
+#  define ZLIB_TARGET(isa) __attribute__((target(isa)))
+#else
+#  define ZLIB_TARGET(isa)
+#endif
+
+#ifdef ZLIB_X86
+
+extern int ZLIB_INTERNAL x86_cpu_has_sse2;
+extern int ZLIB_INTERNAL x86_cpu_has_ssse3;
+extern int ZLIB_INTERNAL x86_cpu_has_sse41;
+extern int ZLIB_INTERNAL x86_cpu_has_sse42;
+extern int ZLIB_INTERNAL x86_cpu_has_pclmul;
+extern int ZLIB_INTERNAL x86_cpu_has_avx2;
+
+/* Sets the x86_cpu_has_ flags. It is cheap after the first call. Concurrent first
+   calls are harmless, they all store the same values. */
+void ZLIB_INTERNAL cpu_check_features OF((void));
+
+#endif /* ZLIB_X86 */
+
+#endif /* ZLIB_CPU_H */
@@ -0,0 +1,128 @@
+#ifndef _ASYNC_IO_H
+#define _ASYNC_IO_H
+
+#include <memory>
+#include <vector>
+
+#include "toolslib/toolslib_api.h"
+#include "toolslib/toolslib_def.h"
+#include "toolslib/files/IFile.h"
+#include "toolslib/files/SystemIO.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+/**
+ * AsyncIO keeps many positional reads and writes in flight at the same time, so a
+ * single thread can serve a large number of files without blocking on each of them.
+ * Each submit returns a token, and wait() returns the tokens of finished requests
+ * together with their results, which follow the rules of readAt()/writeAt(): less
+ * than requested only at the end of the file, and invalid64_t on error.
+ *
+ * On Linux the requests are passed to the kernel with io_uring. Where this is not
+ * available, a pool of threads does the transfers. Requests are queued by submit
+ * and handed over in batches with flush() or at the latest by the next wait().
+ *
+ * Files which provide a native handle (see BaseFile::getNativeHandle()) are accessed
+ * directly. With io_uring the transfers of other files are done synchronously by
+ * the submit, the thread pool calls their readAt()/writeAt().
+ *
+ * The buffers must stay valid until the request is finished, so the destructor
+ * waits for all pending requests. An AsyncIO object must only be used by one thread.
+ */
+class TOOLSLIB_API AsyncIO
+{
+public:
+	static const size_t default_queue_depth = 64;
+	static const size_t default_threads = 4;
+
+	typedef uint64_t token_t;
+
+	typedef struct
+	{
+		token_t Token;
+		int64_t Result;
+	} completion_t;
+
+public:
+	/**
+	 * nQueueDepth is the maximum number of requests the kernel is working on, further
+	 * submits wait until a slot is free. nThreads is the size of the pool, if it is
+	 * needed. If bKernelQueue is false, the thread pool is used in any case.
+	 */
+	AsyncIO(size_t nQueueDepth = default_queue_depth, size_t nThreads = default_threads, bool bKernelQueue = true);
+	virtual ~AsyncIO(void);
+
+	token_t submitRead(IFile &oFile, int64_t nOffset, void *oBuffer, int64_t nLen);
+	token_t submitWrite(IFile &oFile, int64_t nOffset, void const *oBuffer, int64_t nLen);
+	token_t submitRead(sysio::handle_t nHandle, int64_t nOffset, void *oBuffer, int64_t nLen);
+	token_t submitWrite(sysio::handle_t nHandle, int64_t nOffset, void const *oBuffer, int64_t nLen);
+
+	/**
+	 * Hands all queued requests over, without waiting for them.
+	 */
+	void flush(void);
+
+	/**
+	 * Waits until at least nMinCompletions requests are finished (or all pending ones, if
+	 * there are less), and returns up to nMaxCompletions of them in oCompletions. Returns
+	 * the number of completions which were stored.
+	 */
+	size_t wait(completion_t *oCompletions, size_t nMaxCompletions, size_t nMinCompletions = 1);
+
+	/**
+	 * Waits for the request and returns its result. The token must not have been returned
+	 * by another wait() yet.
+	 */
+	int64_t wait(token_t nToken);
+
+	/**
+	 * Number of requests which were not returned by wait() yet.
+	 */
+	size_t getPending(void) const
+	{
+		return mPending;
+	}
+
+	/**
+	 * True if the requests are passed to the kernel (io_uring), instead of the thread pool.
+	 */
+	bool isKernelQueue(void) const;
+
+public:
+	class Engine;
+
+	typedef struct
+	{
+		token_t Token;
+		sysio::handle_t Handle;			// invalid_handle if the file has to be used.
+		IFile *File;
+		char *Buffer;
+		int64_t Offset;
+		int64_t Length;
+		bool Write;
+	} request_t;
+
+protected:
+	token_t submit(request_t &oRequest);
+
+	/**
+	 * Collects at least nMin completions into mCompleted.
+	 */
+	void reap(size_t nMin);
+
+private:
+	std::unique_ptr<Engine> mEngine;
+	std::vector<completion_t> mCompleted;		// Finished, but not returned by wait() yet.
+	token_t mNextToken;
+	size_t mPending;
+};
+
+}
+
+}
+
+#endif // _ASYNC_IO_H
@@ -1,9 +1,13 @@
 #ifndef _BASE_FILE_H
 #define _BASE_FILE_H
 
+#include <mutex>
+
 #include "toolslib/toolslib_api.h"
 #include "toolslib/toolslib_def.h"
 #include "toolslib/files/IFile.h"
+#include "toolslib/files/BufferPool.h"
+#include "toolslib/files/SystemIO.h"
 
 namespace toolslib
 {
@@ -50,6 +54,36 @@ public:
 
 	int getChar(void) override;
 
+	/**
+	 * The default implementation positions the file with seek() under a lock and
+	 * restores the previous position afterwards.
+	 */
+	int64_t readAt(int64_t nOffset, void *oBuffer, int64_t nLen) override;
+	int64_t writeAt(int64_t nOffset, void const *oBuffer, int64_t nLen) override;
+
+	/**
+	 * The default implementation calls read()/write() for each buffer.
+	 */
+	int64_t readv(buffer_span const *oSpans, size_t nCount) override;
+	int64_t writev(const_buffer_span const *oSpans, size_t nCount) override;
+
+	/**
+	 * The default implementation provides no view, and consume() reads and discards
+	 * the data, so it works for all files, even if they can't seek.
+	 */
+	const char *peek(int64_t nMinBytes, int64_t &nAvailable) override;
+	int64_t consume(int64_t nBytes) override;
+
+	/**
+	 * Returns the native handle, if positional transfers on it are equivalent to
+	 * readAt()/writeAt() of the file, so they can be done outside of the file (see
+	 * AsyncIO). Otherwise, and by default, invalid_handle is returned.
+	 */
+	virtual sysio::handle_t getNativeHandle(void) const
+	{
+		return sysio::invalid_handle;
+	}
+
 	void setOpenmode(open_mode const &oMode) override;
 
 	/**
@@ -75,7 +109,7 @@ public:
 	/**
 	 * Creates all missing directories of a path for a given file. If no filename
 	 * is given in the path it must end with a terminating '\' character otherwise
-	 * the last directory will not be created.
+	 * the last directory will not be created. '/' is accepted as well.
 	 *
 	 * Example:
 	 *		"d:\tmp\t0\t1\t2\t.txt"		<- creates "d:\tmp\t0\t1\t2"
@@ -86,12 +120,47 @@ public:
 
 protected:
 	virtual Filename &getFilename(void);
+
+	/**
+	 * Returns the buffer size which is used when the client didn't request a specific
+	 * size. The default is based on the block size of the filesystem, the length of the
+	 * file and on the access pattern declared in the open mode. If the backend has a
+	 * native handle open already, the file is queried through it instead of its path.
+	 */
+	virtual uint64_t proposeFileBufferSize(void);
+
+	/**
+	 * Common sizing rules for the backends, applied to the file at oPath, which may
+	 * not exist yet, or to the open file. The size is never larger than the file,
+	 * when it is only read.
+	 */
+	uint64_t proposeFileBufferSize(std::string const &oPath, bool bCompressed) const;
+	uint64_t proposeFileBufferSize(sysio::handle_t nHandle, bool bCompressed) const;
+	uint64_t proposeFileBufferSize(int64_t nFileLength, int64_t nBlockSize, bool bCompressed) const;
+
+	/**
+	 * The common part of open(). Backends which size the buffer from their open handle
+	 * pass false and call allocateFileBuffer(updateFileBufferSize()) themselves, once
+	 * the handle is open, so the file doesn't have to be looked up by its path.
+	 */
+	void beginOpen(bool bAllocateBuffer);
+
+	/**
+	 * Applies the size requested with setFileBufferSize(), or the proposal if none was
+	 * requested, and returns it. Used by open(), before the buffer is allocated.
+	 */
+	uint64_t updateFileBufferSize(void);
+
 	virtual char *allocateFileBuffer(int64_t nSize);
 	virtual void freeFileBuffer(char *oFileBuffer);
 	char *getFileBuffer(void) const override;
+	/**
+	 * Sets a buffer which was allocated with new[]. It is deleted by freeFileBuffer().
+	 */
 	void setFileBuffer(char *oFileBuffer)
 	{
 		mFileBuffer = oFileBuffer;
+		mFileBufferPool = NULL;
 	}
 
 	void setSeekable(bool bSeekable)
@@ -107,8 +176,12 @@ protected:
 private:
 	char *mFileBuffer;
 	uint64_t mFileBufferSize;
+	uint64_t mRequestedBufferSize;		// As set by the client, invalid64u_t to use the proposal.
+	BufferPool *mFileBufferPool;		// The pool the buffer came from, so it goes back to the same one.
+	size_t mFileBufferAllocated;
 	Filename mFilename;
 	IFile::open_mode mOpenmode;
+	std::mutex mPositionLock;			// Serializes readAt()/writeAt() if they have to use the file position.
 	bool mEOF:1;
 	bool mIsOpen:1;
 };
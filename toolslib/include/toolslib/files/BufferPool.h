@@ -0,0 +1,118 @@
+#ifndef _BUFFER_POOL_H
+#define _BUFFER_POOL_H
+
+#include <mutex>
+#include <vector>
+
+#include "toolslib/toolslib_api.h"
+#include "toolslib/toolslib_def.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+/**
+ * BufferPool recycles the file buffers, so opening many files doesn't allocate a
+ * new buffer each time. The sizes are rounded up to size classes (powers of two,
+ * starting at one page), and each class has a free list. Each thread keeps a few
+ * buffers of its own in front of the free lists, so the common open/close cycle
+ * doesn't even need a lock.
+ *
+ * All buffers are page aligned, so they can be used for unbuffered I/O as well.
+ * With huge pages enabled, large buffers are aligned to huge pages and the OS is
+ * asked to back them with huge pages, where this is supported.
+ *
+ * The pool used by the files can be replaced with setDefault(), by a derived
+ * pool which overrides allocate()/release().
+ */
+class TOOLSLIB_API BufferPool
+{
+public:
+	static const size_t page_size = 4096;
+	static const size_t huge_page_size = 2*1024*1024;
+	static const size_t size_classes = 15;				// page_size up to 64 MB
+	static const size_t default_cache_limit = 64*1024*1024;
+
+public:
+	BufferPool(size_t nCacheLimit = default_cache_limit, bool bHugePages = false);
+	virtual ~BufferPool(void);
+
+	/**
+	 * Returns the pool which is used by the files. If setDefault() was never called
+	 * a global instance is returned, which is never destroyed.
+	 */
+	static BufferPool &getDefault(void);
+
+	/**
+	 * Sets the pool used by the files. The caller keeps the ownership, and must keep
+	 * the pool alive as long as buffers from it are in use. NULL restores the global instance.
+	 */
+	static void setDefault(BufferPool *pPool);
+
+	/**
+	 * Returns a page aligned buffer with at least nSize bytes. The content is undefined.
+	 */
+	virtual char *allocate(size_t nSize);
+
+	/**
+	 * Gives the buffer back to the pool. nSize must be the size which was requested.
+	 */
+	virtual void release(char *pBuffer, size_t nSize);
+
+	/**
+	 * Frees all buffers cached in the free lists of the pool. The caches of the
+	 * threads are freed when the threads end.
+	 */
+	void trim(void);
+
+	/**
+	 * Returns the size which is really allocated for nSize.
+	 */
+	static size_t roundSize(size_t nSize);
+
+	size_t getCachedBytes(void) const;
+
+	size_t getCacheLimit(void) const
+	{
+		return mCacheLimit;
+	}
+
+	void setCacheLimit(size_t nCacheLimit = default_cache_limit)
+	{
+		mCacheLimit = nCacheLimit;
+	}
+
+	bool getHugePages(void) const
+	{
+		return mHugePages;
+	}
+
+	void setHugePages(bool bHugePages = true)
+	{
+		mHugePages = bHugePages;
+	}
+
+protected:
+	/**
+	 * Returns the size class for nSize, or size_classes if the buffer is too large to be pooled.
+	 */
+	static size_t sizeClass(size_t nSize);
+
+	char *allocateMemory(size_t nSize);
+	static void freeMemory(char *pBuffer);
+
+private:
+	mutable std::mutex mLock;
+	std::vector<char *> mFreeLists[size_classes];
+	size_t mCachedBytes;
+	size_t mCacheLimit;
+	bool mHugePages;
+};
+
+}
+
+}
+
+#endif // _BUFFER_POOL_H
@@ -0,0 +1,141 @@
+#ifndef _BYTE_STREAM_H
+#define _BYTE_STREAM_H
+
+#include <vector>
+
+#include "toolslib/toolslib_api.h"
+#include "toolslib/toolslib_def.h"
+#include "toolslib/files/IFile.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+/**
+ * ByteStream is a buffered byte by byte reader on top of any IFile. get(), peek() and
+ * unget() are inline and not virtual, and the file is only accessed with read() when
+ * the buffer runs empty, just like the getc() macro of stdio does it. This is the
+ * better choice for tokenizers than IFile::getChar(), which costs a virtual call per byte.
+ *
+ * The stream reads ahead, so the position of the file is not the position of the
+ * stream. If the file is used directly again after the stream, sync() has to be called.
+ */
+class TOOLSLIB_API ByteStream
+{
+public:
+	static const size_t default_buffer_size = 64*1024;
+
+	// This many characters can always be returned with unget(), even after a refill.
+	static const size_t putback_size = 16;
+
+public:
+	ByteStream(IFile &oFile, size_t nBufferSize = default_buffer_size);
+	virtual ~ByteStream(void);
+
+	/**
+	 * Returns the next character and advances the stream, or EOF at the end.
+	 */
+	inline int get(void)
+	{
+		if(mCur < mEnd)
+			return (unsigned char)*mCur++;
+
+		return underflow(true);
+	}
+
+	/**
+	 * Returns the next character without advancing, or EOF at the end.
+	 */
+	inline int peek(void)
+	{
+		if(mCur < mEnd)
+			return (unsigned char)*mCur;
+
+		return underflow(false);
+	}
+
+	/**
+	 * Steps back one character. Returns false if there is no character before the
+	 * current position in the buffer anymore. At least putback_size characters can
+	 * always be returned.
+	 */
+	inline bool unget(void)
+	{
+		if(mCur > mBegin)
+		{
+			mCur--;
+			return true;
+		}
+
+		return false;
+	}
+
+	/**
+	 * Skips nBytes and returns the number of bytes skipped, which is only less
+	 * at the end of the file.
+	 */
+	inline int64_t skip(int64_t nBytes)
+	{
+		if(nBytes <= mEnd - mCur)
+		{
+			mCur += nBytes;
+			return nBytes;
+		}
+
+		return skipSlow(nBytes);
+	}
+
+	/**
+	 * Reads nLen bytes through the buffer. Large reads go directly to the file.
+	 */
+	int64_t read(void *oBuffer, int64_t nLen);
+
+	/**
+	 * Position of the stream, based on the position of the file when the stream was created.
+	 */
+	int64_t tell(void) const
+	{
+		return mEndPos - (mEnd - mCur);
+	}
+
+	bool isEOF(void) const
+	{
+		return mCur >= mEnd && mEOF;
+	}
+
+	/**
+	 * Returns the bytes which were read ahead but not consumed yet, by positioning
+	 * the file to the position of the stream. Returns false if the file can't seek back.
+	 */
+	bool sync(void);
+
+	IFile &getFile(void) const
+	{
+		return mFile;
+	}
+
+protected:
+	/**
+	 * Refills the buffer and returns the next character, which is consumed
+	 * if bConsume is true.
+	 */
+	int underflow(bool bConsume);
+	int64_t skipSlow(int64_t nBytes);
+
+private:
+	IFile &mFile;
+	std::vector<char> mBuffer;
+	const char *mBegin;			// Oldest character which can be returned by unget()
+	const char *mCur;
+	const char *mEnd;
+	int64_t mEndPos;			// Position of mEnd in the file.
+	bool mEOF;
+};
+
+}
+
+}
+
+#endif // _BYTE_STREAM_H
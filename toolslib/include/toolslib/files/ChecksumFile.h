@@ -0,0 +1,167 @@
+#ifndef _CHECKSUM_FILE_H
+#define _CHECKSUM_FILE_H
+
+#include "toolslib/toolslib_api.h"
+#include "toolslib/toolslib_def.h"
+#include "toolslib/files/IFile.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+/**
+ * Running checksum over a sequence of buffers.
+ */
+class TOOLSLIB_API Checksum
+{
+public:
+	typedef enum
+	{
+		CS_CRC32,				// As in gzip and zip, zlib_crc32() of the bundled zlib.
+		CS_ADLER32,				// As in the zlib format, from zlib.
+		CS_XXH64,				// xxHash64 with seed 0, much faster, but not a standard for archives.
+
+		CS_MAX
+	} Algorithm;
+
+public:
+	Checksum(Algorithm nAlgorithm = CS_CRC32);
+
+	void update(void const *pData, int64_t nLen);
+
+	/**
+	 * Returns the checksum of the data so far. It can be called at any time, and
+	 * the checksum continues with the following updates. CRC32 and Adler32 are
+	 * in the lower 32 bits.
+	 */
+	uint64_t getDigest(void) const;
+
+	/**
+	 * Number of bytes included in the checksum.
+	 */
+	int64_t getLength(void) const
+	{
+		return mLength;
+	}
+
+	Algorithm getAlgorithm(void) const
+	{
+		return mAlgorithm;
+	}
+
+	/**
+	 * Starts a new checksum, optionally with a different algorithm.
+	 */
+	void reset(void)
+	{
+		reset(mAlgorithm);
+	}
+
+	void reset(Algorithm nAlgorithm);
+
+	/**
+	 * Returns the checksum of a single buffer.
+	 */
+	static uint64_t compute(Algorithm nAlgorithm, void const *pData, int64_t nLen);
+
+protected:
+	void updateXXH64(uint8_t const *pData, size_t nLen);
+	uint64_t digestXXH64(void) const;
+
+private:
+	Algorithm mAlgorithm;
+	int64_t mLength;
+	uint64_t mChecksum;					// CRC32 and Adler32.
+	uint64_t mLanes[4];					// XXH64 accumulators.
+	uint8_t mPending[32];				// XXH64 input which doesn't fill a stripe yet.
+	size_t mPendingLength;
+};
+
+/**
+ * ChecksumFile wraps any other IFile and updates a checksum with all data which passes
+ * through read(), write() and the other sequential operations, so a file can be
+ * verified while it is processed, without reading it a second time.
+ *
+ * The checksum covers the data in the order it was transferred. seek() doesn't reset
+ * it, and readAt()/writeAt() are passed through without being included, because they
+ * are not part of the stream. open() and reset() start a new checksum.
+ *
+ * The wrapped file is not owned, and must not be used directly meanwhile.
+ */
+class TOOLSLIB_API ChecksumFile
+: public virtual IFile
+{
+public:
+	ChecksumFile(IFile &oFile, Checksum::Algorithm nAlgorithm = Checksum::CS_CRC32);
+	~ChecksumFile(void) override;
+
+	bool open(void) override;
+	bool open(open_mode const &oMode) override;
+	void close(void) override;
+	void flush(void) override;
+	bool isEOF(void) const override;
+	int64_t read(void *oBuffer, int64_t nLen) override;
+	int64_t write(const void *oBuffer, int64_t nLen) override;
+	int64_t seek(int64_t nOffset, IFile::seek_pos nPos) override;
+	int64_t tell(void) override;
+	int64_t length(void) override;
+	int getChar(void) override;
+	int64_t readAt(int64_t nOffset, void *oBuffer, int64_t nLen) override;
+	int64_t writeAt(int64_t nOffset, void const *oBuffer, int64_t nLen) override;
+	int64_t readv(buffer_span const *oSpans, size_t nCount) override;
+	int64_t writev(const_buffer_span const *oSpans, size_t nCount) override;
+
+	/**
+	 * The view is included in the checksum as far as it is consumed. If more is consumed
+	 * than the view holds, the data is read, so it can be included as well.
+	 */
+	const char *peek(int64_t nMinBytes, int64_t &nAvailable) override;
+	int64_t consume(int64_t nBytes) override;
+
+	bool isOpen(void) const override;
+	void setFilename(Filename const &oFilename) override;
+	const Filename &getFilename(void) const override;
+	std::string const &getOpenpath(void) const override;
+	uint64_t getFileBufferSize(void) const override;
+	uint64_t setFileBufferSize(uint64_t nFileBufferSize = invalid64u_t) override;
+	char *getFileBuffer(void) const override;
+	void setOpenmode(open_mode const &oMode) override;
+
+public:
+	/**
+	 * The checksum of the data transferred since open() or the last reset().
+	 */
+	Checksum const &getChecksum(void) const
+	{
+		return mChecksum;
+	}
+
+	uint64_t getDigest(void) const
+	{
+		return mChecksum.getDigest();
+	}
+
+	void reset(void)
+	{
+		mChecksum.reset();
+	}
+
+	void reset(Checksum::Algorithm nAlgorithm)
+	{
+		mChecksum.reset(nAlgorithm);
+	}
+
+private:
+	IFile &mFile;
+	Checksum mChecksum;
+	const char *mPeekView;				// Of the last peek(), until the next operation.
+	int64_t mPeekAvailable;
+};
+
+}
+
+}
+
+#endif // _CHECKSUM_FILE_H
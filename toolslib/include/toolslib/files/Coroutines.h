@@ -0,0 +1,524 @@
+#ifndef _COROUTINES_H
+#define _COROUTINES_H
+
+#include "toolslib/toolslib_api.h"
+#include "toolslib/toolslib_def.h"
+
+#ifdef TOOLSLIB_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+
+#include "toolslib/files/AsyncIO.h"
+#include "toolslib/files/BaseFile.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+/**
+ * Coroutine support for the files, so the processing of a file can be written
+ * straight-line, while an IOExecutor overlaps the I/O of many files:
+ *
+ *	Task<void> process(IFile &oFile)
+ *	{
+ *		char buffer[4096];
+ *		int64_t rd;
+ *		while((rd = co_await readAsync(oFile, buffer, sizeof(buffer))) > 0)
+ *			...
+ *	}
+ *
+ *	IOExecutor executor;
+ *	for(...)
+ *		executor.spawn(process(file));
+ *	executor.run();
+ *
+ * Everything is in this header, so it is available as soon as the client is compiled
+ * as C++20, even if the library itself isn't.
+ */
+
+class IOExecutor;
+
+/**
+ * The result of a coroutine. A Task starts when it is awaited or spawned, and awaiting
+ * it returns the value of co_return, or rethrows its exception.
+ */
+template <typename T>
+class Task;
+
+class TaskFinalAwaiter
+{
+public:
+	bool await_ready(void) noexcept
+	{
+		return false;
+	}
+
+	template <typename Promise>
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> oHandle) noexcept
+	{
+		std::coroutine_handle<> continuation = oHandle.promise().mContinuation;
+		if(continuation)
+			return continuation;
+
+		return std::noop_coroutine();
+	}
+
+	void await_resume(void) noexcept
+	{
+	}
+};
+
+class TaskPromiseBase
+{
+public:
+	std::suspend_always initial_suspend(void) noexcept
+	{
+		return {};
+	}
+
+	/**
+	 * Continues with the awaiting coroutine, if there is one.
+	 */
+	TaskFinalAwaiter final_suspend(void) noexcept
+	{
+		return TaskFinalAwaiter();
+	}
+
+	void unhandled_exception(void)
+	{
+		mException = std::current_exception();
+	}
+
+	void rethrow(void)
+	{
+		if(mException)
+			std::rethrow_exception(mException);
+	}
+
+public:
+	std::coroutine_handle<> mContinuation;
+	std::exception_ptr mException;
+};
+
+template <typename T>
+class TaskPromise
+: public TaskPromiseBase
+{
+public:
+	Task<T> get_return_object(void);
+
+	template <typename V>
+	void return_value(V &&oValue)
+	{
+		mValue.emplace(std::forward<V>(oValue));
+	}
+
+	T result(void)
+	{
+		rethrow();
+		return std::move(*mValue);
+	}
+
+private:
+	std::optional<T> mValue;
+};
+
+template <>
+class TaskPromise<void>
+: public TaskPromiseBase
+{
+public:
+	Task<void> get_return_object(void);
+
+	void return_void(void)
+	{
+	}
+
+	void result(void)
+	{
+		rethrow();
+	}
+};
+
+template <typename T>
+class Task
+{
+public:
+	typedef TaskPromise<T> promise_type;
+	typedef std::coroutine_handle<promise_type> handle_type;
+
+public:
+	explicit Task(handle_type oHandle)
+	: mHandle(oHandle)
+	{
+	}
+
+	Task(Task &&oOther) noexcept
+	: mHandle(std::exchange(oOther.mHandle, nullptr))
+	{
+	}
+
+	Task &operator=(Task &&oOther) noexcept
+	{
+		if(this != &oOther)
+		{
+			if(mHandle)
+				mHandle.destroy();
+
+			mHandle = std::exchange(oOther.mHandle, nullptr);
+		}
+
+		return *this;
+	}
+
+	Task(Task const &) = delete;
+	Task &operator=(Task const &) = delete;
+
+	~Task(void)
+	{
+		if(mHandle)
+			mHandle.destroy();
+	}
+
+	handle_type getHandle(void) const
+	{
+		return mHandle;
+	}
+
+	bool isDone(void) const
+	{
+		return !mHandle || mHandle.done();
+	}
+
+	auto operator co_await(void) noexcept
+	{
+		class awaiter
+		{
+		public:
+			awaiter(handle_type oHandle)
+			: mHandle(oHandle)
+			{
+			}
+
+			bool await_ready(void) noexcept
+			{
+				return !mHandle || mHandle.done();
+			}
+
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<> oAwaiting) noexcept
+			{
+				mHandle.promise().mContinuation = oAwaiting;
+				return mHandle;
+			}
+
+			T await_resume(void)
+			{
+				return mHandle.promise().result();
+			}
+
+		private:
+			handle_type mHandle;
+		};
+
+		return awaiter(mHandle);
+	}
+
+private:
+	handle_type mHandle;
+};
+
+template <typename T>
+inline Task<T> TaskPromise<T>::get_return_object(void)
+{
+	return Task<T>(Task<T>::handle_type::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object(void)
+{
+	return Task<void>(Task<void>::handle_type::from_promise(*this));
+}
+
+/**
+ * Awaits a single transfer. If the file has a native handle and an executor is
+ * running, the transfer is done by the AsyncIO of the executor and the coroutine is
+ * suspended meanwhile. Otherwise (MemoryFile, the compressed files) the transfer is
+ * done directly, because the data is in memory or needs the CPU anyway.
+ *
+ * With an offset of invalid64_t, the transfer happens at the position of the file,
+ * and the file is positioned behind it afterwards, just like read()/write() do.
+ * co_await returns the number of bytes transferred, or invalid64_t on error.
+ */
+class IOAwaitable
+{
+public:
+	IOAwaitable(IOExecutor *pExecutor, IFile &oFile, int64_t nOffset, char *oBuffer, int64_t nLen, bool bWrite)
+	: mExecutor(pExecutor)
+	, mFile(oFile)
+	, mOffset(nOffset)
+	, mBuffer(oBuffer)
+	, mLength(nLen)
+	, mResult(invalid64_t)
+	, mWrite(bWrite)
+	, mPositioned(false)
+	{
+	}
+
+	bool await_ready(void);
+	void await_suspend(std::coroutine_handle<> oHandle);
+
+	int64_t await_resume(void)
+	{
+		// The transfer bypassed the file, so the position has to be moved.
+		if(mPositioned && mResult > 0)
+			mFile.seek(mOffset + mResult, IFile::set);
+
+		return mResult;
+	}
+
+protected:
+	friend class IOExecutor;
+
+	/**
+	 * Called by the executor when the transfer is finished.
+	 */
+	void complete(int64_t nResult)
+	{
+		mResult = nResult;
+	}
+
+	int64_t transferDirect(void)
+	{
+		if(mOffset == invalid64_t)
+			return (mWrite) ? mFile.write(mBuffer, mLength) : mFile.read(mBuffer, mLength);
+
+		return (mWrite) ? mFile.writeAt(mOffset, mBuffer, mLength) : mFile.readAt(mOffset, mBuffer, mLength);
+	}
+
+private:
+	IOExecutor *mExecutor;
+	IFile &mFile;
+	int64_t mOffset;
+	char *mBuffer;
+	int64_t mLength;
+	int64_t mResult;
+	sysio::handle_t mHandle;
+	bool mWrite;
+	bool mPositioned;			// mOffset was taken from the file position.
+};
+
+/**
+ * A single threaded executor. It resumes the tasks which are ready, and when all of
+ * them are waiting for I/O, it waits for the next batch of completions of its AsyncIO.
+ */
+class IOExecutor
+{
+public:
+	IOExecutor(size_t nQueueDepth = AsyncIO::default_queue_depth)
+	: mAsync(nQueueDepth)
+	{
+	}
+
+	IOExecutor(IOExecutor const &) = delete;
+	IOExecutor &operator=(IOExecutor const &) = delete;
+
+	/**
+	 * Returns the executor which runs on this thread, or NULL.
+	 */
+	static IOExecutor *current(void)
+	{
+		return currentRef();
+	}
+
+	/**
+	 * The task is started by the next run().
+	 */
+	void spawn(Task<void> &&oTask)
+	{
+		mTasks.push_back(std::move(oTask));
+		schedule(mTasks.back().getHandle());
+	}
+
+	/**
+	 * Runs until all spawned tasks are finished. If a task threw an exception, the first
+	 * one is rethrown after all the other tasks are finished.
+	 */
+	void run(void)
+	{
+		IOExecutor *previous = currentRef();
+		currentRef() = this;
+
+		std::exception_ptr exception;
+		while(true)
+		{
+			while(!mReady.empty())
+			{
+				std::coroutine_handle<> handle = mReady.front();
+				mReady.pop_front();
+				handle.resume();
+			}
+
+			for(std::list<Task<void>>::iterator it = mTasks.begin(); it != mTasks.end(); )
+			{
+				if(!it->isDone())
+				{
+					++it;
+					continue;
+				}
+
+				if(!exception)
+					exception = it->getHandle().promise().mException;
+
+				it = mTasks.erase(it);
+			}
+
+			// Nothing left to wait for. Tasks which are still suspended, wait for something
+			// else than this executor and would never be resumed.
+			if(mTasks.empty() || mWaiting.empty())
+				break;
+
+			AsyncIO::completion_t completions[64];
+			size_t n = mAsync.wait(completions, 64);
+			for(size_t i = 0; i < n; i++)
+			{
+				std::unordered_map<AsyncIO::token_t, waiter_t>::iterator it = mWaiting.find(completions[i].Token);
+				if(it == mWaiting.end())
+					continue;
+
+				it->second.Awaitable->complete(completions[i].Result);
+				schedule(it->second.Handle);
+				mWaiting.erase(it);
+			}
+		}
+
+		currentRef() = previous;
+
+		if(exception)
+			std::rethrow_exception(exception);
+	}
+
+	AsyncIO &getAsyncIO(void)
+	{
+		return mAsync;
+	}
+
+	IOAwaitable read(IFile &oFile, void *oBuffer, int64_t nLen)
+	{
+		return IOAwaitable(this, oFile, invalid64_t, static_cast<char *>(oBuffer), nLen, false);
+	}
+
+	IOAwaitable write(IFile &oFile, void const *oBuffer, int64_t nLen)
+	{
+		return IOAwaitable(this, oFile, invalid64_t, static_cast<char *>(const_cast<void *>(oBuffer)), nLen, true);
+	}
+
+	IOAwaitable readAt(IFile &oFile, int64_t nOffset, void *oBuffer, int64_t nLen)
+	{
+		return IOAwaitable(this, oFile, nOffset, static_cast<char *>(oBuffer), nLen, false);
+	}
+
+	IOAwaitable writeAt(IFile &oFile, int64_t nOffset, void const *oBuffer, int64_t nLen)
+	{
+		return IOAwaitable(this, oFile, nOffset, static_cast<char *>(const_cast<void *>(oBuffer)), nLen, true);
+	}
+
+protected:
+	friend class IOAwaitable;
+
+	typedef struct
+	{
+		IOAwaitable *Awaitable;
+		std::coroutine_handle<> Handle;
+	} waiter_t;
+
+	static IOExecutor *&currentRef(void)
+	{
+		thread_local IOExecutor *executor = nullptr;
+		return executor;
+	}
+
+	void schedule(std::coroutine_handle<> oHandle)
+	{
+		mReady.push_back(oHandle);
+	}
+
+	void submit(IOAwaitable &oAwaitable, sysio::handle_t nHandle, std::coroutine_handle<> oHandle)
+	{
+		AsyncIO::token_t token;
+		if(oAwaitable.mWrite)
+			token = mAsync.submitWrite(nHandle, oAwaitable.mOffset, oAwaitable.mBuffer, oAwaitable.mLength);
+		else
+			token = mAsync.submitRead(nHandle, oAwaitable.mOffset, oAwaitable.mBuffer, oAwaitable.mLength);
+
+		mWaiting[token] = { &oAwaitable, oHandle };
+	}
+
+private:
+	AsyncIO mAsync;
+	std::list<Task<void>> mTasks;
+	std::list<std::coroutine_handle<>> mReady;
+	std::unordered_map<AsyncIO::token_t, waiter_t> mWaiting;
+};
+
+inline bool IOAwaitable::await_ready(void)
+{
+	BaseFile *file = dynamic_cast<BaseFile *>(&mFile);
+	mHandle = (file) ? file->getNativeHandle() : sysio::invalid_handle;
+
+	if(mExecutor && mHandle != sysio::invalid_handle && mOffset == invalid64_t)
+	{
+		mOffset = mFile.tell();
+		mPositioned = (mOffset != invalid64_t);
+	}
+
+	if(!mExecutor || mHandle == sysio::invalid_handle || mOffset == invalid64_t)
+	{
+		mPositioned = false;
+		mResult = transferDirect();
+		return true;
+	}
+
+	return false;
+}
+
+inline void IOAwaitable::await_suspend(std::coroutine_handle<> oHandle)
+{
+	mExecutor->submit(*this, mHandle, oHandle);
+}
+
+/**
+ * Transfers at the position of the file, with the executor running on this thread.
+ */
+inline IOAwaitable readAsync(IFile &oFile, void *oBuffer, int64_t nLen)
+{
+	return IOAwaitable(IOExecutor::current(), oFile, invalid64_t, static_cast<char *>(oBuffer), nLen, false);
+}
+
+inline IOAwaitable writeAsync(IFile &oFile, void const *oBuffer, int64_t nLen)
+{
+	return IOAwaitable(IOExecutor::current(), oFile, invalid64_t, static_cast<char *>(const_cast<void *>(oBuffer)), nLen, true);
+}
+
+inline IOAwaitable readAtAsync(IFile &oFile, int64_t nOffset, void *oBuffer, int64_t nLen)
+{
+	return IOAwaitable(IOExecutor::current(), oFile, nOffset, static_cast<char *>(oBuffer), nLen, false);
+}
+
+inline IOAwaitable writeAtAsync(IFile &oFile, int64_t nOffset, void const *oBuffer, int64_t nLen)
+{
+	return IOAwaitable(IOExecutor::current(), oFile, nOffset, static_cast<char *>(const_cast<void *>(oBuffer)), nLen, true);
+}
+
+}
+
+}
+
+#endif // TOOLSLIB_COROUTINES
+
+#endif // _COROUTINES_H
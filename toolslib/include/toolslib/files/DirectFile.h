@@ -0,0 +1,115 @@
+#ifndef _DIRECT_FILE_H
+#define _DIRECT_FILE_H
+
+#include "toolslib/files/BaseFile.h"
+#include "toolslib/files/BufferPool.h"
+#include "toolslib/files/SystemIO.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+/**
+ * DirectFile bypasses the cache of the OS (O_DIRECT, FILE_FLAG_NO_BUFFERING), so
+ * streaming very large files neither pollutes the memory of other processes nor
+ * depends on the writeback of the kernel.
+ *
+ * Unbuffered transfers must be aligned in offset, length and memory, so all
+ * transfers go through the file buffer, which is aligned and covers whole blocks.
+ * Unaligned heads and tails are handled transparently: a block which is only
+ * partially written is read first, and the padding behind the end of the file is
+ * cut off again. The buffer should be large (the default is 1 MB), because every
+ * transfer goes to the device.
+ *
+ * If the filesystem doesn't support unbuffered access, the file is opened with
+ * the normal cache instead, which can be checked with isUnbuffered().
+ */
+class TOOLSLIB_API DirectFile
+: public virtual BaseFile
+{
+public:
+	static const size_t alignment = BufferPool::page_size;
+
+public:
+	using IFile::open;
+
+	DirectFile(Filename const &oFilename = "");
+	~DirectFile(void) override;
+
+	bool open(void) override;
+	void close(void) override;
+	void flush(void) override;
+	int64_t read(void *oBuffer, int64_t nLen) override;
+	int64_t write(void const *oBuffer, int64_t nLen) override;
+	int64_t seek(int64_t nOffset, IFile::seek_pos nPos) override;
+	int64_t tell(void) override;
+	int64_t length(void) override;
+
+	/**
+	 * True if the open file really bypasses the cache.
+	 */
+	bool isUnbuffered(void) const
+	{
+		return mUnbuffered;
+	}
+
+	/**
+	 * True if writing the buffer failed. Further writes are refused, and the error is
+	 * kept after close(), until the file is opened again.
+	 */
+	bool hasWriteError(void) const
+	{
+		return mWriteError;
+	}
+
+protected:
+	uint64_t proposeFileBufferSize(void) override;
+	char *allocateFileBuffer(int64_t nSize) override;
+
+	/**
+	 * Writes the modified part of the buffer. Returns false if not all of it could be
+	 * written, in which case the range stays modified and the write error is set.
+	 */
+	bool flushBuffer(void);
+
+	/**
+	 * Loads the block aligned window which contains nPosition into the buffer. Returns
+	 * false if the file couldn't be read.
+	 */
+	bool loadBuffer(int64_t nPosition);
+
+	static int64_t alignDown(int64_t nValue)
+	{
+		return nValue & ~(int64_t)(alignment - 1);
+	}
+
+	static int64_t alignUp(int64_t nValue)
+	{
+		return alignDown(nValue + (int64_t)alignment - 1);
+	}
+
+private:
+	typedef BaseFile super;
+
+	void init(void);
+
+private:
+	sysio::handle_t mFileHandle;
+	bool mUnbuffered;
+	int64_t mFilePos;
+	int64_t mFileLength;		// Length of the file, including the data in the buffer.
+	int64_t mBufferSize;		// Multiple of the alignment.
+	int64_t mBufferPos;			// File offset of the buffer, always aligned.
+	int64_t mBufferFill;		// Number of valid bytes in the buffer.
+	int64_t mDirtyBegin;		// Modified range of the buffer, empty if begin == end.
+	int64_t mDirtyEnd;
+	bool mWriteError;
+};
+
+}
+
+}
+
+#endif // _DIRECT_FILE_H
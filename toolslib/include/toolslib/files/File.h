@@ -2,8 +2,11 @@
 #define _FILE_H
 
 #include <cstdio>
+#include <memory>
 
 #include "toolslib/files/BaseFile.h"
+#include "toolslib/files/ReadAhead.h"
+#include "toolslib/files/WriteBehind.h"
 
 namespace toolslib
 {
@@ -16,11 +19,22 @@ namespace files
  * Note that, whenever the basepath or the filname is changed and a file
  * was previously opened, it will be closed. This is also the case, when
  * the filename would be the same.
+ *
+ * If the file is opened read only with the readahead flag, the reads are served
+ * by a background thread, which prefetches the file (see ReadAhead). Likewise a
+ * write only file with the writebehind flag hands its writes over to a background
+ * thread (see WriteBehind). In this mode flush() waits until everything is written,
+ * and write errors are reported by the next write() or by hasWriteError().
+ *
+ * The access hints of the openmode are passed on to the OS. With dontneed the data
+ * which was read is dropped from the cache while reading, and all of it on close().
  */
 class TOOLSLIB_API File
 : public virtual BaseFile
 {
 public:
+	using IFile::open;
+
 	File(Filename const &oFilename = "");
 
 	/**
@@ -42,6 +56,23 @@ public:
 	int64_t tell(void) override;
 	int64_t length(void) override;
 	int getChar(void) override;
+	int64_t readAt(int64_t nOffset, void *oBuffer, int64_t nLen) override;
+	int64_t writeAt(int64_t nOffset, void const *oBuffer, int64_t nLen) override;
+	int64_t readv(buffer_span const *oSpans, size_t nCount) override;
+	int64_t writev(const_buffer_span const *oSpans, size_t nCount) override;
+
+	/**
+	 * There is no peek() view, because stdio doesn't give access to the data in its
+	 * buffer, and the read ahead hands out copies. Clients which need views should use
+	 * HandleFile or MappedFile. consume() skips with a seek, if the file is only read
+	 * and can seek, instead of reading the data.
+	 */
+	int64_t consume(int64_t nBytes) override;
+
+	/**
+	 * Only if the file is read only, because the stream buffers the writes.
+	 */
+	sysio::handle_t getNativeHandle(void) const override;
 
 public:
 	/**
@@ -63,17 +94,74 @@ public:
 	 */
 	File *setSTDOUT(FILE *oStdOut);
 
+	/**
+	 * Number and size of the chunks which are prefetched in readahead mode. Takes
+	 * effect with the next open().
+	 */
+	void setReadAhead(size_t nDepth = ReadAhead::default_depth, size_t nChunkSize = ReadAhead::default_chunk_size);
+
+	size_t getReadAheadDepth(void) const
+	{
+		return mReadAheadDepth;
+	}
+
+	size_t getReadAheadChunkSize(void) const
+	{
+		return mReadAheadChunkSize;
+	}
+
+	/**
+	 * Number and size of the buffers used in writebehind mode. Takes effect with the next open().
+	 */
+	void setWriteBehind(size_t nDepth = WriteBehind::default_depth, size_t nBufferSize = WriteBehind::default_buffer_size);
+
+	size_t getWriteBehindDepth(void) const
+	{
+		return mWriteBehindDepth;
+	}
+
+	size_t getWriteBehindBufferSize(void) const
+	{
+		return mWriteBehindBufferSize;
+	}
+
+	/**
+	 * True if a write in writebehind mode failed. The error is kept after close(),
+	 * until the file is opened again.
+	 */
+	bool hasWriteError(void) const
+	{
+		return mWriteError;
+	}
+
 protected:
 	virtual FILE *getFileHandle(void) const;
 
+	/**
+	 * Sized from the open stream. Only the minimum, when the read ahead or the write
+	 * behind moves the data, because the stream buffer is not used then.
+	 */
+	uint64_t proposeFileBufferSize(void) override;
+
 private:
 	typedef BaseFile super;
 
 	void init(void);
+	void startReadAhead(void);
+	void startWriteBehind(void);
+	void dropBehind(void);
 
 private:
 	FILE *mFileHandle;
 	bool mDoClose;
+	std::unique_ptr<ReadAhead> mReadAhead;
+	size_t mReadAheadDepth;
+	size_t mReadAheadChunkSize;
+	std::unique_ptr<WriteBehind> mWriteBehind;
+	size_t mWriteBehindDepth;
+	size_t mWriteBehindBufferSize;
+	bool mWriteError;
+	int64_t mDropPosition;			// Start of the range which is not dropped yet, invalid64_t if not dropping.
 };
 
 }
@@ -37,6 +37,8 @@ public:
 		FF_ZIP,					// ZIP compressed file	/ read only
 		FF_RLE,					// RLE compressed file	/ not implemented
 		FF_LZ4,					// LZ4 compressed file	/ read-write
+		FF_MMAP,				// memory mapped file	/ read-write
+		FF_UNBUFFERED,			// file bypassing the OS cache	/ read-write
 
 		FF_MAX
 	} FileType;
@@ -67,6 +69,8 @@ public:
 	 * Return the file object for the given filename. If FileType is set, the object 
 	 * is returned, otherwise the object type is determined automatically.
 	 * If the filetype can not be determined, the default is used.
+	 * If the default is FF_FILE and the file is a regular file of at least
+	 * getMappingThreshold() bytes, a memory mapped file is returned instead.
 	 *
 	 * The file is not opened.
 	 */
@@ -86,6 +90,35 @@ public:
 		pFile = NULL;
 	}
 
+	/**
+	 * Copies the source to the target, which is created or truncated, and returns the
+	 * number of bytes copied, or invalid64_t on error.
+	 *
+	 * If both are plain files, the copy is done by the OS: the target shares the blocks
+	 * with the source if the filesystem supports it, otherwise the data is copied within
+	 * the kernel (copy_file_range/sendfile), or with a large buffer if that isn't possible
+	 * either. Holes of a sparse source stay holes in the target.
+	 * If one of them is compressed or in an archive, the data is streamed through
+	 * the codec with large buffers.
+	 * A file is not copied onto itself (also through a link), because the target is
+	 * truncated first. invalid64_t is returned and the file is left alone.
+	 */
+	int64_t copy(Filename const &oSource, Filename const &oTarget) const;
+
+	/**
+	 * Files at least this size are mapped into memory by getFile(), when no
+	 * other type is detected. Setting the threshold to invalid64_t disables this.
+	 */
+	int64_t getMappingThreshold(void) const
+	{
+		return mMappingThreshold;
+	}
+
+	void setMappingThreshold(int64_t nMappingThreshold = invalid64_t)
+	{
+		mMappingThreshold = nMappingThreshold;
+	}
+
 	/**
 	 * getScanner() returns an appropriate scanner object for the given path.
 	 */
@@ -107,8 +140,19 @@ protected:
 	 */
 	Filename detectFileType(Filename const &oFilename, FileType &oType) const;
 
+	/**
+	 * The copy() between two plain files, of which the source is a regular file.
+	 */
+	int64_t copyPlain(std::string const &oSource, std::string const &oTarget) const;
+
+	/**
+	 * The copy() through the IFile interface, which works for all types.
+	 */
+	int64_t copyStream(Filename const &oSource, Filename const &oTarget) const;
+
 private:
 	static FileFactory *mInstance;			// Singleton instance.
+	int64_t mMappingThreshold;
 };
 
 }
@@ -12,7 +12,11 @@ namespace toolslib
 namespace files
 {
 
+#ifdef _WIN32
 static const char DEFAULT_PATH_DELIMITER = '\\';
+#else
+static const char DEFAULT_PATH_DELIMITER = '/';
+#endif
 
 /**
  * Filename provides functions related to filenames. A basepath can be
@@ -29,6 +29,18 @@ public:
 
 	static bool isHeader(const char *pBuffer, size_t nBufferLen);
 
+protected:
+	/**
+	 * The buffer size is applied to the zlib input buffer (the output buffer for
+	 * writing is twice as large), so the proposal assumes compressed data.
+	 */
+	uint64_t proposeFileBufferSize(void) override;
+
+	/**
+	 * The library has its own buffers, so none is allocated here.
+	 */
+	char *allocateFileBuffer(int64_t nSize) override;
+
 private:
 	typedef BaseFile super;
 
@@ -0,0 +1,118 @@
+#ifndef _HANDLE_FILE_H
+#define _HANDLE_FILE_H
+
+#include <mutex>
+
+#include "toolslib/files/BaseFile.h"
+#include "toolslib/files/SystemIO.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+/**
+ * HandleFile accesses a file through the native descriptor (or HANDLE on Windows)
+ * instead of a FILE stream. All transfers are positional (pread/pwrite), and the
+ * file buffer of BaseFile is used as a user space buffer, so there is no stdio
+ * locking involved and length() only needs the descriptor.
+ *
+ * The buffer is used either for reading or for writing. Reads which are larger than
+ * the buffer, bypass it and go directly into the callers memory. Pending writes
+ * are written out on flush(), close() or when the file is positioned elsewhere.
+ *
+ * readAt() and writeAt() bypass the buffer. If they overlap the buffered range, pending
+ * writes are written out first, and writeAt() drops the range from the buffer, so both
+ * ways of access always see the same data. The check of the buffer is done under a
+ * lock, while the transfers themselves run in parallel. As for all files, they must
+ * not be mixed with read()/write() from other threads.
+ *
+ * If the pending data can't be written, it stays in the buffer, and the error is
+ * reported by hasWriteError(), also if it happened during close().
+ */
+class TOOLSLIB_API HandleFile
+: public virtual BaseFile
+{
+public:
+	using IFile::open;
+
+	HandleFile(Filename const &oFilename = "");
+	~HandleFile(void) override;
+
+	bool open(void) override;
+	void close(void) override;
+	void flush(void) override;
+	int64_t read(void *oBuffer, int64_t nLen) override;
+	int64_t write(void const *oBuffer, int64_t nLen) override;
+	int64_t seek(int64_t nOffset, IFile::seek_pos nPos) override;
+	int64_t tell(void) override;
+	int64_t length(void) override;
+	int getChar(void) override;
+	int64_t readAt(int64_t nOffset, void *oBuffer, int64_t nLen) override;
+	int64_t writeAt(int64_t nOffset, void const *oBuffer, int64_t nLen) override;
+	int64_t readv(buffer_span const *oSpans, size_t nCount) override;
+	int64_t writev(const_buffer_span const *oSpans, size_t nCount) override;
+	const char *peek(int64_t nMinBytes, int64_t &nAvailable) override;
+	int64_t consume(int64_t nBytes) override;
+
+	sysio::handle_t getNativeHandle(void) const override
+	{
+		return mFileHandle;
+	}
+
+	/**
+	 * True if writing the buffer failed. The error is kept after close(), until the
+	 * file is opened again.
+	 */
+	bool hasWriteError(void) const
+	{
+		return mWriteError;
+	}
+
+protected:
+	sysio::handle_t getFileHandle(void) const
+	{
+		return mFileHandle;
+	}
+
+	/**
+	 * Writes pending data from the buffer to the file. Returns false if not all of
+	 * it could be written, in which case the rest is kept in the buffer.
+	 */
+	bool flushBuffer(void);
+
+	/**
+	 * True if the range overlaps the data in the buffer.
+	 */
+	bool isBuffered(int64_t nOffset, int64_t nLen) const
+	{
+		return mBufferFill > 0 && nOffset < mBufferPos + mBufferFill && mBufferPos < nOffset + nLen;
+	}
+
+	/**
+	 * Fills the buffer with data from the current position. Returns the number of bytes
+	 * available in the buffer.
+	 */
+	int64_t fillBuffer(void);
+
+private:
+	typedef BaseFile super;
+
+	void init(void);
+
+private:
+	sysio::handle_t mFileHandle;
+	int64_t mFilePos;
+	int64_t mBufferPos;			// File offset of the first byte in the buffer.
+	int64_t mBufferFill;		// Number of valid bytes in the buffer.
+	bool mBufferDirty;			// The buffer contains data which is not written yet.
+	bool mWriteError;
+	std::mutex mBufferLock;		// Serializes the buffer checks of concurrent readAt()/writeAt().
+};
+
+}
+
+}
+
+#endif // _HANDLE_FILE_H
@@ -56,6 +56,15 @@ public:
 			bool create : 1;
 			bool truncate : 1;
 			bool seekable : 1;
+			bool readahead : 1;			// Prefetch sequential reads in the background, if the file supports it.
+			bool writebehind : 1;		// Write in the background, if the file supports it.
+
+			// Access hints, which are passed on to the OS and used for the buffer sizing.
+			// They never change the result of an operation.
+			bool sequential : 1;		// The file is accessed mostly front to back.
+			bool random : 1;			// The file is accessed at random offsets, read-ahead is wasted.
+			bool willneed : 1;			// The whole file will be needed soon, start loading it.
+			bool dontneed : 1;			// The data is accessed only once, don't keep it in the cache.
 
 			static open_mode init(void)
 			{
@@ -68,6 +77,12 @@ public:
 				md.create = false;
 				md.truncate = false;
 				md.seekable = false;
+				md.readahead = false;
+				md.writebehind = false;
+				md.sequential = false;
+				md.random = false;
+				md.willneed = false;
+				md.dontneed = false;
 
 				return md;
 			}
@@ -75,6 +90,21 @@ public:
 
 	static const open_mode open_default;
 
+	/**
+	 * A single buffer of a vectored transfer with readv()/writev().
+	 */
+	typedef struct
+	{
+		void *Data;
+		int64_t Length;
+	} buffer_span;
+
+	typedef struct
+	{
+		void const *Data;
+		int64_t Length;
+	} const_buffer_span;
+
 public:
 	IFile(void) {};
 	virtual ~IFile(void) {};
@@ -92,6 +122,41 @@ public:
 	virtual int64_t length(void) = 0;
 	virtual int getChar(void) = 0;
 
+	/**
+	 * readAt() and writeAt() transfer data at the given offset without using or
+	 * modifying the file position, so multiple threads can access disjoint ranges
+	 * of the same file concurrently, without having to serialize seek() and read().
+	 * They return the number of bytes transferred, or invalid64_t on error.
+	 *
+	 * Implementations which can not transfer at an offset natively, position the
+	 * file under an internal lock, so they are safe to use, but not concurrent.
+	 * Positional transfers should not be mixed with read()/write() from other threads.
+	 */
+	virtual int64_t readAt(int64_t nOffset, void *oBuffer, int64_t nLen) = 0;
+	virtual int64_t writeAt(int64_t nOffset, void const *oBuffer, int64_t nLen) = 0;
+
+	/**
+	 * readv() and writev() transfer multiple buffers in the given order, just like a
+	 * sequence of read()/write() calls, but implementations can do it with a single
+	 * system call or a single copy loop. They return the total number of bytes
+	 * transferred, or invalid64_t if nothing could be transferred due to an error.
+	 */
+	virtual int64_t readv(buffer_span const *oSpans, size_t nCount) = 0;
+	virtual int64_t writev(const_buffer_span const *oSpans, size_t nCount) = 0;
+
+	/**
+	 * peek() returns a view of the data at the current position, without copying it,
+	 * and nAvailable receives the number of valid bytes in the view. Where possible at
+	 * least nMinBytes are returned, unless the end of the file is reached first. The
+	 * position is not changed until consume() is called with the number of bytes the
+	 * client has processed. consume() returns the number of bytes actually skipped.
+	 *
+	 * The view is only valid until the next operation on the file. Implementations which
+	 * can not provide a view return NULL, and the client has to use read() instead.
+	 */
+	virtual const char *peek(int64_t nMinBytes, int64_t &nAvailable) = 0;
+	virtual int64_t consume(int64_t nBytes) = 0;
+
 	virtual bool isOpen(void) const = 0;
 
 	virtual void setFilename(Filename const &oFilename) = 0;
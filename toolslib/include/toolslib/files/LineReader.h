@@ -0,0 +1,109 @@
+#ifndef _LINE_READER_H
+#define _LINE_READER_H
+
+#include <string_view>
+#include <vector>
+
+#include "toolslib/toolslib_api.h"
+#include "toolslib/toolslib_def.h"
+#include "toolslib/files/IFile.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+/**
+ * LineReader splits the content of any IFile into lines. The newlines are searched
+ * with SSE2 or AVX2, depending on the CPU, and the lines are returned as views into
+ * the buffer, so there is no allocation per line.
+ *
+ * Files which support peek() (MemoryFile, MappedFile, ...) are read without copying
+ * the data at all. Only lines which cross the end of such a view are copied together.
+ * All other files are read into an own buffer, which grows if a single line doesn't fit.
+ *
+ * Like ByteStream, the reader reads ahead, so the position of the file doesn't
+ * correspond to the lines returned so far.
+ */
+class TOOLSLIB_API LineReader
+{
+public:
+	static const size_t default_buffer_size = 256*1024;
+
+public:
+	LineReader(IFile &oFile, bool bStripCR = true, size_t nBufferSize = default_buffer_size);
+	virtual ~LineReader(void);
+
+	/**
+	 * Returns the next line without the newline, and without a trailing CR if bStripCR
+	 * was set. The view is only valid until the next call. A last line without a
+	 * newline is returned as well. Returns false at the end of the file.
+	 */
+	bool readLine(std::string_view &oLine);
+
+	/**
+	 * Calls oCallback(std::string_view) for each remaining line, until the callback
+	 * returns false. Returns the number of lines passed to the callback.
+	 */
+	template <typename Callback>
+	int64_t forEachLine(Callback oCallback)
+	{
+		int64_t lines = 0;
+		std::string_view line;
+
+		while (readLine(line))
+		{
+			lines++;
+			if (!oCallback(line))
+				break;
+		}
+
+		return lines;
+	}
+
+	/**
+	 * Number of lines returned so far.
+	 */
+	int64_t getLineNumber(void) const
+	{
+		return mLineNumber;
+	}
+
+	bool getStripCR(void) const
+	{
+		return mStripCR;
+	}
+
+	void setStripCR(bool bStripCR = true)
+	{
+		mStripCR = bStripCR;
+	}
+
+protected:
+	/**
+	 * Keeps the unfinished line [mCur, mEnd) and provides more data. Returns false
+	 * when the end of the file is reached.
+	 */
+	bool refill(void);
+	bool makeLine(const char *pLine, size_t nLength, std::string_view &oLine);
+
+private:
+	IFile &mFile;
+	std::vector<char> mBuffer;
+	std::vector<char> mCarry;		// A line which crossed the end of a view.
+	const char *mCur;
+	const char *mEnd;
+	int64_t mViewLength;			// Length of the current view, which is consumed on refill.
+	int64_t mLineNumber;
+	bool mUseViews:1;
+	bool mViewsChecked:1;
+	bool mEOF:1;
+	bool mStripCR:1;
+};
+
+}
+
+}
+
+#endif // _LINE_READER_H
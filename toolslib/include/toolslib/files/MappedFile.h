@@ -0,0 +1,97 @@
+#ifndef _MAPPED_FILE_H
+#define _MAPPED_FILE_H
+
+#include "toolslib/files/BaseFile.h"
+#include "toolslib/files/SystemIO.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+/**
+ * MappedFile maps the whole file into the address space of the process, so
+ * read(), seek() and tell() are simple pointer arithmetic and no data is copied
+ * through an intermediate stream buffer.
+ *
+ * If the file is opened for writing, the mapping is grown as needed when data
+ * is written beyond the current end. On close() the file is truncated to the
+ * number of bytes actually written.
+ *
+ * getFileBuffer() returns the mapping itself and getFileBufferSize() returns the
+ * length of the file, which is the part of the mapping holding valid data, so the
+ * client can access the file content directly. The pointer is only valid until the
+ * file is closed or written beyond its end.
+ *
+ * readAt() and writeAt() within the file can run concurrently on disjoint ranges.
+ * A writeAt() beyond the end of the file changes the length and may remap the file,
+ * so it must not overlap any other access, not even on another range.
+ */
+class TOOLSLIB_API MappedFile
+: public virtual BaseFile
+{
+public:
+	using IFile::open;
+
+	MappedFile(Filename const &oFilename = "");
+	~MappedFile(void) override;
+
+	bool open(void) override;
+	void close(void) override;
+	void flush(void) override;
+	int64_t read(void *oBuffer, int64_t nLen) override;
+	int64_t write(void const *oBuffer, int64_t nLen) override;
+	int64_t seek(int64_t nOffset, IFile::seek_pos nPos) override;
+	int64_t tell(void) override;
+	int64_t length(void) override;
+	int getChar(void) override;
+	int64_t readAt(int64_t nOffset, void *oBuffer, int64_t nLen) override;
+	int64_t writeAt(int64_t nOffset, void const *oBuffer, int64_t nLen) override;
+	int64_t readv(buffer_span const *oSpans, size_t nCount) override;
+	int64_t writev(const_buffer_span const *oSpans, size_t nCount) override;
+	const char *peek(int64_t nMinBytes, int64_t &nAvailable) override;
+	int64_t consume(int64_t nBytes) override;
+
+	uint64_t getFileBufferSize(void) const override;
+	char *getFileBuffer(void) const override;
+
+	/**
+	 * Only if the file is read only. Otherwise the mapping may contain data which is
+	 * not yet written, and the file may be larger than the data.
+	 */
+	sysio::handle_t getNativeHandle(void) const override;
+
+protected:
+	// The mapping replaces the stream buffer, so no buffer is allocated.
+	char *allocateFileBuffer(int64_t nSize) override;
+	void freeFileBuffer(char *oFileBuffer) override;
+
+	/**
+	 * Map nLength bytes of the file. If the file is writeable and smaller, it is
+	 * extended to nLength first.
+	 */
+	bool map(int64_t nLength);
+	void unmap(void);
+
+private:
+	typedef BaseFile super;
+
+	void init(void);
+
+private:
+	sysio::handle_t mFileHandle;
+#ifdef _WIN32
+	void *mMappingHandle;
+#endif
+	char *mMapping;
+	int64_t mMappedLength;	// Size of the mapping
+	int64_t mFileLength;		// Logical length of the file
+	int64_t mFilePos;
+};
+
+}
+
+}
+
+#endif // _MAPPED_FILE_H
@@ -1,6 +1,7 @@
 #ifndef _MEMORYFILE_H
 #define _MEMORYFILE_H
 
+#include <memory>
 #include <vector>
 
 #include "toolslib/files/BaseFile.h"
@@ -14,15 +15,31 @@ namespace files
 /**
  * Memoryfile stores a file simply in memory, so it can be used for fast access
  * with the same interface but no disk io.
+ *
+ * The memory is not one flat buffer. Small files live in a head segment, which grows
+ * like a vector up to chunk_size. Everything beyond goes into fixed chunks of chunk_size,
+ * so appending never relocates the data which was already written. If one flat buffer
+ * is needed, contiguous() provides it.
+ *
+ * Existing data can be handed over without copying it: adopt() takes over a vector,
+ * and wrap() uses a foreign buffer read only. release() hands the storage back.
+ *
+ * snapshot() creates a read only copy, which shares the storage with the original.
+ * A segment is only copied when the original modifies it while it is still shared.
  */
 class TOOLSLIB_API MemoryFile
 : public virtual BaseFile
 {
+public:
+	static const int64_t chunk_size = 1024*1024;
+
 public:
 	using IFile::open;
 	using IFile::getFilename;
 
 	MemoryFile(Filename const &oFilename = "");
+	MemoryFile(std::vector<uint8_t> &&oData, Filename const &oFilename = "");
+	MemoryFile(void const *pData, int64_t nLength, Filename const &oFilename = "");
 	~MemoryFile(void) override;
 
 	bool open(void) override;
@@ -35,6 +52,12 @@ public:
 	int64_t tell(void) override;
 	int64_t length(void) override;
 	int getChar(void) override;
+	int64_t readAt(int64_t nOffset, void *oBuffer, int64_t nLen) override;
+	int64_t writeAt(int64_t nOffset, void const *oBuffer, int64_t nLen) override;
+	int64_t readv(buffer_span const *oSpans, size_t nCount) override;
+	int64_t writev(const_buffer_span const *oSpans, size_t nCount) override;
+	const char *peek(int64_t nMinBytes, int64_t &nAvailable) override;
+	int64_t consume(int64_t nBytes) override;
 
 public:
 	/**
@@ -44,17 +67,137 @@ public:
 	void reserve(int64_t nLen);
 
 	/**
-	 * Directly set the length of the file.
+	 * Directly set the length of the file. New space is filled with zeroes.
 	 */
 	void resize(int64_t nLen);
 
+	/**
+	 * Returns the whole file as one flat buffer. If the file is stored in more than one
+	 * segment, the data is moved into a single buffer first, so this should only be
+	 * used if it is really needed. The pointer is valid until the file is modified.
+	 */
+	const uint8_t *contiguous(void);
+
+	/**
+	 * Replaces the content with the moved in vector. The file must still be opened,
+	 * without truncate, to access the data.
+	 */
+	void adopt(std::vector<uint8_t> &&oData);
+
+	/**
+	 * Uses the buffer as the content, without copying or owning it. The caller has
+	 * to keep the buffer alive, and the file can only be opened for reading.
+	 */
+	void wrap(void const *pData, int64_t nLength);
+
+	/**
+	 * Returns the content and leaves the file empty. The vector is moved out if the
+	 * file consists of a single owned segment, otherwise the data is copied.
+	 */
+	std::vector<uint8_t> release(void);
+
+	bool isWrapped(void) const
+	{
+		return mStorage->Wrapped;
+	}
+
+	/**
+	 * Returns an open, read only file with its own position, which keeps the content
+	 * as it is now. Creating the snapshot costs no copy. The snapshot can be used by
+	 * another thread, while the original is modified. Calls to snapshot() itself must
+	 * be serialized with the writes to the original.
+	 */
+	std::unique_ptr<MemoryFile> snapshot(void) const;
+
+	bool isSnapshot(void) const
+	{
+		return mSnapshot;
+	}
+
+protected:
+	/**
+	 * The content of the file, which is shared with the snapshots.
+	 */
+	typedef struct
+	{
+		std::shared_ptr<std::vector<uint8_t>> HeadMem;		// NULL if the head is a wrapped buffer.
+		uint8_t *Head;
+		int64_t HeadSize;
+		std::vector<std::shared_ptr<uint8_t>> Chunks;
+		int64_t Length;
+		bool Wrapped;
+	} storage_t;
+
+	/**
+	 * Returns the memory at nOffset and in nAvailable how many bytes follow in the same
+	 * segment. The offset must be within the allocated space.
+	 */
+	const uint8_t *locate(int64_t nOffset, int64_t &nAvailable) const
+	{
+		storage_t const &st = *mStorage;
+		if (nOffset < st.HeadSize)
+		{
+			nAvailable = st.HeadSize - nOffset;
+			return st.Head + nOffset;
+		}
+
+		int64_t offset = nOffset - st.HeadSize;
+		int64_t pos = offset % chunk_size;
+		nAvailable = chunk_size - pos;
+
+		return st.Chunks[(size_t)(offset / chunk_size)].get() + pos;
+	}
+
+	/**
+	 * Like locate(), but the segment is copied first if it is shared with a snapshot.
+	 */
+	uint8_t *locateWritable(int64_t nOffset, int64_t &nAvailable);
+
+	/**
+	 * Returns the storage for modifications. If it is shared with a snapshot, a
+	 * new list of the same segments is created first.
+	 */
+	storage_t &writable(void);
+
+	bool isReadOnly(void) const
+	{
+		return mSnapshot || mStorage->Wrapped;
+	}
+
+	/**
+	 * The data is in memory already, so there is no point in a large buffer or in
+	 * looking up the filename.
+	 */
+	uint64_t proposeFileBufferSize(void) override
+	{
+		return 4096u;
+	}
+
+	/**
+	 * Makes sure that space up to nLength is allocated, without changing the length of the file.
+	 */
+	void allocate(int64_t nLength);
+
+	/**
+	 * Sets the length of the file. The gap between the old length and nFill is zeroed,
+	 * the rest is expected to be written by the caller.
+	 */
+	void extend(int64_t nLength, int64_t nFill);
+
+	void copyIn(int64_t nOffset, void const *oBuffer, int64_t nLen);
+	void copyOut(int64_t nOffset, void *oBuffer, int64_t nLen) const;
+
 private:
 	typedef BaseFile super;
 
+	void init(void);
+	void setHead(std::shared_ptr<std::vector<uint8_t>> const &oHead);
+
 private:
-	std::vector<uint8_t> mFileMem;
+	std::shared_ptr<storage_t> mStorage;
 	int64_t mFilePos;
 	int64_t mEndPos;
+	bool mSnapshot;
 };
 
 }
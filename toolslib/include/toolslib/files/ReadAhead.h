@@ -0,0 +1,97 @@
+#ifndef _READ_AHEAD_H
+#define _READ_AHEAD_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "toolslib/toolslib_api.h"
+#include "toolslib/toolslib_def.h"
+#include "toolslib/files/SystemIO.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+/**
+ * ReadAhead prefetches a file sequentially with a background thread. The thread
+ * fills a ring of nDepth chunks with positional reads, while the consumer drains
+ * the chunks which are already filled, so I/O and processing overlap. With a depth
+ * of 2 this is classic double buffering.
+ *
+ * The handle is only read with positional reads, so its file pointer is not used.
+ * A seek() discards the prefetched data, unless the target is already in the ring.
+ *
+ * With bDropBehind the chunks are dropped from the cache of the OS as soon as they
+ * are read, so a single pass over a large file doesn't push other data out.
+ */
+class TOOLSLIB_API ReadAhead
+{
+public:
+	static const size_t default_depth = 2;
+	static const size_t default_chunk_size = 1024*1024;
+
+public:
+	ReadAhead(sysio::handle_t nHandle, int64_t nPosition, size_t nDepth = default_depth, size_t nChunkSize = default_chunk_size, bool bDropBehind = false);
+	virtual ~ReadAhead(void);
+
+	/**
+	 * Returns the prefetched data, waiting for the thread if necessary. Returns
+	 * less than nLen only at the end of the file, and invalid64_t if the read
+	 * failed before any data could be returned.
+	 */
+	int64_t read(void *oBuffer, int64_t nLen);
+
+	/**
+	 * Continues at the absolute position nPosition.
+	 */
+	void seek(int64_t nPosition);
+
+	int64_t tell(void) const
+	{
+		return mPosition;
+	}
+
+	bool isEOF(void) const
+	{
+		return mEOF;
+	}
+
+protected:
+	void run(void);
+
+private:
+	typedef struct
+	{
+		std::vector<char> Data;
+		int64_t Length;
+	} chunk_t;
+
+	sysio::handle_t mHandle;
+	std::vector<chunk_t> mChunks;
+	size_t mHead;					// First filled chunk.
+	size_t mFilled;					// Number of filled chunks, starting at mHead.
+	int64_t mHeadOffset;			// Consumed bytes in the head chunk.
+	int64_t mPosition;				// Position of the consumer.
+	int64_t mFetchPosition;			// Position of the next read of the thread.
+	uint64_t mGeneration;			// Changes with each seek, so stale reads are dropped.
+	bool mFetchEnd;
+	bool mFetchError;
+	bool mEOF;
+	bool mStop;
+	bool mDropBehind;
+
+	std::mutex mLock;
+	std::condition_variable mFilledSignal;
+	std::condition_variable mDrainedSignal;
+	std::thread mThread;
+};
+
+}
+
+}
+
+#endif // _READ_AHEAD_H
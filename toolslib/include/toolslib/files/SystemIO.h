@@ -0,0 +1,109 @@
+#ifndef _SYSTEM_IO_H
+#define _SYSTEM_IO_H
+
+#include <string>
+
+#include "toolslib/toolslib_api.h"
+#include "toolslib/toolslib_def.h"
+#include "toolslib/files/IFile.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+/**
+ * sysio is a thin layer over the native file descriptors (POSIX) or handles (Windows),
+ * so the file backends don't need to care about the platform. All transfers are
+ * positional, so a handle has no cursor that must be shared or protected.
+ */
+namespace sysio
+{
+
+// On Windows this is a HANDLE, otherwise a file descriptor. INVALID_HANDLE_VALUE is -1 as well.
+typedef intptr_t handle_t;
+
+static const handle_t invalid_handle = -1;
+
+/**
+ * Opens the file according to the openmode. The file is created if create is set or
+ * if it is writeable and truncate is set. Append is not handled here, because it is
+ * not compatible with positional writes, so the caller has to position the writes.
+ * The access hints of the openmode are applied to the new handle.
+ *
+ * With bUnbuffered the cache of the OS is bypassed (O_DIRECT, F_NOCACHE on macOS and
+ * FILE_FLAG_NO_BUFFERING on Windows). Offsets, lengths and memory of all transfers
+ * must then be aligned to the sector size. If the filesystem doesn't support this
+ * invalid_handle is returned.
+ */
+handle_t TOOLSLIB_API openFile(std::string const &oPath, IFile::open_mode const &oMode, bool bUnbuffered = false);
+void TOOLSLIB_API closeFile(handle_t nHandle);
+
+/**
+ * Passes the access hints of the openmode to the OS. On Windows the hints can only be
+ * given when the file is opened, so this does nothing there.
+ */
+void TOOLSLIB_API adviseFile(handle_t nHandle, IFile::open_mode const &oMode);
+
+/**
+ * Tells the OS that the range was consumed and can be dropped from the cache. A length
+ * of 0 means up to the end of the file. Pages which are not written yet are kept.
+ */
+void TOOLSLIB_API dropCache(handle_t nHandle, int64_t nOffset, int64_t nLength);
+
+/**
+ * Reads/writes up to nLen bytes at the given offset, without using or modifying a file
+ * position. Partial transfers are repeated, so less than nLen bytes are only returned
+ * at the end of the file. On error invalid64_t is returned.
+ */
+int64_t TOOLSLIB_API readAt(handle_t nHandle, int64_t nOffset, void *oBuffer, int64_t nLen);
+int64_t TOOLSLIB_API writeAt(handle_t nHandle, int64_t nOffset, void const *oBuffer, int64_t nLen);
+
+/**
+ * Vectored versions of readAt()/writeAt(). Where the platform supports it (preadv/pwritev)
+ * all buffers are transferred with a single system call.
+ */
+int64_t TOOLSLIB_API readAt(handle_t nHandle, int64_t nOffset, IFile::buffer_span const *oSpans, size_t nCount);
+int64_t TOOLSLIB_API writeAt(handle_t nHandle, int64_t nOffset, IFile::const_buffer_span const *oSpans, size_t nCount);
+
+/**
+ * Returns the current size of the open file, or invalid64_t on error.
+ */
+int64_t TOOLSLIB_API fileSize(handle_t nHandle);
+bool TOOLSLIB_API truncateFile(handle_t nHandle, int64_t nLength);
+
+/**
+ * Returns the length and the preferred transfer size of the open file. Each one is -1 if
+ * it is not known, the length as well if the handle doesn't refer to a regular file.
+ */
+bool TOOLSLIB_API fileInfo(handle_t nHandle, int64_t &nLength, int64_t &nBlockSize);
+
+/**
+ * Finds the first range of data at or behind nOffset, skipping the holes of a sparse
+ * file. Returns false if there is no more data. If the platform or the filesystem
+ * can't tell, everything up to the end of the file is data.
+ */
+bool TOOLSLIB_API findData(handle_t nHandle, int64_t nOffset, int64_t &nDataBegin, int64_t &nDataEnd);
+
+/**
+ * Makes the target share the blocks of the source (reflink), so it is an instant copy.
+ * The target should be empty. Returns false if the filesystem doesn't support this.
+ */
+bool TOOLSLIB_API cloneFile(handle_t nSource, handle_t nTarget);
+
+/**
+ * Copies the range within the kernel (copy_file_range or sendfile), without passing
+ * the data through user space. Returns the number of bytes copied, which is less than
+ * nLen at the end of the source, or if the copy failed on the way. If the kernel can't
+ * copy between the two files, invalid64_t is returned and nothing was copied.
+ */
+int64_t TOOLSLIB_API copyRange(handle_t nSource, int64_t nSourceOffset, handle_t nTarget, int64_t nTargetOffset, int64_t nLen);
+
+}
+
+}
+
+}
+
+#endif // _SYSTEM_IO_H
@@ -0,0 +1,103 @@
+#ifndef _WRITE_BEHIND_H
+#define _WRITE_BEHIND_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "toolslib/toolslib_api.h"
+#include "toolslib/toolslib_def.h"
+#include "toolslib/files/SystemIO.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+/**
+ * WriteBehind takes the disk latency off the writer. write() only copies into a ring
+ * of nDepth buffers, and a background thread drains the full buffers with positional
+ * writes. Consecutive buffers are written with a single vectored call.
+ *
+ * Write errors are sticky: once the thread failed, all following calls fail, so the
+ * error is reported by the next write(), flush() or close of the owner.
+ */
+class TOOLSLIB_API WriteBehind
+{
+public:
+	static const size_t default_depth = 4;
+	static const size_t default_buffer_size = 1024*1024;
+
+public:
+	WriteBehind(sysio::handle_t nHandle, int64_t nPosition, size_t nDepth = default_depth, size_t nBufferSize = default_buffer_size);
+
+	/**
+	 * Waits until all data is written.
+	 */
+	virtual ~WriteBehind(void);
+
+	/**
+	 * Copies the data into the buffers and returns nLen, or invalid64_t if a previous
+	 * write failed. Only blocks if all buffers are waiting to be written.
+	 */
+	int64_t write(void const *oBuffer, int64_t nLen);
+
+	/**
+	 * Barrier which returns after all data written so far is on the disk (or at least
+	 * in the OS cache). Returns false if any write failed.
+	 */
+	bool flush(void);
+
+	/**
+	 * Continues writing at the absolute position nPosition. The pending data is
+	 * still written before, so the order of the writes is kept.
+	 */
+	bool seek(int64_t nPosition);
+
+	int64_t tell(void) const
+	{
+		return mPosition;
+	}
+
+	/**
+	 * True if a write of the thread failed.
+	 */
+	bool hasError(void) const;
+
+protected:
+	void run(void);
+
+	/**
+	 * Hands the current buffer over to the thread, and waits for a free one.
+	 */
+	void submit(std::unique_lock<std::mutex> &oLock);
+
+private:
+	typedef struct
+	{
+		std::vector<char> Data;
+		int64_t Length;
+		int64_t Position;
+	} buffer_t;
+
+	sysio::handle_t mHandle;
+	std::vector<buffer_t> mBuffers;
+	size_t mHead;					// Oldest buffer which has to be written.
+	size_t mQueued;					// Number of buffers waiting for the thread, starting at mHead.
+	int64_t mPosition;
+	bool mError;
+	bool mStop;
+
+	mutable std::mutex mLock;
+	std::condition_variable mQueuedSignal;
+	std::condition_variable mWrittenSignal;
+	std::thread mThread;
+};
+
+}
+
+}
+
+#endif // _WRITE_BEHIND_H
@@ -79,6 +79,17 @@ public:
 
 	static bool isHeader(const char *pBuffer, size_t nBufferLen);
 
+protected:
+	/**
+	 * The buffer size is applied to the buffer for the compressed data of the archive.
+	 */
+	uint64_t proposeFileBufferSize(void) override;
+
+	/**
+	 * The library has its own buffers, so none is allocated here.
+	 */
+	char *allocateFileBuffer(int64_t nSize) override;
+
 private:
 	typedef BaseFile super;
 
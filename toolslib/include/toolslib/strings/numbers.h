@@ -27,7 +27,7 @@ namespace toolslib
 		template <typename T>
 		T fromDecimal(const char *str, const char *end, const char **pScanned)
 		{
-			static_assert(false, "Unspported type!");
+			static_assert(sizeof(T) == 0, "Unspported type!");
 		}
 
 		// ******************************************************************************
@@ -45,7 +45,7 @@ namespace toolslib
 		template <typename T>
 		T fromUnsignedDecimal(const char *str, const char *end, const char **pScanned)
 		{
-			static_assert(false, "Unspported type!");
+			static_assert(sizeof(T) == 0, "Unspported type!");
 		}
 
 		// These are unsigned types and a negaitve input will cause an error.
@@ -58,7 +58,7 @@ namespace toolslib
 		template <typename T>
 		T fromHex(const char *str, const char *end, const char **pScanned)
 		{
-			static_assert(false, "Unspported type!");
+			static_assert(sizeof(T) == 0, "Unspported type!");
 		}
 
 		template<> int8_t TOOLSLIB_API fromHex<int8_t>(const char *str, const char *end, const char **pScanned);
@@ -74,7 +74,7 @@ namespace toolslib
 		template <typename T>
 		T fromBinary(const char *str, const char *end, const char **pScanned)
 		{
-			static_assert(false, "Unspported type!");
+			static_assert(sizeof(T) == 0, "Unspported type!");
 		}
 
 		template<> int8_t TOOLSLIB_API fromBinary<int8_t>(const char *str, const char *end, const char **pScanned);
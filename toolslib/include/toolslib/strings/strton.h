@@ -56,6 +56,7 @@
 #include <string>
 #include <limits>
 #include <exception>
+#include <stdexcept>
 #include <type_traits>
 
 #include "toolslib/toolslib_api.h"
@@ -15,6 +15,8 @@
 
 #endif
 
+#ifdef _MSC_VER
+
 typedef unsigned __int64 uint64_t;
 typedef unsigned __int32 uint32_t;
 typedef unsigned __int16 uint16_t;
@@ -25,6 +27,12 @@ typedef signed __int32 int32_t;
 typedef signed __int16 int16_t;
 typedef signed __int8 int8_t;
 
+#else
+
+#include <stdint.h>
+
+#endif // _MSC_VER
+
 static const size_t invalid = (size_t)-1;
 static const uint64_t invalid64u_t = (uint64_t)-1;
 static const uint32_t invalid32u_t = (uint32_t)-1;
@@ -36,8 +44,15 @@ static const int32_t invalid32_t = -1;
 static const int16_t invalid16_t = -1;
 static const int8_t invalid8_t = -1;
 
+// Set if the compiler supports C++20 coroutines (see files/Coroutines.h).
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define TOOLSLIB_COROUTINES
+#endif
+#endif
+
 #define __STR2__(x) #x
 #define TOOLSLIB_DEFINE_TO_STRING(x) __STR2__(x)
-#define TOOLSLIB_WARNING __FILE__ "("TOOLSLIB_DEFINE_TO_STRING(__LINE__)") : User warning: "
+#define TOOLSLIB_WARNING __FILE__ "(" TOOLSLIB_DEFINE_TO_STRING(__LINE__) ") : User warning: "
 
 #endif // __TOOLSLIB_DEF_H__
@@ -0,0 +1,54 @@
+/*******************************************************************************
+ *
+ * ToolsLib (c) by Gerhard W. Gruber in 2014
+ *
+ ******************************************************************************/
+
+#ifndef CPU_FEATURES_INCLUDED_H
+#define CPU_FEATURES_INCLUDED_H
+
+#include "toolslib/toolslib_api.h"
+#include "toolslib/toolslib_def.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define TOOLSLIB_X86 1
+#endif
+
+namespace toolslib
+{
+	namespace utils
+	{
+		/**
+		 * CPUFeatures reports the instruction set extensions of the CPU we are running on,
+		 * so SIMD code paths can be selected at runtime. The CPU is only queried once.
+		 * On non x86 platforms all features are reported as unavailable.
+		 */
+		class TOOLSLIB_API CPUFeatures
+		{
+		public:
+			static CPUFeatures const &get(void);
+
+			bool hasSSE2(void) const { return mSSE2; }
+			bool hasSSSE3(void) const { return mSSSE3; }
+			bool hasSSE42(void) const { return mSSE42; }
+			bool hasPCLMUL(void) const { return mPCLMUL; }
+
+			/**
+			 * AVX2 is only reported if the OS saves the YMM registers as well.
+			 */
+			bool hasAVX2(void) const { return mAVX2; }
+
+		protected:
+			CPUFeatures(void);
+
+		private:
+			bool mSSE2:1;
+			bool mSSSE3:1;
+			bool mSSE42:1;
+			bool mPCLMUL:1;
+			bool mAVX2:1;
+		};
+	}
+}
+
+#endif // CPU_FEATURES_INCLUDED_H
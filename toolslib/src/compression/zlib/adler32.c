@@ -6,11 +6,24 @@
 /* @(#) $Id$ */
 
 #include "zutil.h"
+#include "zlib_cpu.h"
+
+#ifdef ZLIB_X86
+#  include <immintrin.h>
+#  include <tmmintrin.h>
+#endif
 
 #define local static
 
 local uLong adler32_combine_ OF((uLong adler1, uLong adler2, z_off64_t len2));
 
+#ifdef ZLIB_X86
+/* Below this length the setup of the vectors doesn't pay off. */
+#  define ADLER32_SIMD_MINIMUM 64
+local uLong adler32_ssse3 OF((uLong adler, const Bytef *buf, uInt len));
+local uLong adler32_avx2 OF((uLong adler, const Bytef *buf, uInt len));
+#endif
+
 #define BASE 65521      /* largest prime smaller than 65536 */
 #define NMAX 5552
 /* NMAX is the largest n such that 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1 */
@@ -98,6 +111,16 @@ uLong ZEXPORT adler32(uLong adler, const Bytef *buf, uInt len)
         return adler | (sum2 << 16);
     }
 
+#ifdef ZLIB_X86
+    if (len >= ADLER32_SIMD_MINIMUM) {
+        cpu_check_features();
+        if (x86_cpu_has_avx2)
+            return adler32_avx2(adler | (sum2 << 16), buf, len);
+        if (x86_cpu_has_ssse3)
+            return adler32_ssse3(adler | (sum2 << 16), buf, len);
+    }
+#endif
+
     /* do length NMAX blocks -- requires just one modulo operation */
     while (len >= NMAX) {
         len -= NMAX;
@@ -129,6 +152,163 @@ uLong ZEXPORT adler32(uLong adler, const Bytef *buf, uInt len)
     return adler | (sum2 << 16);
 }
 
+#ifdef ZLIB_X86
+
+/* Sums the four 32-bit lanes. */
+#define HSUM128(v) \
+    (v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1))), \
+     v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2))), \
+     (unsigned long)(unsigned)_mm_cvtsi128_si32(v))
+
+/* =========================================================================
+ * The bytes which are left over by the vector loops.
+ */
+local uLong adler32_tail(unsigned long adler, unsigned long sum2,
+                         const Bytef *buf, uInt len)
+{
+    while (len >= 16) {
+        len -= 16;
+        DO16(buf);
+        buf += 16;
+    }
+    while (len--) {
+        adler += *buf++;
+        sum2 += adler;
+    }
+    MOD(adler);
+    MOD(sum2);
+    return adler | (sum2 << 16);
+}
+
+/* =========================================================================
+ * Adler-32 with SSSE3, 32 bytes per step. Within a block of n bytes, the byte
+ * at position i adds (n - i) times to sum2, which is what the multiply-add with
+ * the descending taps computes. The sum of the previous blocks adds 32 times
+ * for every further block, that's collected in v_ps. There are at most NMAX
+ * bytes between the modulos, as in the scalar version.
+ */
+ZLIB_TARGET("ssse3")
+local uLong adler32_ssse3(uLong adler, const Bytef *buf, uInt len)
+{
+    unsigned long s1 = adler & 0xffff;
+    unsigned long s2 = (adler >> 16) & 0xffff;
+    uInt blocks = len / 32;
+
+    const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25,
+                                       24, 23, 22, 21, 20, 19, 18, 17);
+    const __m128i tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9,
+                                       8, 7, 6, 5, 4, 3, 2, 1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+
+    len -= blocks * 32;
+    while (blocks) {
+        unsigned n = NMAX / 32;
+        __m128i v_ps, v_s1, v_s2;
+
+        if (n > blocks)
+            n = (unsigned)blocks;
+        blocks -= n;
+
+        v_ps = _mm_cvtsi32_si128((int)(s1 * n));
+        v_s2 = _mm_cvtsi32_si128((int)s2);
+        v_s1 = _mm_setzero_si128();
+
+        do {
+            const __m128i bytes1 = _mm_loadu_si128((const __m128i *)buf);
+            const __m128i bytes2 = _mm_loadu_si128((const __m128i *)(buf + 16));
+
+            v_ps = _mm_add_epi32(v_ps, v_s1);
+
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes1, zero));
+            v_s2 = _mm_add_epi32(v_s2,
+                       _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes2, zero));
+            v_s2 = _mm_add_epi32(v_s2,
+                       _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+
+            buf += 32;
+        } while (--n);
+
+        v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+
+        s1 += HSUM128(v_s1);
+        s2 = HSUM128(v_s2);
+        MOD(s1);
+        MOD(s2);
+    }
+
+    return adler32_tail(s1, s2, buf, len);
+}
+
+/* =========================================================================
+ * Like adler32_ssse3(), but with 256-bit vectors, 64 bytes per step.
+ */
+ZLIB_TARGET("avx2")
+local uLong adler32_avx2(uLong adler, const Bytef *buf, uInt len)
+{
+    unsigned long s1 = adler & 0xffff;
+    unsigned long s2 = (adler >> 16) & 0xffff;
+    uInt blocks = len / 64;
+
+    const __m256i tap1 = _mm256_setr_epi8(64, 63, 62, 61, 60, 59, 58, 57,
+                                          56, 55, 54, 53, 52, 51, 50, 49,
+                                          48, 47, 46, 45, 44, 43, 42, 41,
+                                          40, 39, 38, 37, 36, 35, 34, 33);
+    const __m256i tap2 = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25,
+                                          24, 23, 22, 21, 20, 19, 18, 17,
+                                          16, 15, 14, 13, 12, 11, 10, 9,
+                                          8, 7, 6, 5, 4, 3, 2, 1);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(1);
+
+    len -= blocks * 64;
+    while (blocks) {
+        unsigned n = NMAX / 64;
+        __m256i v_ps, v_s1, v_s2;
+        __m128i v;
+
+        if (n > blocks)
+            n = (unsigned)blocks;
+        blocks -= n;
+
+        v_ps = _mm256_set_epi32(0, 0, 0, 0, 0, 0, 0, (int)(s1 * n));
+        v_s2 = _mm256_set_epi32(0, 0, 0, 0, 0, 0, 0, (int)s2);
+        v_s1 = _mm256_setzero_si256();
+
+        do {
+            const __m256i bytes1 = _mm256_loadu_si256((const __m256i *)buf);
+            const __m256i bytes2 = _mm256_loadu_si256((const __m256i *)(buf + 32));
+
+            v_ps = _mm256_add_epi32(v_ps, v_s1);
+
+            v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(bytes1, zero));
+            v_s2 = _mm256_add_epi32(v_s2,
+                       _mm256_madd_epi16(_mm256_maddubs_epi16(bytes1, tap1), ones));
+
+            v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(bytes2, zero));
+            v_s2 = _mm256_add_epi32(v_s2,
+                       _mm256_madd_epi16(_mm256_maddubs_epi16(bytes2, tap2), ones));
+
+            buf += 64;
+        } while (--n);
+
+        v_s2 = _mm256_add_epi32(v_s2, _mm256_slli_epi32(v_ps, 6));
+
+        v = _mm_add_epi32(_mm256_castsi256_si128(v_s1), _mm256_extracti128_si256(v_s1, 1));
+        s1 += HSUM128(v);
+        v = _mm_add_epi32(_mm256_castsi256_si128(v_s2), _mm256_extracti128_si256(v_s2, 1));
+        s2 = HSUM128(v);
+        MOD(s1);
+        MOD(s2);
+    }
+
+    return adler32_tail(s1, s2, buf, len);
+}
+
+#endif /* ZLIB_X86 */
+
 /* ========================================================================= */
 local uLong adler32_combine_(uLong adler1, uLong adler2, z_off64_t len2)
 {
@@ -50,6 +50,23 @@
 /* @(#) $Id$ */
 
 #include "deflate.h"
+#include "zlib_cpu.h"
+#include "deflate_hash.h"
+
+#ifdef ZLIB_X86
+#  include <emmintrin.h>
+#  include <nmmintrin.h>
+#  ifndef ASMV
+#    include <immintrin.h>
+#  endif
+#endif
+
+/* The asm longest_match() (gvmat32/gvmat64) skips the compare of the third byte,
+   which only the old rolling hash guarantees, and hard codes the offsets of the
+   old deflate_state. */
+#ifdef ASMV
+#  error ASMV is not supported with the CRC-32C hash, use the C longest_match()
+#endif
 
 #pragma warning(disable : 4127 4244)
 
@@ -75,10 +92,12 @@ typedef enum {
 typedef block_state (*compress_func) OF((deflate_state *s, int flush));
 /* Compression function. Returns the block state after the call. */
 
+local void slide_hash     OF((Posf *table, unsigned n, uInt wsize));
 local void fill_window    OF((deflate_state *s));
 local block_state deflate_stored OF((deflate_state *s, int flush));
 local block_state deflate_fast   OF((deflate_state *s, int flush));
 #ifndef FASTEST
+local block_state deflate_medium OF((deflate_state *s, int flush));
 local block_state deflate_slow   OF((deflate_state *s, int flush));
 #endif
 local block_state deflate_rle    OF((deflate_state *s, int flush));
@@ -94,6 +113,20 @@ local int read_buf        OF((z_streamp strm, Bytef *buf, unsigned size));
 local uInt longest_match  OF((deflate_state *s, IPos cur_match));
 #endif
 
+#if !defined(ASMV) && !defined(FASTEST)
+/* Returns the number of equal bytes at the start of scan and match, at most
+   256. longest_match() uses the fastest version for the CPU. */
+typedef uInt (*compare256_func) OF((const Bytef *scan, const Bytef *match));
+local uInt compare256_c     OF((const Bytef *scan, const Bytef *match));
+#ifdef ZLIB_X86
+local uInt compare256_sse42 OF((const Bytef *scan, const Bytef *match));
+local uInt compare256_avx2  OF((const Bytef *scan, const Bytef *match));
+#endif
+local void compare256_init  OF((void));
+
+local compare256_func compare256 = compare256_c;
+#endif
+
 #ifdef DEBUG
 local  void check_match OF((deflate_state *s, IPos start, IPos match,
                             int length));
@@ -137,17 +170,22 @@ local const config configuration_table[10] = {
 /* 2 */ {4,    5, 16,    8, deflate_fast},
 /* 3 */ {4,    6, 32,   32, deflate_fast},
 
-/* 4 */ {4,    4, 16,   16, deflate_slow},  /* lazy matches */
-/* 5 */ {8,   16, 32,   32, deflate_slow},
-/* 6 */ {8,   16, 128, 128, deflate_slow},
-/* 7 */ {8,   32, 128, 256, deflate_slow},
+/* 4 */ {4,    4, 16,   16, deflate_medium},  /* lazy at match ends */
+/* 5 */ {8,   16, 32,   32, deflate_medium},
+/* 6 */ {8,   16, 128, 128, deflate_medium},
+/* 7 */ {8,   32, 128, 256, deflate_slow},  /* lazy matches */
 /* 8 */ {32, 128, 258, 1024, deflate_slow},
 /* 9 */ {32, 258, 258, 4096, deflate_slow}}; /* max compression */
 #endif
 
 /* Note: the deflate() code requires max_lazy >= MIN_MATCH and max_chain >= 4
- * For deflate_fast() (levels <= 3) good is ignored and lazy has a different
- * meaning.
+ * For deflate_fast() and deflate_medium() (levels <= 6) good is ignored and
+ * lazy has a different meaning, or none.
+ *
+ * Levels 4-6 used deflate_slow() in upstream zlib. With deflate_medium() (and
+ * with the CRC-32C hash at all levels) the compressed output differs from
+ * upstream and from earlier versions of this library. It is still valid deflate
+ * data, but callers must not expect byte identical output for the same input.
  */
 
 #define EQUAL 0
@@ -161,13 +199,23 @@ struct static_tree_desc_s {int dummy;}; /* for buggy compilers */
 #define RANK(f) (((f) << 1) - ((f) > 4 ? 9 : 0))
 
 /* ===========================================================================
- * Update a hash value with the given input byte
- * IN  assertion: all calls to to UPDATE_HASH are made with consecutive
- *    input characters, so that a running hash key can be computed from the
- *    previous key instead of complete recalculation each time.
+ * Hash of the 4 bytes at str, their CRC-32C. The crc32 instruction of SSE4.2
+ * computes it at once, the table gives the same value without it, so the
+ * compressed data doesn't depend on the CPU. Unlike the running hash of the
+ * original zlib, each string is hashed on its own, so strings can be inserted
+ * in any order. The byte after the last MIN_MATCH bytes of the input may be
+ * garbage, which only costs a possible match.
  */
-#define UPDATE_HASH(s,h,c) (h = (((h)<<s->hash_shift) ^ (c)) & s->hash_mask)
+typedef uInt (*hash_func) OF((const Bytef *str));
+local uInt hash_c       OF((const Bytef *str));
+#ifdef ZLIB_X86
+local uInt hash_sse42   OF((const Bytef *str));
+#endif
+local void hash_init    OF((void));
+
+local hash_func hash_string = hash_c;
 
+#define HASH(s, str) (hash_string((s)->window + (str)) & (s)->hash_mask)
 
 /* ===========================================================================
  * Insert string str in the dictionary and set match_head to the previous head
@@ -175,20 +223,25 @@ struct static_tree_desc_s {int dummy;}; /* for buggy compilers */
  * the previous length of the hash chain.
  * If this file is compiled with -DFASTEST, the compression level is forced
  * to 1, and no hash chains are maintained.
- * IN  assertion: all calls to to INSERT_STRING are made with consecutive
- *    input characters and the first MIN_MATCH bytes of str are valid
- *    (except for the last MIN_MATCH-1 bytes of the input file).
+ * IN  assertion: the first MIN_MATCH bytes of str are valid (except for the
+ *    last MIN_MATCH-1 bytes of the input file).
  */
 #ifdef FASTEST
 #define INSERT_STRING(s, str, match_head) \
-   (UPDATE_HASH(s, s->ins_h, s->window[(str) + (MIN_MATCH-1)]), \
+   (s->ins_h = HASH(s, str), \
     match_head = s->head[s->ins_h], \
     s->head[s->ins_h] = (Pos)(str))
 #else
 #define INSERT_STRING(s, str, match_head) \
-   (UPDATE_HASH(s, s->ins_h, s->window[(str) + (MIN_MATCH-1)]), \
+   (s->ins_h = HASH(s, str), \
     match_head = s->prev[(str) & s->w_mask] = s->head[s->ins_h], \
     s->head[s->ins_h] = (Pos)(str))
+
+/* Same, for strings which are only inserted, not matched. */
+#define INSERT_STRING_ONLY(s, str) \
+   (s->ins_h = HASH(s, str), \
+    s->prev[(str) & s->w_mask] = s->head[s->ins_h], \
+    s->head[s->ins_h] = (Pos)(str))
 #endif
 
 /* ===========================================================================
@@ -289,7 +342,6 @@ int ZEXPORT deflateInit2_(
     s->hash_bits = memLevel + 7;
     s->hash_size = 1 << s->hash_bits;
     s->hash_mask = s->hash_size - 1;
-    s->hash_shift =  ((s->hash_bits+MIN_MATCH-1)/MIN_MATCH);
 
     s->window = (Bytef *) ZALLOC(strm, s->w_size, 2*sizeof(Byte));
     s->prev   = (Posf *)  ZALLOC(strm, s->w_size, sizeof(Pos));
@@ -366,7 +418,7 @@ int ZEXPORT deflateSetDictionary (
         str = s->strstart;
         n = s->lookahead - (MIN_MATCH-1);
         do {
-            UPDATE_HASH(s, s->ins_h, s->window[str + MIN_MATCH-1]);
+            s->ins_h = HASH(s, str);
 #ifndef FASTEST
             s->prev[str & s->w_mask] = s->head[s->ins_h];
 #endif
@@ -1117,10 +1169,57 @@ local void lm_init (deflate_state *s)
     s->match_length = s->prev_length = MIN_MATCH-1;
     s->match_available = 0;
     s->ins_h = 0;
+    hash_init();
 #ifndef FASTEST
 #ifdef ASMV
     match_init(); /* initialize the asm code */
+#else
+    compare256_init();
+#endif
 #endif
+}
+
+/* ===========================================================================
+ * Computes the CRC-32C of the 4 bytes at str a byte at a time.
+ */
+local uInt hash_c(str)
+    const Bytef *str;
+{
+    z_crc_t crc = 0;
+
+    crc = crc32c_table[(crc ^ str[0]) & 0xff] ^ (crc >> 8);
+    crc = crc32c_table[(crc ^ str[1]) & 0xff] ^ (crc >> 8);
+    crc = crc32c_table[(crc ^ str[2]) & 0xff] ^ (crc >> 8);
+    crc = crc32c_table[(crc ^ str[3]) & 0xff] ^ (crc >> 8);
+    return (uInt)crc;
+}
+
+#ifdef ZLIB_X86
+
+/* ===========================================================================
+ * Computes the same CRC-32C with one crc32 instruction.
+ */
+ZLIB_TARGET("sse4.2")
+local uInt hash_sse42(str)
+    const Bytef *str;
+{
+    unsigned int v;
+
+    zmemcpy((Bytef *)&v, str, sizeof(v));
+    return (uInt)_mm_crc32_u32(0, v);
+}
+
+#endif /* ZLIB_X86 */
+
+/* ===========================================================================
+ * Selects the hash version for the CPU. Concurrent calls are harmless, they
+ * all select the same one.
+ */
+local void hash_init()
+{
+#ifdef ZLIB_X86
+    cpu_check_features();
+    hash_string = x86_cpu_has_sse42 ? hash_sse42 : hash_c;
 #endif
 }
 
@@ -1135,8 +1234,133 @@ local void lm_init (deflate_state *s)
  * OUT assertion: the match length is not greater than s->lookahead.
  */
 #ifndef ASMV
-/* For 80x86 and 680x0, an optimized version will be provided in match.asm or
- * match.S. The code will be functionally equivalent.
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && \
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#  define CTZ32(x) __builtin_ctz(x)
+#  define CTZ64(x) __builtin_ctzll(x)
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#  include <intrin.h>
+local unsigned ctz32(unsigned long x)
+{
+    unsigned long i;
+    _BitScanForward(&i, x);
+    return (unsigned)i;
+}
+#  define CTZ32(x) ctz32(x)
+#  ifdef _M_X64
+local unsigned ctz64(unsigned long long x)
+{
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return (unsigned)i;
+}
+#    define CTZ64(x) ctz64(x)
+#  endif
+#endif
+
+/* ===========================================================================
+ * Compares 8 bytes at a time. The first different byte of a little endian
+ * word is found with the count of the trailing zeros of the difference.
+ */
+local uInt compare256_c(scan, match)
+    const Bytef *scan;
+    const Bytef *match;
+{
+    uInt len = 0;
+
+#ifdef CTZ64
+    do {
+        unsigned long long a, b;
+
+        zmemcpy((Bytef *)&a, scan + len, sizeof(a));
+        zmemcpy((Bytef *)&b, match + len, sizeof(b));
+        if (a != b)
+            return len + (uInt)(CTZ64(a ^ b) >> 3);
+        len += 8;
+    } while (len < 256);
+#else
+    do {
+        if (scan[len] != match[len]) return len;
+        if (scan[len+1] != match[len+1]) return len + 1;
+        if (scan[len+2] != match[len+2]) return len + 2;
+        if (scan[len+3] != match[len+3]) return len + 3;
+        len += 4;
+    } while (len < 256);
+#endif
+
+    return 256;
+}
+
+#ifdef ZLIB_X86
+
+/* ===========================================================================
+ * Compares 16 bytes at a time. pcmpestri returns the index of the first
+ * different byte, or 16 if all are equal.
+ */
+ZLIB_TARGET("sse4.2")
+local uInt compare256_sse42(scan, match)
+    const Bytef *scan;
+    const Bytef *match;
+{
+    uInt len = 0;
+
+    do {
+        __m128i a = _mm_loadu_si128((const __m128i *)(scan + len));
+        __m128i b = _mm_loadu_si128((const __m128i *)(match + len));
+        int i = _mm_cmpestri(a, 16, b, 16,
+                    _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_EACH | _SIDD_NEGATIVE_POLARITY);
+        if (i < 16)
+            return len + (uInt)i;
+        len += 16;
+    } while (len < 256);
+
+    return 256;
+}
+
+/* ===========================================================================
+ * Compares 32 bytes at a time, the equal bytes are set in the mask.
+ */
+ZLIB_TARGET("avx2")
+local uInt compare256_avx2(scan, match)
+    const Bytef *scan;
+    const Bytef *match;
+{
+    uInt len = 0;
+
+    do {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(scan + len));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(match + len));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+        if (mask != 0xffffffffU)
+            return len + (uInt)CTZ32(~mask);
+        len += 32;
+    } while (len < 256);
+
+    return 256;
+}
+
+#endif /* ZLIB_X86 */
+
+/* ===========================================================================
+ * Selects the compare256 version for the CPU. Concurrent calls are harmless,
+ * they all select the same one.
+ */
+local void compare256_init()
+{
+#ifdef ZLIB_X86
+    cpu_check_features();
+    if (x86_cpu_has_avx2)
+        compare256 = compare256_avx2;
+    else if (x86_cpu_has_sse42)
+        compare256 = compare256_sse42;
+    else
+        compare256 = compare256_c;
+#endif
+}
+
+/* For 80x86 and 680x0 on Windows, an optimized version is provided in
+ * gvmat32.asm and gvmat64.asm. The code is functionally equivalent.
  */
 local uInt longest_match(s, cur_match)
     deflate_state *s;
@@ -1155,22 +1379,12 @@ local uInt longest_match(s, cur_match)
      */
     Posf *prev = s->prev;
     uInt wmask = s->w_mask;
-
-#ifdef UNALIGNED_OK
-    /* Compare two bytes at a time. Note: this is not always beneficial.
-     * Try with and without -DUNALIGNED_OK to check.
-     */
-    register Bytef *strend = s->window + s->strstart + MAX_MATCH - 1;
-    register ush scan_start = *(ushf*)scan;
-    register ush scan_end   = *(ushf*)(scan+best_len-1);
-#else
-    register Bytef *strend = s->window + s->strstart + MAX_MATCH;
+    compare256_func compare = compare256;
     register Byte scan_end1  = scan[best_len-1];
     register Byte scan_end   = scan[best_len];
-#endif
 
-    /* The code is optimized for HASH_BITS >= 8 and MAX_MATCH-2 multiple of 16.
-     * It is easy to get rid of this optimization if necessary.
+    /* The comparison of the bytes behind the first two is exactly 256 bytes
+     * long, see below.
      */
     Assert(s->hash_bits >= 8 && MAX_MATCH == 258, "Code too clever");
 
@@ -1190,89 +1404,30 @@ local uInt longest_match(s, cur_match)
         match = s->window + cur_match;
 
         /* Skip to next match if the match length cannot increase
-         * or if the match length is less than 2.  Note that the checks below
-         * for insufficient lookahead only occur occasionally for performance
-         * reasons.  Therefore uninitialized memory will be accessed, and
-         * conditional jumps will be made that depend on those values.
-         * However the length of the match is limited to the lookahead, so
-         * the output of deflate is not affected by the uninitialized values.
-         */
-#if (defined(UNALIGNED_OK) && MAX_MATCH == 258)
-        /* This code assumes sizeof(unsigned short) == 2. Do not use
-         * UNALIGNED_OK if your compiler uses a different size.
-         */
-        if (*(ushf*)(match+best_len-1) != scan_end ||
-            *(ushf*)match != scan_start) continue;
-
-        /* It is not necessary to compare scan[2] and match[2] since they are
-         * always equal when the other bytes match, given that the hash keys
-         * are equal and that HASH_BITS >= 8. Compare 2 bytes at a time at
-         * strstart+3, +5, ... up to strstart+257. We check for insufficient
-         * lookahead only every 4th comparison; the 128th check will be made
-         * at strstart+257. If MAX_MATCH-2 is not a multiple of 8, it is
-         * necessary to put more guard bytes at the end of the window, or
-         * to check more often for insufficient lookahead.
+         * or if the match length is less than 2. As in the original
+         * version, the bytes behind the lookahead may be compared, but
+         * the length of the match is limited to the lookahead, so the
+         * output of deflate is not affected by them.
          */
-        Assert(scan[2] == match[2], "scan[2]?");
-        scan++, match++;
-        do {
-        } while (*(ushf*)(scan+=2) == *(ushf*)(match+=2) &&
-                 *(ushf*)(scan+=2) == *(ushf*)(match+=2) &&
-                 *(ushf*)(scan+=2) == *(ushf*)(match+=2) &&
-                 *(ushf*)(scan+=2) == *(ushf*)(match+=2) &&
-                 scan < strend);
-        /* The funny "do {}" generates better code on most compilers */
-
-        /* Here, scan <= window+strstart+257 */
-        Assert(scan <= s->window+(unsigned)(s->window_size-1), "wild scan");
-        if (*scan == *match) scan++;
-
-        len = (MAX_MATCH - 1) - (int)(strend-scan);
-        scan = strend - (MAX_MATCH-1);
-
-#else /* UNALIGNED_OK */
-
         if (match[best_len]   != scan_end  ||
             match[best_len-1] != scan_end1 ||
-            *match            != *scan     ||
-            *++match          != scan[1])      continue;
-
-        /* The check at best_len-1 can be removed because it will be made
-         * again later. (This heuristic is not always a win.)
-         * It is not necessary to compare scan[2] and match[2] since they
-         * are always equal when the other bytes match, given that
-         * the hash keys are equal and that HASH_BITS >= 8.
-         */
-        scan += 2, match++;
-        Assert(*scan == *match, "match[2]?");
+            match[0]          != scan[0]   ||
+            match[1]          != scan[1])      continue;
 
-        /* We check for insufficient lookahead only every 8th comparison;
-         * the 256th check will be made at strstart+258.
+        /* scan[2] up to scan[MAX_MATCH-1] are 256 bytes, which the vector
+         * versions compare in whole steps, and which end within the window
+         * because of MIN_LOOKAHEAD.
          */
-        do {
-        } while (*++scan == *++match && *++scan == *++match &&
-                 *++scan == *++match && *++scan == *++match &&
-                 *++scan == *++match && *++scan == *++match &&
-                 *++scan == *++match && *++scan == *++match &&
-                 scan < strend);
-
-        Assert(scan <= s->window+(unsigned)(s->window_size-1), "wild scan");
-
-        len = MAX_MATCH - (int)(strend - scan);
-        scan = strend - MAX_MATCH;
+        len = (int)compare(scan + 2, match + 2) + 2;
 
-#endif /* UNALIGNED_OK */
+        Assert(scan + len <= s->window+(unsigned)(s->window_size-1), "wild scan");
 
         if (len > best_len) {
             s->match_start = cur_match;
             best_len = len;
             if (len >= nice_match) break;
-#ifdef UNALIGNED_OK
-            scan_end = *(ushf*)(scan+best_len-1);
-#else
             scan_end1  = scan[best_len-1];
             scan_end   = scan[best_len];
-#endif
         }
     } while ((cur_match = prev[cur_match & wmask]) > limit
              && --chain_length != 0);
@@ -1370,6 +1525,46 @@ local void check_match(s, start, match, length)
 #  define check_match(s, start, match, length)
 #endif /* DEBUG */
 
+/* ===========================================================================
+ * Moves the positions in the table of n entries down by wsize, the ones which
+ * leave the window become NIL. n is a multiple of 8. With SSE2, this is a
+ * saturating subtraction of 8 positions at once.
+ */
+#ifdef ZLIB_X86
+ZLIB_TARGET("sse2")
+local void slide_hash_sse2(
+    Posf *table,
+    unsigned n,
+    uInt wsize)
+{
+    __m128i w = _mm_set1_epi16((short)wsize);
+    __m128i *p = (__m128i *)table;
+
+    for (; n; n -= 8, p++)
+        _mm_storeu_si128(p, _mm_subs_epu16(_mm_loadu_si128(p), w));
+}
+#endif
+
+local void slide_hash(
+    Posf *table,
+    unsigned n,
+    uInt wsize)
+{
+    Posf *p = table;
+    unsigned m;
+
+#ifdef ZLIB_X86
+    if (x86_cpu_has_sse2) {
+        slide_hash_sse2(table, n, wsize);
+        return;
+    }
+#endif
+    for (; n; n--, p++) {
+        m = *p;
+        *p = (Pos)(m >= wsize ? m-wsize : NIL);
+    }
+}
+
 /* ===========================================================================
  * Fill the window when the lookahead becomes insufficient.
  * Updates strstart and lookahead.
@@ -1382,8 +1577,7 @@ local void check_match(s, start, match, length)
  */
 local void fill_window(deflate_state *s)
 {
-    register unsigned n, m;
-    register Posf *p;
+    register unsigned n;
     unsigned more;    /* Amount of free space at the end of the window. */
     uInt wsize = s->w_size;
 
@@ -1421,23 +1615,12 @@ local void fill_window(deflate_state *s)
                later. (Using level 0 permanently is not an optimal usage of
                zlib, so we don't care about this pathological case.)
              */
-            n = s->hash_size;
-            p = &s->head[n];
-            do {
-                m = *--p;
-                *p = (Pos)(m >= wsize ? m-wsize : NIL);
-            } while (--n);
-
-            n = wsize;
+            slide_hash(s->head, s->hash_size, wsize);
 #ifndef FASTEST
-            p = &s->prev[n];
-            do {
-                m = *--p;
-                *p = (Pos)(m >= wsize ? m-wsize : NIL);
-                /* If n is not on any hash chain, prev[n] is garbage but
-                 * its value will never be used.
-                 */
-            } while (--n);
+            /* If n is not on any hash chain, prev[n] is garbage but
+             * its value will never be used.
+             */
+            slide_hash(s->prev, wsize, wsize);
 #endif
             more += wsize;
         }
@@ -1459,16 +1642,11 @@ local void fill_window(deflate_state *s)
         n = read_buf(s->strm, s->window + s->strstart + s->lookahead, more);
         s->lookahead += n;
 
-        /* Initialize the hash value now that we have some input: */
+        /* Insert the strings which lacked input before: */
         if (s->lookahead + s->insert >= MIN_MATCH) {
             uInt str = s->strstart - s->insert;
-            s->ins_h = s->window[str];
-            UPDATE_HASH(s, s->ins_h, s->window[str + 1]);
-#if MIN_MATCH != 3
-            Call UPDATE_HASH() MIN_MATCH-3 more times
-#endif
             while (s->insert) {
-                UPDATE_HASH(s, s->ins_h, s->window[str + MIN_MATCH-1]);
+                s->ins_h = HASH(s, str);
 #ifndef FASTEST
                 s->prev[str & s->w_mask] = s->head[s->ins_h];
 #endif
@@ -1479,10 +1657,6 @@ local void fill_window(deflate_state *s)
                     break;
             }
         }
-        /* If the whole input has less than MIN_MATCH bytes, ins_h is garbage,
-         * but this is not important since only literal bytes will be emitted.
-         */
-
     } while (s->lookahead < MIN_LOOKAHEAD && s->strm->avail_in != 0);
 
     /* If the WIN_INIT bytes after the end of the current data have never been
@@ -1685,14 +1859,6 @@ local block_state deflate_fast(
             {
                 s->strstart += s->match_length;
                 s->match_length = 0;
-                s->ins_h = s->window[s->strstart];
-                UPDATE_HASH(s, s->ins_h, s->window[s->strstart+1]);
-#if MIN_MATCH != 3
-                Call UPDATE_HASH() MIN_MATCH-3 more times
-#endif
-                /* If lookahead < MIN_MATCH, ins_h is garbage, but it does not
-                 * matter since it will be recomputed at next deflate call.
-                 */
             }
         } else {
             /* No match, output a literal byte */
@@ -1714,6 +1880,163 @@ local block_state deflate_fast(
 }
 
 #ifndef FASTEST
+/* ===========================================================================
+ * Inserts the string at strstart and returns the length of the longest match
+ * for it, with its start in match_start. Returns MIN_MATCH-1 if there is no
+ * match, or if the match is not worth it.
+ */
+local uInt find_match(
+    deflate_state *s)
+{
+    IPos hash_head = NIL; /* head of the hash chain */
+    uInt len = MIN_MATCH-1;
+
+    if (s->lookahead >= MIN_MATCH) {
+        INSERT_STRING(s, s->strstart, hash_head);
+    }
+    if (hash_head != NIL && s->strstart - hash_head <= MAX_DIST(s)) {
+        len = longest_match (s, hash_head);
+        if (len <= 5 && (s->strategy == Z_FILTERED
+#if TOO_FAR <= 32767
+            || (len == MIN_MATCH && s->strstart - s->match_start > TOO_FAR)
+#endif
+            )) {
+            len = MIN_MATCH-1;
+        }
+    }
+    return len;
+}
+
+/* ===========================================================================
+ * Compress as much as possible from the input stream, return the current
+ * block state.
+ * Between deflate_fast() and deflate_slow(): the match for each position is
+ * searched only once, and all strings are inserted in the dictionary. The
+ * lazy evaluation is only done at the end of a match, with the match which
+ * starts there. If that one also matches so many bytes before it, that less
+ * than MIN_MATCH bytes would be left of the current match, it is extended
+ * backwards, and the rest of the current match is sent as literals.
+ */
+local block_state deflate_medium(
+    deflate_state *s,
+    int flush)
+{
+    int bflush = 0;       /* set if current block must be flushed */
+    uInt hashed;          /* the strings before are in the hash table */
+    uInt next_length = 0; /* length of the match found at strstart, or 0 */
+    IPos next_start = 0;  /* start of that match */
+
+    s->prev_length = MIN_MATCH-1;
+    hashed = s->strstart;
+    for (;;) {
+        /* Make sure that we always have enough lookahead, except
+         * at the end of the input file. We need MAX_MATCH bytes
+         * for the next match, plus MIN_MATCH bytes to insert the
+         * string following the next match. There is no next match
+         * yet, if it's needed.
+         */
+        if (s->lookahead < MIN_LOOKAHEAD) {
+            fill_window(s);
+            if (s->lookahead < MIN_LOOKAHEAD && flush == Z_NO_FLUSH) {
+                return need_more;
+            }
+            if (s->lookahead == 0) break; /* flush the current block */
+        }
+
+        if (next_length) {
+            s->match_length = next_length;
+            s->match_start = next_start;
+            next_length = 0;
+        } else {
+            s->match_length = find_match(s);
+            hashed = s->strstart + 1;
+            if (s->match_length < MIN_MATCH)
+                s->match_length = 1;
+        }
+
+        if (s->match_length >= MIN_MATCH) {
+            uInt end = s->strstart + s->match_length;
+            uInt max_insert = s->strstart + s->lookahead - MIN_MATCH;
+
+            while (hashed < end && hashed <= max_insert) {
+                INSERT_STRING_ONLY(s, hashed);
+                hashed++;
+            }
+
+            /* Look for the next match, if there is enough lookahead, so no
+             * window is filled before it is used, and if the current block
+             * can take the current match without being flushed.
+             */
+            if (s->lookahead - s->match_length >= MIN_LOOKAHEAD &&
+                s->last_lit + MIN_MATCH < s->lit_bufsize) {
+                uInt length = s->match_length;
+                IPos start = s->match_start;
+                uInt back = 0;
+
+                s->strstart += length;
+                s->lookahead -= length;
+                next_length = find_match(s);
+                next_start = s->match_start;
+                hashed = s->strstart + 1;
+                s->strstart -= length;
+                s->lookahead += length;
+
+                if (next_length >= MIN_MATCH) {
+                    while (back < length && back < next_start &&
+                           next_length + back < MAX_MATCH &&
+                           s->window[end - back - 1] ==
+                           s->window[next_start - back - 1])
+                        back++;
+                    if (length - back < MIN_MATCH) {
+                        next_length += back;
+                        next_start -= back;
+                        length -= back;
+                    }
+                } else {
+                    next_length = 1;
+                }
+                s->match_length = length;
+                s->match_start = start;
+            }
+        }
+
+        if (s->match_length >= MIN_MATCH) {
+            check_match(s, s->strstart, s->match_start, s->match_length);
+
+            _tr_tally_dist(s, s->strstart - s->match_start,
+                           s->match_length - MIN_MATCH, bflush);
+
+            s->lookahead -= s->match_length;
+            s->strstart += s->match_length;
+            s->match_length = 0; /* not a pending match for deflate_slow() */
+        } else {
+            /* No match, or what is left of a match given up for the next
+             * one, output match_length literal bytes.
+             */
+            for (; s->match_length; s->match_length--) {
+                int lit_flush;
+                Tracevv((stderr,"%c", s->window[s->strstart]));
+                _tr_tally_lit (s, s->window[s->strstart], lit_flush);
+                bflush |= lit_flush;
+                s->lookahead--;
+                s->strstart++;
+            }
+        }
+        if (bflush) {
+            bflush = 0;
+            FLUSH_BLOCK(s, 0);
+        }
+    }
+    s->insert = s->strstart < MIN_MATCH-1 ? s->strstart : MIN_MATCH-1;
+    if (flush == Z_FINISH) {
+        FLUSH_BLOCK(s, 1);
+        return finish_done;
+    }
+    if (s->last_lit)
+        FLUSH_BLOCK(s, 0);
+    return block_done;
+}
+
 /* ===========================================================================
  * Same as above, but achieves better compression. We use a lazy
  * evaluation for matches: a match is finally adopted only if there is
@@ -8,7 +8,9 @@
 #include "gzguts.h"
 
 // POSIX warnings
+#ifdef _WIN32
 #define open _open
+#endif
 
 #if defined(_WIN32) && !defined(__BORLANDC__)
 #  define LSEEK _lseeki64
@@ -10,9 +10,11 @@
 #pragma warning(disable : 4244 4144)
 
 // POSIX warnings
+#ifdef _WIN32
 #define read _read
 #define write _write
 #define close _close
+#endif
 
 /* Local functions */
 local int gz_load OF((gz_statep, unsigned char *, unsigned, unsigned *));
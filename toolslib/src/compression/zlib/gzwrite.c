@@ -10,8 +10,10 @@
 #pragma warning(disable : 4244 4144)
 
 // POSIX warnings
+#ifdef _WIN32
 #define write _write
 #define close _close
+#endif
 
 /* Local functions */
 local int gz_init OF((gz_statep));
@@ -10,25 +10,71 @@
 
 #ifndef ASMINF
 
-/* Allow machine dependent optimization for post-increment or pre-increment.
-   Based on testing to date,
-   Pre-increment preferred for:
-   - PowerPC G3 (Adler)
-   - MIPS R5000 (Randers-Pehrson)
-   Post-increment preferred for:
-   - none
-   No measurable difference:
-   - Pentium III (Anderson)
-   - M68060 (Nikl)
- */
-#ifdef POSTINC
-#  define OFF 0
-#  define PUP(a) *(a)++
+#include "zlib_cpu.h"
+
+/* The bit buffer is refilled with 64-bit loads, independent of the size of long,
+   so a whole length/distance pair is decoded after a single refill. */
+#ifdef _MSC_VER
+typedef unsigned __int64 inf_bits_t;
 #else
-#  define OFF 1
-#  define PUP(a) *++(a)
+typedef unsigned long long inf_bits_t;
+#endif
+
+/* Unaligned little-endian loads can be done with a single memcpy() there. */
+#if defined(ZLIB_X86) || defined(_M_ARM64) || defined(__aarch64__) || \
+    (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#  define INFLATE_READ64LE
 #endif
 
+/* Matches are copied in chunks of this size, and may write up to CHUNK_SIZE - 1
+   bytes beyond their end. INFLATE_FAST_MIN_OUTPUT leaves room for that. */
+#define CHUNK_SIZE 16
+
+local inf_bits_t read64le(z_const unsigned char FAR *p)
+{
+#ifdef INFLATE_READ64LE
+    inf_bits_t v;
+    zmemcpy(&v, p, sizeof(v));
+    return v;
+#else
+    return (inf_bits_t)p[0] | ((inf_bits_t)p[1] << 8) |
+        ((inf_bits_t)p[2] << 16) | ((inf_bits_t)p[3] << 24) |
+        ((inf_bits_t)p[4] << 32) | ((inf_bits_t)p[5] << 40) |
+        ((inf_bits_t)p[6] << 48) | ((inf_bits_t)p[7] << 56);
+#endif
+}
+
+/*
+   Copies a match of len bytes from dist bytes back in the output, and returns
+   the new end of the output. The source may overlap the destination. Up to
+   CHUNK_SIZE - 1 bytes after the match are overwritten.
+
+   A distance below CHUNK_SIZE is a repeating pattern. It is doubled with each
+   copy, until whole chunks can be copied without reading unwritten bytes.
+ */
+local unsigned char FAR *copy_match(
+    unsigned char FAR *out,
+    unsigned dist,
+    unsigned len)
+{
+    unsigned char FAR *from = out - dist;
+    unsigned char FAR *stop = out + len;
+
+    while (dist < CHUNK_SIZE) {
+        zmemcpy(out, from, dist);
+        out += dist;
+        if (out >= stop)
+            return stop;
+        dist += dist;
+    }
+    do {
+        zmemcpy(out, from, CHUNK_SIZE);
+        out += CHUNK_SIZE;
+        from += CHUNK_SIZE;
+    } while (out < stop);
+    return stop;
+}
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -40,8 +86,8 @@
    Entry assumptions:
 
         state->mode == LEN
-        strm->avail_in >= 6
-        strm->avail_out >= 258
+        strm->avail_in >= INFLATE_FAST_MIN_INPUT
+        strm->avail_out >= INFLATE_FAST_MIN_OUTPUT
         start >= strm->avail_out
         state->bits < 8
 
@@ -56,13 +102,19 @@
     - The maximum input bits used by a length/distance pair is 15 bits for the
       length code, 5 bits for the length extra, 15 bits for the distance code,
       and 13 bits for the distance extra.  This totals 48 bits, or six bytes.
-      Therefore if strm->avail_in >= 6, then there is enough input to avoid
-      checking for available input while decoding.
+      Each loop refills the bit buffer to at least 56 bits with an unaligned
+      8-byte load, so no further input checks are needed while decoding.  The
+      load reads up to eight bytes, hence strm->avail_in >= 8.
+
+    - The refill advances the input only by whole bytes which fit into the bit
+      buffer.  The bits above those are the following input bytes, loaded again
+      at the same position by the next refill, so they are simply or'ed over.
 
     - The maximum bytes that a single length/distance pair can output is 258
-      bytes, which is the maximum length that can be coded.  inflate_fast()
-      requires strm->avail_out >= 258 for each loop to avoid checking for
-      output space.
+      bytes, which is the maximum length that can be coded.  Matches from the
+      output are copied in chunks, which may write up to 15 bytes beyond them,
+      so inflate_fast() requires strm->avail_out >= 258 + 15 for each loop.
+      Copies from the window are exact, so nothing beyond the window is read.
  */
 void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start)         /* inflate()'s starting value for strm->avail_out */
 {
@@ -79,7 +131,7 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start)         /* infla
     unsigned whave;             /* valid bytes in the window */
     unsigned wnext;             /* window write index */
     unsigned char FAR *window;  /* allocated sliding window, if wsize != 0 */
-    unsigned long hold;         /* local strm->hold */
+    inf_bits_t hold;            /* local strm->hold */
     unsigned bits;              /* local strm->bits */
     code const FAR *lcode;      /* local strm->lencode */
     code const FAR *dcode;      /* local strm->distcode */
@@ -94,11 +146,11 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start)         /* infla
 
     /* copy state to local variables */
     state = (struct inflate_state FAR *)strm->state;
-    in = strm->next_in - OFF;
-    last = in + (strm->avail_in - 5);
-    out = strm->next_out - OFF;
+    in = strm->next_in;
+    last = in + (strm->avail_in - (INFLATE_FAST_MIN_INPUT - 1));
+    out = strm->next_out;
     beg = out - (start - strm->avail_out);
-    end = out + (strm->avail_out - 257);
+    end = out + (strm->avail_out - (INFLATE_FAST_MIN_OUTPUT - 1));
 #ifdef INFLATE_STRICT
     dmax = state->dmax;
 #endif
@@ -116,12 +168,9 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start)         /* infla
     /* decode literals and length/distances until end-of-block or not enough
        input data or output space */
     do {
-        if (bits < 15) {
-            hold += (unsigned long)(PUP(in)) << bits;
-            bits += 8;
-            hold += (unsigned long)(PUP(in)) << bits;
-            bits += 8;
-        }
+        hold |= read64le(in) << bits;
+        in += (63 - bits) >> 3;
+        bits |= 56;
         here = lcode[hold & lmask];
       dolen:
         op = (unsigned)(here.bits);
@@ -132,27 +181,17 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start)         /* infla
             Tracevv((stderr, here.val >= 0x20 && here.val < 0x7f ?
                     "inflate:         literal '%c'\n" :
                     "inflate:         literal 0x%02x\n", here.val));
-            PUP(out) = (unsigned char)(here.val);
+            *out++ = (unsigned char)(here.val);
         }
         else if (op & 16) {                     /* length base */
             len = (unsigned)(here.val);
             op &= 15;                           /* number of extra bits */
             if (op) {
-                if (bits < op) {
-                    hold += (unsigned long)(PUP(in)) << bits;
-                    bits += 8;
-                }
                 len += (unsigned)hold & ((1U << op) - 1);
                 hold >>= op;
                 bits -= op;
             }
             Tracevv((stderr, "inflate:         length %u\n", len));
-            if (bits < 15) {
-                hold += (unsigned long)(PUP(in)) << bits;
-                bits += 8;
-                hold += (unsigned long)(PUP(in)) << bits;
-                bits += 8;
-            }
             here = dcode[hold & dmask];
           dodist:
             op = (unsigned)(here.bits);
@@ -162,14 +201,6 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start)         /* infla
             if (op & 16) {                      /* distance base */
                 dist = (unsigned)(here.val);
                 op &= 15;                       /* number of extra bits */
-                if (bits < op) {
-                    hold += (unsigned long)(PUP(in)) << bits;
-                    bits += 8;
-                    if (bits < op) {
-                        hold += (unsigned long)(PUP(in)) << bits;
-                        bits += 8;
-                    }
-                }
                 dist += (unsigned)hold & ((1U << op) - 1);
 #ifdef INFLATE_STRICT
                 if (dist > dmax) {
@@ -193,89 +224,51 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start)         /* infla
                         }
 #ifdef INFLATE_ALLOW_INVALID_DISTANCE_TOOFAR_ARRR
                         if (len <= op - whave) {
-                            do {
-                                PUP(out) = 0;
-                            } while (--len);
+                            zmemzero(out, len);
+                            out += len;
                             continue;
                         }
                         len -= op - whave;
-                        do {
-                            PUP(out) = 0;
-                        } while (--op > whave);
+                        zmemzero(out, op - whave);
+                        out += op - whave;
+                        op = whave;
                         if (op == 0) {
-                            from = out - dist;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--len);
+                            out = copy_match(out, dist, len);
                             continue;
                         }
 #endif
                     }
-                    from = window - OFF;
+                    from = window;
                     if (wnext == 0) {           /* very common case */
                         from += wsize - op;
-                        if (op < len) {         /* some from window */
-                            len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
-                            from = out - dist;  /* rest from output */
-                        }
                     }
                     else if (wnext < op) {      /* wrap around window */
                         from += wsize + wnext - op;
                         op -= wnext;
                         if (op < len) {         /* some from end of window */
                             len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
-                            from = window - OFF;
-                            if (wnext < len) {  /* some from start of window */
-                                op = wnext;
-                                len -= op;
-                                do {
-                                    PUP(out) = PUP(from);
-                                } while (--op);
-                                from = out - dist;      /* rest from output */
-                            }
+                            zmemcpy(out, from, op);
+                            out += op;
+                            from = window;
+                            op = wnext;         /* rest from start of window */
                         }
                     }
                     else {                      /* contiguous in window */
                         from += wnext - op;
-                        if (op < len) {         /* some from window */
-                            len -= op;
-                            do {
-                                PUP(out) = PUP(from);
-                            } while (--op);
-                            from = out - dist;  /* rest from output */
-                        }
                     }
-                    while (len > 2) {
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        len -= 3;
+                    if (op < len) {             /* some from window */
+                        len -= op;
+                        zmemcpy(out, from, op);
+                        out += op;
+                        out = copy_match(out, dist, len);   /* rest from output */
                     }
-                    if (len) {
-                        PUP(out) = PUP(from);
-                        if (len > 1)
-                            PUP(out) = PUP(from);
+                    else {
+                        zmemcpy(out, from, len);
+                        out += len;
                     }
                 }
                 else {
-                    from = out - dist;          /* copy direct from output */
-                    do {                        /* minimum length is three */
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        PUP(out) = PUP(from);
-                        len -= 3;
-                    } while (len > 2);
-                    if (len) {
-                        PUP(out) = PUP(from);
-                        if (len > 1)
-                            PUP(out) = PUP(from);
-                    }
+                    out = copy_match(out, dist, len);   /* copy direct from output */
                 }
             }
             else if ((op & 64) == 0) {          /* 2nd level distance code */
@@ -311,12 +304,15 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start)         /* infla
     hold &= (1U << bits) - 1;
 
     /* update state and return */
-    strm->next_in = in + OFF;
-    strm->next_out = out + OFF;
-    strm->avail_in = (unsigned)(in < last ? 5 + (last - in) : 5 - (in - last));
+    strm->next_in = in;
+    strm->next_out = out;
+    strm->avail_in = (unsigned)(in < last ?
+        (INFLATE_FAST_MIN_INPUT - 1) + (last - in) :
+        (INFLATE_FAST_MIN_INPUT - 1) - (in - last));
     strm->avail_out = (unsigned)(out < end ?
-                                 257 + (end - out) : 257 - (out - end));
-    state->hold = hold;
+        (INFLATE_FAST_MIN_OUTPUT - 1) + (end - out) :
+        (INFLATE_FAST_MIN_OUTPUT - 1) - (out - end));
+    state->hold = (unsigned long)hold;
     state->bits = bits;
     return;
 }
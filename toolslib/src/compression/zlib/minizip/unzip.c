@@ -136,6 +136,7 @@ typedef struct unz_file_info64_internal_s
 typedef struct
 {
     char  *read_buffer;         /* internal buffer for compressed data */
+    uInt  read_buffer_size;     /* size of read_buffer */
     z_stream stream;            /* zLib stream structure for inflate */
 
 #ifdef HAVE_BZIP2
@@ -188,6 +189,8 @@ typedef struct
 
     int isZip64;
 
+    uInt read_buffer_size;         /* size of the buffer for the next opened file */
+
 #    ifndef NOUNCRYPT
     unsigned long keys[3];     /* keys defining the pseudo-random sequence */
     const z_crc_t* pcrc_32_tab;
@@ -785,6 +788,7 @@ local unzFile unzOpenInternal (const void *path,
     us.central_pos = central_pos;
     us.pfile_in_zip_read = NULL;
     us.encrypted = 0;
+    us.read_buffer_size = UNZ_BUFSIZE;
 
 
     s=(unz64_s*)ALLOC(sizeof(unz64_s));
@@ -1535,7 +1539,8 @@ extern int ZEXPORT unzOpenCurrentFile3 (unzFile file, int* method,
     if (pfile_in_zip_read_info==NULL)
         return UNZ_INTERNALERROR;
 
-    pfile_in_zip_read_info->read_buffer=(char*)ALLOC(UNZ_BUFSIZE);
+    pfile_in_zip_read_info->read_buffer_size=s->read_buffer_size;
+    pfile_in_zip_read_info->read_buffer=(char*)ALLOC(pfile_in_zip_read_info->read_buffer_size);
     pfile_in_zip_read_info->offset_local_extrafield = offset_local_extrafield;
     pfile_in_zip_read_info->size_local_extrafield = size_local_extrafield;
     pfile_in_zip_read_info->pos_local_extrafield=0;
@@ -1756,7 +1761,7 @@ extern int ZEXPORT unzReadCurrentFile  (unzFile file, voidp buf, unsigned len)
         if ((pfile_in_zip_read_info->stream.avail_in==0) &&
             (pfile_in_zip_read_info->rest_read_compressed>0))
         {
-            uInt uReadThis = UNZ_BUFSIZE;
+            uInt uReadThis = pfile_in_zip_read_info->read_buffer_size;
             if (pfile_in_zip_read_info->rest_read_compressed<uReadThis)
                 uReadThis = (uInt)pfile_in_zip_read_info->rest_read_compressed;
             if (uReadThis == 0)
@@ -2031,6 +2036,19 @@ extern int ZEXPORT unzGetLocalExtrafield (unzFile file, voidp buf, unsigned len)
     return (int)read_now;
 }
 
+/*
+  Set the size of the buffer for the compressed data of the next opened file
+*/
+extern int ZEXPORT unzSetReadBufferSize (unzFile file, uInt size)
+{
+    unz64_s* s;
+    if ((file==NULL) || (size==0))
+        return UNZ_PARAMERROR;
+    s=(unz64_s*)file;
+    s->read_buffer_size = size;
+    return UNZ_OK;
+}
+
 /*
   Close the file in zip opened with unzOpenCurrentFile
   Return UNZ_CRCERROR if all the file was read but the CRC is not good
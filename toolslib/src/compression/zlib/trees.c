@@ -40,6 +40,13 @@
 #  include <ctype.h>
 #endif
 
+/* Bit buffer of compress_block(), which takes a whole match. */
+#ifdef _MSC_VER
+typedef unsigned __int64 bits64_t;
+#else
+typedef unsigned long long bits64_t;
+#endif
+
 /* ===========================================================================
  * Constants
  */
@@ -1056,6 +1063,87 @@ int ZLIB_INTERNAL _tr_tally (
      */
 }
 
+#ifndef DEBUG
+/* ===========================================================================
+ * Send the block data compressed using the given Huffman trees.
+ * The bits are collected in a 64-bit buffer, which is written out four bytes
+ * at a time, instead of testing for a full 16-bit bi_buf with every code.
+ * The bytes are not written earlier than send_bits() would write them, so
+ * pending_buf never catches up with the symbols in d_buf and l_buf sooner.
+ */
+local void compress_block(
+    deflate_state *s,
+    const ct_data *ltree, /* literal tree */
+    const ct_data *dtree /* distance tree */
+	)
+{
+    unsigned dist;      /* distance of matched string */
+    int lc;             /* match length or unmatched char (if dist == 0) */
+    unsigned lx = 0;    /* running index in l_buf */
+    unsigned code;      /* the code to send */
+    int extra;          /* number of extra bits to send */
+    bits64_t bi_buf = s->bi_buf;    /* local bit buffer */
+    int bi_valid = s->bi_valid;     /* number of valid bits in bi_buf */
+
+#define put_bits(value, length) { \
+    bi_buf |= (bits64_t)(value) << bi_valid; \
+    bi_valid += (length); \
+}
+#define flush_bits() { \
+    if (bi_valid >= 32) { \
+        put_byte(s, (uch)bi_buf); \
+        put_byte(s, (uch)(bi_buf >> 8)); \
+        put_byte(s, (uch)(bi_buf >> 16)); \
+        put_byte(s, (uch)(bi_buf >> 24)); \
+        bi_buf >>= 32; \
+        bi_valid -= 32; \
+    } \
+}
+
+    if (s->last_lit != 0) do {
+        dist = s->d_buf[lx];
+        lc = s->l_buf[lx++];
+        if (dist == 0) {
+            put_bits(ltree[lc].Code, ltree[lc].Len); /* send a literal byte */
+        } else {
+            /* Here, lc is the match length - MIN_MATCH */
+            code = _length_code[lc];
+            put_bits(ltree[code+LITERALS+1].Code, ltree[code+LITERALS+1].Len);
+            extra = extra_lbits[code];
+            if (extra != 0) {
+                lc -= base_length[code];
+                put_bits(lc, extra);        /* send the extra length bits */
+            }
+            flush_bits();
+            dist--; /* dist is now the match distance - 1 */
+            code = d_code(dist);
+
+            put_bits(dtree[code].Code, dtree[code].Len);
+            extra = extra_dbits[code];
+            if (extra != 0) {
+                dist -= base_dist[code];
+                put_bits(dist, extra);      /* send the extra distance bits */
+            }
+        } /* literal or match pair ? */
+        flush_bits();
+    } while (lx < s->last_lit);
+
+    put_bits(ltree[END_BLOCK].Code, ltree[END_BLOCK].Len);
+
+    /* Leave at most 16 bits for bi_buf, like send_bits() does. */
+    while (bi_valid > 16) {
+        put_byte(s, (uch)bi_buf);
+        bi_buf >>= 8;
+        bi_valid -= 8;
+    }
+    s->bi_buf = (ush)bi_buf;
+    s->bi_valid = bi_valid;
+
+#undef put_bits
+#undef flush_bits
+}
+
+#else /* DEBUG */
 /* ===========================================================================
  * Send the block data compressed using the given Huffman trees
  */
@@ -1107,6 +1195,8 @@ local void compress_block(
     send_code(s, END_BLOCK, ltree);
 }
 
+#endif /* DEBUG */
+
 /* ===========================================================================
  * Check if the data type is TEXT or BINARY, using the following algorithm:
  * - TEXT if the two conditions below are satisfied:
@@ -0,0 +1,81 @@
+/* zlib_cpu.c -- runtime detection of the CPU features for the SIMD code paths
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+#include "zlib_cpu.h"
+
+#ifdef ZLIB_X86
+
+#ifdef _MSC_VER
+#  include <intrin.h>
+#else
+#  include <cpuid.h>
+#endif
+
+int ZLIB_INTERNAL x86_cpu_has_sse2 = 0;
+int ZLIB_INTERNAL x86_cpu_has_ssse3 = 0;
+int ZLIB_INTERNAL x86_cpu_has_sse41 = 0;
+int ZLIB_INTERNAL x86_cpu_has_sse42 = 0;
+int ZLIB_INTERNAL x86_cpu_has_pclmul = 0;
+int ZLIB_INTERNAL x86_cpu_has_avx2 = 0;
+
+local volatile int cpu_checked = 0;
+
+local void cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4])
+{
+#ifdef _MSC_VER
+    int r[4];
+    int i;
+
+    __cpuidex(r, (int)leaf, (int)subleaf);
+    for (i = 0; i < 4; i++)
+        regs[i] = (unsigned)r[i];
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+local unsigned long long xgetbv(void)
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned eax, edx;
+
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+
+void ZLIB_INTERNAL cpu_check_features()
+{
+    unsigned regs[4];
+    unsigned max_leaf;
+    int avx;
+
+    if (cpu_checked)
+        return;
+
+    cpuid(0, 0, regs);
+    max_leaf = regs[0];
+    if (max_leaf >= 1) {
+        cpuid(1, 0, regs);
+        x86_cpu_has_sse2 = (regs[3] & (1u << 26)) != 0;
+        x86_cpu_has_ssse3 = (regs[2] & (1u << 9)) != 0;
+        x86_cpu_has_sse41 = (regs[2] & (1u << 19)) != 0;
+        x86_cpu_has_sse42 = (regs[2] & (1u << 20)) != 0;
+        x86_cpu_has_pclmul = (regs[2] & (1u << 1)) != 0;
+
+        /* AVX needs OSXSAVE and the OS must have enabled the XMM and YMM state. */
+        avx = (regs[2] & (1u << 28)) != 0 && (regs[2] & (1u << 27)) != 0 &&
+              (xgetbv() & 0x6) == 0x6;
+        if (avx && max_leaf >= 7) {
+            cpuid(7, 0, regs);
+            x86_cpu_has_avx2 = (regs[1] & (1u << 5)) != 0;
+        }
+    }
+
+    cpu_checked = 1;
+}
+
+#endif /* ZLIB_X86 */
@@ -29,6 +29,13 @@
 #endif /* MAKECRCH */
 
 #include "zutil.h"      /* for STDC and FAR definitions */
+#include "zlib_cpu.h"
+
+#ifdef ZLIB_X86
+#  include <emmintrin.h>
+#  include <smmintrin.h>
+#  include <wmmintrin.h>
+#endif
 
 #pragma warning(disable : 4127)
 
@@ -43,16 +50,28 @@
                         const unsigned char FAR *, unsigned));
    local unsigned long crc32_big OF((unsigned long,
                         const unsigned char FAR *, unsigned));
+   local z_crc_t crc32_slice16 OF((z_crc_t,
+                        const unsigned char FAR *, unsigned));
 #  define TBLS 8
 #else
 #  define TBLS 1
 #endif /* BYFOUR */
 
+/* The table implementation, which zlib_crc32() falls back to. It is not local,
+   so the tests can compare the accelerated versions against it. */
+unsigned long ZLIB_INTERNAL crc32_generic OF((unsigned long,
+                        const unsigned char FAR *, uInt));
+
 /* Local functions for crc concatenation */
-local unsigned long gf2_matrix_times OF((unsigned long *mat,
-                                         unsigned long vec));
-local void gf2_matrix_square OF((unsigned long *square, unsigned long *mat));
 local uLong crc32_combine_ OF((uLong crc1, uLong crc2, z_off64_t len2));
+local z_crc_t multmodp OF((z_crc_t a, z_crc_t b));
+local z_crc_t x2nmodp OF((z_off64_t n, unsigned k));
+
+#ifdef ZLIB_X86
+/* The folding needs at least four blocks of 16 bytes. */
+#  define CRC32_PCLMUL_MINIMUM 64
+local z_crc_t crc32_pclmul OF((z_crc_t, const unsigned char FAR *, unsigned));
+#endif
 
 
 #ifdef DYNAMIC_CRC_TABLE
@@ -186,6 +205,9 @@ local void write_table(out, table)
 #include "zlib_crc32.h"
 #endif /* DYNAMIC_CRC_TABLE */
 
+/* Tables for crc32_slice16() and crc32_combine(). */
+#include "zlib_crc32_slice16.h"
+
 /* =========================================================================
  * This function can be used by asm versions of crc32()
  */
@@ -202,7 +224,10 @@ const z_crc_t FAR * ZEXPORT get_crc_table()
 #define DO1 crc = crc_table[0][((int)crc ^ (*buf++)) & 0xff] ^ (crc >> 8)
 #define DO8 DO1; DO1; DO1; DO1; DO1; DO1; DO1; DO1
 
-/* ========================================================================= */
+/* =========================================================================
+ * Selects the fastest implementation for the CPU: PCLMULQDQ folding for the
+ * multiples of 16 bytes, and slice-by-16 for the rest, or on other CPUs.
+ */
 unsigned long ZEXPORT zlib_crc32(
     unsigned long crc,
     const unsigned char FAR *buf,
@@ -210,6 +235,42 @@ unsigned long ZEXPORT zlib_crc32(
 {
     if (buf == Z_NULL) return 0UL;
 
+#ifdef ZLIB_X86
+    cpu_check_features();
+    if (len >= CRC32_PCLMUL_MINIMUM && x86_cpu_has_pclmul && x86_cpu_has_sse41) {
+        uInt chunk = len & ~(uInt)15;
+
+        crc = ~crc32_pclmul(~(z_crc_t)crc, buf, chunk) & 0xffffffffUL;
+        buf += chunk;
+        len -= chunk;
+        if (len == 0)
+            return crc;
+    }
+#endif /* ZLIB_X86 */
+
+#ifdef BYFOUR
+    if (sizeof(void *) == sizeof(ptrdiff_t)) {
+        z_crc_t endian;
+
+        endian = 1;
+        if (*((unsigned char *)(&endian)))
+            return (unsigned long)~crc32_slice16(~(z_crc_t)crc, buf, len) & 0xffffffffUL;
+    }
+#endif /* BYFOUR */
+
+    return crc32_generic(crc, buf, len);
+}
+
+/* =========================================================================
+ * The table implementation of zlib, four bytes at a time.
+ */
+unsigned long ZLIB_INTERNAL crc32_generic(
+    unsigned long crc,
+    const unsigned char FAR *buf,
+    uInt len)
+{
+    if (buf == Z_NULL) return 0UL;
+
 #ifdef DYNAMIC_CRC_TABLE
     if (crc_table_empty)
         make_crc_table();
@@ -321,92 +382,238 @@ local unsigned long crc32_big(
     return (unsigned long)(ZSWAP32(c));
 }
 
+/* ========================================================================= */
+#define DOSLICE16 \
+        w0 = *buf4++ ^ c; w1 = *buf4++; w2 = *buf4++; w3 = *buf4++; \
+        c = crc_slice16_table[15][w0 & 0xff] ^ \
+            crc_slice16_table[14][(w0 >> 8) & 0xff] ^ \
+            crc_slice16_table[13][(w0 >> 16) & 0xff] ^ \
+            crc_slice16_table[12][w0 >> 24] ^ \
+            crc_slice16_table[11][w1 & 0xff] ^ \
+            crc_slice16_table[10][(w1 >> 8) & 0xff] ^ \
+            crc_slice16_table[9][(w1 >> 16) & 0xff] ^ \
+            crc_slice16_table[8][w1 >> 24] ^ \
+            crc_slice16_table[7][w2 & 0xff] ^ \
+            crc_slice16_table[6][(w2 >> 8) & 0xff] ^ \
+            crc_slice16_table[5][(w2 >> 16) & 0xff] ^ \
+            crc_slice16_table[4][w2 >> 24] ^ \
+            crc_slice16_table[3][w3 & 0xff] ^ \
+            crc_slice16_table[2][(w3 >> 8) & 0xff] ^ \
+            crc_slice16_table[1][(w3 >> 16) & 0xff] ^ \
+            crc_slice16_table[0][w3 >> 24]
+
+/* =========================================================================
+ * Like crc32_little(), but 16 bytes at a time, so the 16 table lookups are
+ * independent of each other. The crc is passed and returned inverted.
+ */
+local z_crc_t crc32_slice16(
+    z_crc_t c,
+    const unsigned char FAR *buf,
+    unsigned len)
+{
+    register const z_crc_t FAR *buf4;
+    z_crc_t w0, w1, w2, w3;
+
+    while (len && ((ptrdiff_t)buf & 3)) {
+        c = crc_slice16_table[0][(c ^ *buf++) & 0xff] ^ (c >> 8);
+        len--;
+    }
+
+    buf4 = (const z_crc_t FAR *)(const void FAR *)buf;
+    while (len >= 64) {
+        DOSLICE16;
+        DOSLICE16;
+        DOSLICE16;
+        DOSLICE16;
+        len -= 64;
+    }
+    while (len >= 16) {
+        DOSLICE16;
+        len -= 16;
+    }
+    buf = (const unsigned char FAR *)buf4;
+
+    while (len) {
+        c = crc_slice16_table[0][(c ^ *buf++) & 0xff] ^ (c >> 8);
+        len--;
+    }
+    return c;
+}
+
 #endif /* BYFOUR */
 
-#define GF2_DIM 32      /* dimension of GF(2) vectors (length of CRC) */
+#ifdef ZLIB_X86
 
-/* ========================================================================= */
-local unsigned long gf2_matrix_times(
-    unsigned long *mat,
-    unsigned long vec)
+/* =========================================================================
+ * CRC-32 with carry-less multiplication, as described by Intel in "Fast CRC
+ * Computation for Generic Polynomials Using PCLMULQDQ Instruction". Four
+ * 128-bit lanes are folded in parallel by 64 bytes, then into a single lane,
+ * and finally reduced to 32 bits with Barrett reduction. The constants are
+ * for the bit-reflected polynomial. len must be a multiple of 16 and at least
+ * CRC32_PCLMUL_MINIMUM, the crc is passed and returned inverted.
+ */
+ZLIB_TARGET("pclmul,sse4.1")
+local z_crc_t crc32_pclmul(
+    z_crc_t crc,
+    const unsigned char FAR *buf,
+    unsigned len)
 {
-    unsigned long sum;
-
-    sum = 0;
-    while (vec) {
-        if (vec & 1)
-            sum ^= *mat;
-        vec >>= 1;
-        mat++;
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+    const __m128i k5k0 = _mm_set_epi64x(0x0000000000LL, 0x0163cd6124LL);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+
+    x1 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = k1k2;
+
+    buf += 64;
+    len -= 64;
+
+    /* Fold four lanes by 64 bytes. */
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128((const __m128i *)(buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i *)(buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i *)(buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i *)(buf + 0x30));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        buf += 64;
+        len -= 64;
     }
-    return sum;
+
+    /* Fold the four lanes into one. */
+    x0 = k3k4;
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    /* Fold the remaining blocks of 16 bytes. */
+    while (len >= 16) {
+        x2 = _mm_loadu_si128((const __m128i *)buf);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        buf += 16;
+        len -= 16;
+    }
+
+    /* Fold 128 bits to 64 bits. */
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = k5k0;
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 bits. */
+    x0 = poly;
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (z_crc_t)_mm_extract_epi32(x1, 1);
 }
 
-/* ========================================================================= */
-local void gf2_matrix_square(
-    unsigned long *square,
-    unsigned long *mat)
+#endif /* ZLIB_X86 */
+
+/* =========================================================================
+ * Returns a(x) multiplied by b(x) modulo p(x), where p(x) is the CRC
+ * polynomial, reflected. For speed, this requires that a not be zero.
+ */
+local z_crc_t multmodp(
+    z_crc_t a,
+    z_crc_t b)
 {
-    int n;
+    z_crc_t m, p;
+
+    m = (z_crc_t)1 << 31;
+    p = 0;
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0)
+                break;
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ 0xedb88320UL : b >> 1;
+    }
+    return p;
+}
 
-    for (n = 0; n < GF2_DIM; n++)
-        square[n] = gf2_matrix_times(mat, mat[n]);
+/* =========================================================================
+ * Returns x^(n * 2^k) modulo p(x).
+ */
+local z_crc_t x2nmodp(
+    z_off64_t n,
+    unsigned k)
+{
+    z_crc_t p;
+
+    p = (z_crc_t)1 << 31;           /* x^0 == 1 */
+    while (n) {
+        if (n & 1)
+            p = multmodp(x2n_table[k & 31], p);
+        n >>= 1;
+        k++;
+    }
+    return p;
 }
 
-/* ========================================================================= */
+/* =========================================================================
+ * Appending len2 zero bytes to the first sequence multiplies its CRC by
+ * x^(8 * len2), which takes only a few table lookups and multiplications,
+ * instead of squaring 32x32 matrices for every bit of len2.
+ */
 local uLong crc32_combine_(
     uLong crc1,
     uLong crc2,
     z_off64_t len2)
 {
-    int n;
-    unsigned long row;
-    unsigned long even[GF2_DIM];    /* even-power-of-two zeros operator */
-    unsigned long odd[GF2_DIM];     /* odd-power-of-two zeros operator */
-
     /* degenerate case (also disallow negative lengths) */
     if (len2 <= 0)
         return crc1;
 
-    /* put operator for one zero bit in odd */
-    odd[0] = 0xedb88320UL;          /* CRC-32 polynomial */
-    row = 1;
-    for (n = 1; n < GF2_DIM; n++) {
-        odd[n] = row;
-        row <<= 1;
-    }
-
-    /* put operator for two zero bits in even */
-    gf2_matrix_square(even, odd);
-
-    /* put operator for four zero bits in odd */
-    gf2_matrix_square(odd, even);
-
-    /* apply len2 zeros to crc1 (first square will put the operator for one
-       zero byte, eight zero bits, in even) */
-    do {
-        /* apply zeros operator for this bit of len2 */
-        gf2_matrix_square(even, odd);
-        if (len2 & 1)
-            crc1 = gf2_matrix_times(even, crc1);
-        len2 >>= 1;
-
-        /* if no more bits set, then done */
-        if (len2 == 0)
-            break;
-
-        /* another iteration of the loop with odd and even swapped */
-        gf2_matrix_square(odd, even);
-        if (len2 & 1)
-            crc1 = gf2_matrix_times(odd, crc1);
-        len2 >>= 1;
-
-        /* if no more bits set, then done */
-    } while (len2 != 0);
-
-    /* return combined crc */
-    crc1 ^= crc2;
-    return crc1;
+    return multmodp(x2nmodp(len2, 3), (z_crc_t)crc1) ^ (crc2 & 0xffffffffUL);
 }
 
 /* ========================================================================= */
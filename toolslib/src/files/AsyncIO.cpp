@@ -0,0 +1,602 @@
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define TOOLSLIB_IO_URING
+#endif
+#endif
+
+#ifdef TOOLSLIB_IO_URING
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#endif
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "toolslib/files/AsyncIO.h"
+#include "toolslib/files/BaseFile.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+using namespace std;
+
+const size_t AsyncIO::default_queue_depth;
+const size_t AsyncIO::default_threads;
+
+/**
+ * The engine does the transfers of the requests, which are handed over by AsyncIO.
+ */
+class AsyncIO::Engine
+{
+public:
+	virtual ~Engine(void) {}
+
+	virtual bool isKernelQueue(void) const = 0;
+
+	/**
+	 * Queues the request. Returns false if the engine is full, so a request has to
+	 * be reaped first.
+	 */
+	virtual bool submit(request_t const &oRequest) = 0;
+
+	virtual void flush(void) = 0;
+
+	/**
+	 * Waits until at least nMin requests are finished, and appends all finished requests.
+	 */
+	virtual void reap(vector<completion_t> &oCompleted, size_t nMin) = 0;
+};
+
+namespace
+{
+
+int64_t execute(AsyncIO::request_t const &oRequest)
+{
+	if(oRequest.Handle != sysio::invalid_handle)
+	{
+		if(oRequest.Write)
+			return sysio::writeAt(oRequest.Handle, oRequest.Offset, oRequest.Buffer, oRequest.Length);
+
+		return sysio::readAt(oRequest.Handle, oRequest.Offset, oRequest.Buffer, oRequest.Length);
+	}
+
+	if(oRequest.Write)
+		return oRequest.File->writeAt(oRequest.Offset, oRequest.Buffer, oRequest.Length);
+
+	return oRequest.File->readAt(oRequest.Offset, oRequest.Buffer, oRequest.Length);
+}
+
+/**
+ * Blocking transfers, done by a pool of threads.
+ */
+class ThreadEngine
+: public AsyncIO::Engine
+{
+public:
+	ThreadEngine(size_t nThreads)
+	: mStop(false)
+	{
+		for(size_t i = 0; i < max(nThreads, (size_t)1); i++)
+			mThreads.emplace_back(&ThreadEngine::run, this);
+	}
+
+	~ThreadEngine(void) override
+	{
+		{
+			lock_guard<mutex> lock(mLock);
+			mStop = true;
+		}
+
+		mQueuedSignal.notify_all();
+		for(thread &t : mThreads)
+			t.join();
+	}
+
+	bool isKernelQueue(void) const override
+	{
+		return false;
+	}
+
+	bool submit(AsyncIO::request_t const &oRequest) override
+	{
+		{
+			lock_guard<mutex> lock(mLock);
+			mQueue.push_back(oRequest);
+		}
+
+		mQueuedSignal.notify_one();
+		return true;
+	}
+
+	void flush(void) override
+	{
+	}
+
+	void reap(vector<AsyncIO::completion_t> &oCompleted, size_t nMin) override
+	{
+		unique_lock<mutex> lock(mLock);
+		mDoneSignal.wait(lock, [&] { return mDone.size() >= nMin; });
+
+		oCompleted.insert(oCompleted.end(), mDone.begin(), mDone.end());
+		mDone.clear();
+	}
+
+protected:
+	void run(void)
+	{
+		unique_lock<mutex> lock(mLock);
+		while(true)
+		{
+			mQueuedSignal.wait(lock, [&] { return mStop || !mQueue.empty(); });
+			if(mQueue.empty())
+				return;
+
+			AsyncIO::request_t request = mQueue.front();
+			mQueue.pop_front();
+
+			lock.unlock();
+			int64_t result = execute(request);
+			lock.lock();
+
+			mDone.push_back({ request.Token, result });
+			mDoneSignal.notify_one();
+		}
+	}
+
+private:
+	mutex mLock;
+	condition_variable mQueuedSignal;
+	condition_variable mDoneSignal;
+	deque<AsyncIO::request_t> mQueue;
+	vector<AsyncIO::completion_t> mDone;
+	vector<thread> mThreads;
+	bool mStop;
+};
+
+#ifdef TOOLSLIB_IO_URING
+
+// Largest single transfer, longer requests are continued when it is finished.
+const int64_t MAX_TRANSFER = 1024*1024*1024;
+
+/**
+ * io_uring with plain system calls, so there is no dependency on liburing. Each
+ * request occupies a slot, and slot i always uses the submission entry i, so there
+ * are never more requests in flight than the completion queue can hold.
+ */
+class UringEngine
+: public AsyncIO::Engine
+{
+public:
+	UringEngine(void)
+	: mRing(-1)
+	, mSqRing(MAP_FAILED)
+	, mCqRing(MAP_FAILED)
+	, mSqes(NULL)
+	, mSqRingSize(0)
+	, mCqRingSize(0)
+	, mSqesSize(0)
+	, mQueued(0)
+	, mFailed(false)
+	{
+	}
+
+	~UringEngine(void) override
+	{
+		if(mSqes)
+			munmap(mSqes, mSqesSize);
+
+		if(mCqRing != MAP_FAILED && mCqRing != mSqRing)
+			munmap(mCqRing, mCqRingSize);
+
+		if(mSqRing != MAP_FAILED)
+			munmap(mSqRing, mSqRingSize);
+
+		if(mRing != -1)
+			::close(mRing);
+	}
+
+	/**
+	 * Returns false if io_uring is not available (old kernel, or blocked by a seccomp filter).
+	 */
+	bool setup(size_t nEntries)
+	{
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+
+		mRing = (int)syscall(__NR_io_uring_setup, (unsigned)max(nEntries, (size_t)1), &params);
+		if(mRing < 0)
+		{
+			mRing = -1;
+			return false;
+		}
+
+		mSqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		mCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if(single)
+			mSqRingSize = mCqRingSize = max(mSqRingSize, mCqRingSize);
+
+		mSqRing = mmap(NULL, mSqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRing, IORING_OFF_SQ_RING);
+		if(mSqRing == MAP_FAILED)
+			return false;
+
+		if(single)
+			mCqRing = mSqRing;
+		else
+		{
+			mCqRing = mmap(NULL, mCqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRing, IORING_OFF_CQ_RING);
+			if(mCqRing == MAP_FAILED)
+				return false;
+		}
+
+		mSqesSize = params.sq_entries * sizeof(io_uring_sqe);
+		void *sqes = mmap(NULL, mSqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mRing, IORING_OFF_SQES);
+		if(sqes == MAP_FAILED)
+			return false;
+
+		mSqes = static_cast<io_uring_sqe *>(sqes);
+
+		char *sq = static_cast<char *>(mSqRing);
+		mSqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+		mSqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+		mSqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+		char *cq = static_cast<char *>(mCqRing);
+		mCqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+		mCqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+		mCqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+		mCqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+		mSlots.resize(params.sq_entries);
+		for(unsigned i = params.sq_entries; i > 0; i--)
+			mFree.push_back(i - 1);
+
+		return true;
+	}
+
+	bool isKernelQueue(void) const override
+	{
+		return true;
+	}
+
+	bool submit(AsyncIO::request_t const &oRequest) override
+	{
+		if(mFailed)
+		{
+			mDone.push_back({ oRequest.Token, execute(oRequest) });
+			return true;
+		}
+
+		if(mFree.empty())
+			return false;
+
+		unsigned index = mFree.back();
+		mFree.pop_back();
+
+		slot_t &slot = mSlots[index];
+		slot.Request = oRequest;
+		slot.Done = 0;
+		queue(index);
+
+		return true;
+	}
+
+	void flush(void) override
+	{
+		if(mQueued)
+			enter(0);
+	}
+
+	void reap(vector<AsyncIO::completion_t> &oCompleted, size_t nMin) override
+	{
+		size_t reaped = mDone.size();
+		oCompleted.insert(oCompleted.end(), mDone.begin(), mDone.end());
+		mDone.clear();
+
+		while(!mFailed)
+		{
+			unsigned head = *mCqHead;
+			unsigned tail = __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE);
+			for(; head != tail; head++)
+			{
+				io_uring_cqe const &cqe = mCqes[head & mCqMask];
+				unsigned index = (unsigned)cqe.user_data;
+				int res = cqe.res;
+				slot_t &slot = mSlots[index];
+
+				if(res == -EINTR || res == -EAGAIN)
+				{
+					queue(index);
+					continue;
+				}
+
+				if(res < 0)
+				{
+					complete(oCompleted, index, (slot.Done) ? slot.Done : invalid64_t);
+					reaped++;
+					continue;
+				}
+
+				// Short transfers are continued, like sysio::readAt() does.
+				slot.Done += res;
+				if(res > 0 && slot.Done < slot.Request.Length)
+				{
+					queue(index);
+					continue;
+				}
+
+				complete(oCompleted, index, slot.Done);
+				reaped++;
+			}
+
+			__atomic_store_n(mCqHead, head, __ATOMIC_RELEASE);
+
+			if(reaped >= nMin)
+				break;
+
+			if(!enter(1))
+				fail(oCompleted);
+		}
+
+		// Continued requests must not wait for the next call.
+		flush();
+	}
+
+protected:
+	typedef struct
+	{
+		AsyncIO::request_t Request;
+		int64_t Done;
+		iovec Vector;
+	} slot_t;
+
+	void queue(unsigned nIndex)
+	{
+		slot_t &slot = mSlots[nIndex];
+		slot.Vector.iov_base = slot.Request.Buffer + slot.Done;
+		slot.Vector.iov_len = (size_t)min(slot.Request.Length - slot.Done, MAX_TRANSFER);
+
+		// The vectored operations are supported by all kernels with io_uring.
+		io_uring_sqe &sqe = mSqes[nIndex];
+		memset(&sqe, 0, sizeof(sqe));
+		sqe.opcode = (slot.Request.Write) ? IORING_OP_WRITEV : IORING_OP_READV;
+		sqe.fd = (int)slot.Request.Handle;
+		sqe.off = (uint64_t)(slot.Request.Offset + slot.Done);
+		sqe.addr = (uint64_t)(uintptr_t)&slot.Vector;
+		sqe.len = 1;
+		sqe.user_data = nIndex;
+
+		unsigned tail = *mSqTail;
+		mSqArray[tail & mSqMask] = nIndex;
+		__atomic_store_n(mSqTail, tail + 1, __ATOMIC_RELEASE);
+		mQueued++;
+	}
+
+	void complete(vector<AsyncIO::completion_t> &oCompleted, unsigned nIndex, int64_t nResult)
+	{
+		oCompleted.push_back({ mSlots[nIndex].Request.Token, nResult });
+		mFree.push_back(nIndex);
+	}
+
+	/**
+	 * The ring can't be entered anymore, so the outstanding requests are finished with
+	 * what was transferred so far, or with an error. Otherwise the callers would wait
+	 * forever. The following requests are done with blocking transfers.
+	 */
+	void fail(vector<AsyncIO::completion_t> &oCompleted)
+	{
+		mFailed = true;
+		mQueued = 0;
+
+		vector<bool> idle(mSlots.size(), false);
+		for(unsigned index : mFree)
+			idle[index] = true;
+
+		for(unsigned index = 0; index < mSlots.size(); index++)
+		{
+			if(!idle[index])
+				complete(oCompleted, index, (mSlots[index].Done) ? mSlots[index].Done : invalid64_t);
+		}
+	}
+
+	/**
+	 * Submits the queued entries and waits for nMinComplete completions.
+	 */
+	bool enter(unsigned nMinComplete)
+	{
+		unsigned flags = (nMinComplete) ? IORING_ENTER_GETEVENTS : 0;
+		while(true)
+		{
+			long rc = syscall(__NR_io_uring_enter, mRing, mQueued, nMinComplete, flags, NULL, 0);
+			if(rc >= 0)
+			{
+				mQueued -= (unsigned)rc;
+				return true;
+			}
+
+			if(errno != EINTR)
+				return false;
+		}
+	}
+
+private:
+	int mRing;
+	void *mSqRing;
+	void *mCqRing;
+	io_uring_sqe *mSqes;
+	size_t mSqRingSize;
+	size_t mCqRingSize;
+	size_t mSqesSize;
+
+	unsigned *mSqTail;
+	unsigned *mSqArray;
+	unsigned mSqMask;
+	unsigned *mCqHead;
+	unsigned *mCqTail;
+	unsigned mCqMask;
+	io_uring_cqe *mCqes;
+
+	vector<slot_t> mSlots;
+	vector<unsigned> mFree;
+	unsigned mQueued;				// Entries in the submission queue, which the kernel hasn't seen yet.
+	bool mFailed;					// io_uring_enter() failed, so the ring is not used anymore.
+	vector<AsyncIO::completion_t> mDone;	// Blocking transfers since the ring failed.
+};
+
+#endif
+
+}
+
+AsyncIO::AsyncIO(size_t nQueueDepth, size_t nThreads, bool bKernelQueue)
+: mNextToken(1)
+, mPending(0)
+{
+#ifdef TOOLSLIB_IO_URING
+	if(bKernelQueue)
+	{
+		unique_ptr<UringEngine> engine(new UringEngine());
+		if(engine->setup(nQueueDepth))
+			mEngine = move(engine);
+	}
+#else
+	UNUSED(nQueueDepth);
+	UNUSED(bKernelQueue);
+#endif
+
+	if(!mEngine)
+		mEngine.reset(new ThreadEngine(nThreads));
+}
+
+AsyncIO::~AsyncIO(void)
+{
+	// The buffers belong to the caller, so nothing may be in flight when we return.
+	mEngine->flush();
+	if(mPending > mCompleted.size())
+		reap(mPending - mCompleted.size());
+}
+
+bool AsyncIO::isKernelQueue(void) const
+{
+	return mEngine->isKernelQueue();
+}
+
+AsyncIO::token_t AsyncIO::submitRead(IFile &oFile, int64_t nOffset, void *oBuffer, int64_t nLen)
+{
+	BaseFile *file = dynamic_cast<BaseFile *>(&oFile);
+	request_t request = { 0, (file) ? file->getNativeHandle() : sysio::invalid_handle, &oFile, static_cast<char *>(oBuffer), nOffset, nLen, false };
+
+	return submit(request);
+}
+
+AsyncIO::token_t AsyncIO::submitWrite(IFile &oFile, int64_t nOffset, void const *oBuffer, int64_t nLen)
+{
+	BaseFile *file = dynamic_cast<BaseFile *>(&oFile);
+	request_t request = { 0, (file) ? file->getNativeHandle() : sysio::invalid_handle, &oFile, static_cast<char *>(const_cast<void *>(oBuffer)), nOffset, nLen, true };
+
+	return submit(request);
+}
+
+AsyncIO::token_t AsyncIO::submitRead(sysio::handle_t nHandle, int64_t nOffset, void *oBuffer, int64_t nLen)
+{
+	request_t request = { 0, nHandle, NULL, static_cast<char *>(oBuffer), nOffset, nLen, false };
+
+	return submit(request);
+}
+
+AsyncIO::token_t AsyncIO::submitWrite(sysio::handle_t nHandle, int64_t nOffset, void const *oBuffer, int64_t nLen)
+{
+	request_t request = { 0, nHandle, NULL, static_cast<char *>(const_cast<void *>(oBuffer)), nOffset, nLen, true };
+
+	return submit(request);
+}
+
+AsyncIO::token_t AsyncIO::submit(request_t &oRequest)
+{
+	oRequest.Token = mNextToken++;
+	mPending++;
+
+	if(oRequest.Buffer == NULL || oRequest.Offset < 0 || oRequest.Length < 0 || (oRequest.Handle == sysio::invalid_handle && oRequest.File == NULL))
+	{
+		mCompleted.push_back({ oRequest.Token, invalid64_t });
+		return oRequest.Token;
+	}
+
+	// The kernel can only work with handles.
+	if(oRequest.Handle == sysio::invalid_handle && mEngine->isKernelQueue())
+	{
+		mCompleted.push_back({ oRequest.Token, execute(oRequest) });
+		return oRequest.Token;
+	}
+
+	while(!mEngine->submit(oRequest))
+		reap(1);
+
+	return oRequest.Token;
+}
+
+void AsyncIO::flush(void)
+{
+	mEngine->flush();
+}
+
+void AsyncIO::reap(size_t nMin)
+{
+	mEngine->flush();
+	mEngine->reap(mCompleted, nMin);
+}
+
+size_t AsyncIO::wait(completion_t *oCompletions, size_t nMaxCompletions, size_t nMinCompletions)
+{
+	nMinCompletions = min(min(nMinCompletions, nMaxCompletions), mPending);
+
+	if(mCompleted.size() < nMinCompletions)
+		reap(nMinCompletions - mCompleted.size());
+	else
+		mEngine->flush();
+
+	size_t n = min(nMaxCompletions, mCompleted.size());
+	copy(mCompleted.begin(), mCompleted.begin() + n, oCompletions);
+	mCompleted.erase(mCompleted.begin(), mCompleted.begin() + n);
+	mPending -= n;
+
+	return n;
+}
+
+int64_t AsyncIO::wait(token_t nToken)
+{
+	while(true)
+	{
+		for(vector<completion_t>::iterator it = mCompleted.begin(); it != mCompleted.end(); ++it)
+		{
+			if(it->Token == nToken)
+			{
+				int64_t result = it->Result;
+				mCompleted.erase(it);
+				mPending--;
+
+				return result;
+			}
+		}
+
+		// Unknown, or already returned.
+		if(mPending == mCompleted.size())
+			return invalid64_t;
+
+		reap(1);
+	}
+}
+
+}
+
+}
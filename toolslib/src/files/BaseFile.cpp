@@ -1,6 +1,12 @@
-#include <Windows.h>
+#ifdef _WIN32
 #include <direct.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #include "toolslib/files/BaseFile.h"
 
@@ -15,8 +21,12 @@ using namespace std;
 BaseFile::BaseFile(Filename const &oFilename)
 {
 	mEOF = false;
+	mIsOpen = false;
 	mFileBuffer = NULL;
 	mFileBufferSize = invalid64u_t;
+	mRequestedBufferSize = invalid64u_t;
+	mFileBufferPool = NULL;
+	mFileBufferAllocated = 0;
 	mOpenmode = IFile::open_default;
 	setFilename(oFilename);
 }
@@ -52,13 +62,19 @@ string const &BaseFile::getOpenpath(void) const
 }
 
 bool BaseFile::open(void)
+{
+	beginOpen(true);
+
+	return true;
+}
+
+void BaseFile::beginOpen(bool bAllocateBuffer)
 {
 	close();
 	setEOF(false);
-	allocateFileBuffer(setFileBufferSize());
+	if (bAllocateBuffer)
+		allocateFileBuffer(updateFileBufferSize());
 	setIsOpen(true);
-
-	return true;
 }
 
 void BaseFile::close(void)
@@ -111,8 +127,16 @@ char *BaseFile::allocateFileBuffer(int64_t nSize)
 {
 	if(!mFileBuffer)
 	{
-		mFileBuffer = new char[(size_t)nSize+32];
-		memset(mFileBuffer, 0xFE, (size_t)(nSize+32));
+		// No slack on top, it would push the power of two sizes into the next class.
+		mFileBufferPool = &BufferPool::getDefault();
+		mFileBufferAllocated = (size_t)nSize;
+		mFileBuffer = mFileBufferPool->allocate(mFileBufferAllocated);
+
+#ifdef _DEBUG
+		// Recycled buffers still have old content, so make stale reads visible.
+		if(mFileBuffer)
+			memset(mFileBuffer, 0xFE, mFileBufferAllocated);
+#endif
 	}
 
 	return mFileBuffer;
@@ -123,9 +147,16 @@ void BaseFile::freeFileBuffer(char *oFileBuffer)
 	UNUSED(oFileBuffer);
 
 	if(mFileBuffer)
-		delete [] mFileBuffer;
+	{
+		if(mFileBufferPool)
+			mFileBufferPool->release(mFileBuffer, mFileBufferAllocated);
+		else
+			delete [] mFileBuffer;
+	}
 
 	mFileBuffer = NULL;
+	mFileBufferPool = NULL;
+	mFileBufferAllocated = 0;
 }
 
 char *BaseFile::getFileBuffer(void) const
@@ -140,27 +171,209 @@ uint64_t BaseFile::getFileBufferSize(void) const
 
 uint64_t BaseFile::setFileBufferSize(uint64_t nFileBufferSize)
 {
-	if (nFileBufferSize == invalid64u_t)
-		nFileBufferSize = 4096u;
+	mRequestedBufferSize = nFileBufferSize;
 
-	mFileBufferSize = nFileBufferSize;
+	// The buffer of an open file can't be changed, the size is applied with the next open().
+	if (!mFileBuffer)
+		updateFileBufferSize();
 
 	return mFileBufferSize;
 }
 
+uint64_t BaseFile::updateFileBufferSize(void)
+{
+	if (mRequestedBufferSize == invalid64u_t)
+		mFileBufferSize = proposeFileBufferSize();
+	else
+		mFileBufferSize = mRequestedBufferSize;
+
+	return mFileBufferSize;
+}
+
+uint64_t BaseFile::proposeFileBufferSize(void)
+{
+	sysio::handle_t handle = getNativeHandle();
+	if (handle != sysio::invalid_handle)
+		return proposeFileBufferSize(handle, false);
+
+	return proposeFileBufferSize(getOpenpath(), false);
+}
+
+uint64_t BaseFile::proposeFileBufferSize(string const &oPath, bool bCompressed) const
+{
+	int64_t blockSize = -1;
+	int64_t fileLength = -1;
+
+#ifdef _WIN32
+	struct _stat64 st;
+	if (_stat64(oPath.c_str(), &st) == 0 && (st.st_mode & _S_IFREG))
+		fileLength = st.st_size;
+#else
+	struct stat st;
+	if (stat(oPath.c_str(), &st) == 0)
+	{
+		blockSize = st.st_blksize;
+		if (S_ISREG(st.st_mode))
+			fileLength = st.st_size;
+	}
+#endif
+
+	return proposeFileBufferSize(fileLength, blockSize, bCompressed);
+}
+
+uint64_t BaseFile::proposeFileBufferSize(sysio::handle_t nHandle, bool bCompressed) const
+{
+	int64_t blockSize;
+	int64_t fileLength;
+	sysio::fileInfo(nHandle, fileLength, blockSize);
+
+	return proposeFileBufferSize(fileLength, blockSize, bCompressed);
+}
+
+uint64_t BaseFile::proposeFileBufferSize(int64_t nFileLength, int64_t nBlockSize, bool bCompressed) const
+{
+	const uint64_t min_size = 4096u;
+	const uint64_t max_size = 1024u*1024u;
+
+	// Always whole blocks, so a refill never reads a partial block.
+	uint64_t size = min_size;
+	if (nBlockSize > 0 && (uint64_t)nBlockSize > size)
+		size = (uint64_t)nBlockSize;
+
+	// Sequential access gains from fewer and larger transfers, while random access
+	// would only read data which is thrown away. Compressed data is consumed slower
+	// than it is read, so its input buffer can be larger as well.
+	bool sequential = mOpenmode.sequential || mOpenmode.dontneed || mOpenmode.readahead || mOpenmode.writebehind;
+	if (sequential && !mOpenmode.random)
+		size *= 16;
+
+	if (bCompressed)
+		size *= 4;
+
+	size = min(size, max_size);
+
+	// A file which is only read never needs more than its length.
+	if (mOpenmode.read && !mOpenmode.write && nFileLength >= 0)
+	{
+		uint64_t length = ((uint64_t)nFileLength + min_size - 1) & ~(min_size - 1);
+		size = max(min(size, length), min_size);
+	}
+
+	return size;
+}
+
 int BaseFile::getChar(void)
 {
-	char c;
-	int64_t rd;
+	unsigned char c;
 
 	// Not the best idea to use this implementation but for completeness it is provided anyway.
-	// If getch() functionality is needed, a buffered stream object is the better solution.
-	if((rd = read(&c, 1)) < 0)
-		return 0;
+	// If getch() functionality is needed, ByteStream is the better solution.
+	if(read(&c, 1) != 1)
+		return EOF;
 
 	return c;
 }
 
+int64_t BaseFile::readAt(int64_t nOffset, void *oBuffer, int64_t nLen)
+{
+	lock_guard<mutex> lock(mPositionLock);
+
+	bool eof = isEOF();
+	int64_t pos = tell();
+	if(pos == invalid64_t)
+		return invalid64_t;
+
+	if(pos != nOffset && seek(nOffset, IFile::set) == invalid64_t)
+		return invalid64_t;
+
+	int64_t rd = read(oBuffer, nLen);
+
+	seek(pos, IFile::set);
+	setEOF(eof);
+
+	return rd;
+}
+
+int64_t BaseFile::writeAt(int64_t nOffset, void const *oBuffer, int64_t nLen)
+{
+	lock_guard<mutex> lock(mPositionLock);
+
+	int64_t pos = tell();
+	if(pos == invalid64_t)
+		return invalid64_t;
+
+	if(pos != nOffset && seek(nOffset, IFile::set) == invalid64_t)
+		return invalid64_t;
+
+	int64_t wr = write(oBuffer, nLen);
+
+	seek(pos, IFile::set);
+
+	return wr;
+}
+
+int64_t BaseFile::readv(buffer_span const *oSpans, size_t nCount)
+{
+	int64_t total = 0;
+
+	for(size_t i = 0; i < nCount; i++)
+	{
+		int64_t rd = read(oSpans[i].Data, oSpans[i].Length);
+		if(rd < 0)
+			return (total) ? total : invalid64_t;
+
+		total += rd;
+		if(rd < oSpans[i].Length)
+			break;
+	}
+
+	return total;
+}
+
+int64_t BaseFile::writev(const_buffer_span const *oSpans, size_t nCount)
+{
+	int64_t total = 0;
+
+	for(size_t i = 0; i < nCount; i++)
+	{
+		int64_t wr = write(oSpans[i].Data, oSpans[i].Length);
+		if(wr < 0)
+			return (total) ? total : invalid64_t;
+
+		total += wr;
+		if(wr < oSpans[i].Length)
+			break;
+	}
+
+	return total;
+}
+
+const char *BaseFile::peek(int64_t nMinBytes, int64_t &nAvailable)
+{
+	UNUSED(nMinBytes);
+
+	nAvailable = 0;
+
+	return NULL;
+}
+
+int64_t BaseFile::consume(int64_t nBytes)
+{
+	char buffer[4096];
+	int64_t total = 0;
+
+	while(total < nBytes)
+	{
+		int64_t rd = read(buffer, min(nBytes - total, (int64_t)sizeof(buffer)));
+		if(rd <= 0)
+			break;
+
+		total += rd;
+	}
+
+	return total;
+}
+
 void BaseFile::createPath(string const &oPath)
 {
 	string p;
@@ -168,14 +381,21 @@ void BaseFile::createPath(string const &oPath)
 
 	while(i < oPath.length())
 	{
-		size_t pos = oPath.find('\\', i);
+		size_t pos = oPath.find_first_of("\\/", i);
 		if(pos == string::npos)
 			return;
 
 		p = oPath.substr(0, pos);
 		i = pos+1;
 
+		if(p.empty())
+			continue;
+
+#ifdef _WIN32
 		_mkdir(p.c_str());
+#else
+		mkdir(p.c_str(), 0777);
+#endif
 	}
 }
 
@@ -0,0 +1,254 @@
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#include <sys/mman.h>
+#endif
+
+#include <atomic>
+
+#include "toolslib/files/BufferPool.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+using namespace std;
+
+const size_t BufferPool::page_size;
+const size_t BufferPool::huge_page_size;
+const size_t BufferPool::size_classes;
+const size_t BufferPool::default_cache_limit;
+
+namespace
+{
+
+// Buffers up to this class are kept per thread, larger ones always go to the pool.
+const size_t thread_cache_classes = 9;			// up to 1 MB
+const size_t thread_cache_depth = 4;
+
+char *alignedAlloc(size_t nSize, size_t nAlignment)
+{
+#ifdef _WIN32
+	return static_cast<char *>(_aligned_malloc(nSize, nAlignment));
+#else
+	void *p = NULL;
+	if (posix_memalign(&p, nAlignment, nSize) != 0)
+		return NULL;
+
+	return static_cast<char *>(p);
+#endif
+}
+
+void alignedFree(char *pBuffer)
+{
+#ifdef _WIN32
+	_aligned_free(pBuffer);
+#else
+	free(pBuffer);
+#endif
+}
+
+/**
+ * The buffers of all pools are allocated the same way, so the thread cache
+ * doesn't need to know which pool a buffer came from.
+ */
+class ThreadCache
+{
+public:
+	~ThreadCache(void);
+
+	char *pop(size_t nClass)
+	{
+		vector<char *> &list = mBuffers[nClass];
+		if (list.empty())
+			return NULL;
+
+		char *p = list.back();
+		list.pop_back();
+
+		return p;
+	}
+
+	bool push(size_t nClass, char *pBuffer)
+	{
+		vector<char *> &list = mBuffers[nClass];
+		if (list.size() >= thread_cache_depth)
+			return false;
+
+		list.push_back(pBuffer);
+		return true;
+	}
+
+private:
+	vector<char *> mBuffers[thread_cache_classes];
+};
+
+thread_local ThreadCache gThreadCache;
+
+// Buffers which are released after the cache of the thread is gone (i.e. by static
+// files at exit) bypass it. A plain bool stays valid until the thread is gone.
+thread_local bool gThreadCacheDestroyed = false;
+
+atomic<BufferPool *> gDefaultPool(nullptr);
+
+ThreadCache::~ThreadCache(void)
+{
+	gThreadCacheDestroyed = true;
+
+	for (size_t i = 0; i < thread_cache_classes; i++)
+	{
+		for (char *p : mBuffers[i])
+			alignedFree(p);
+	}
+}
+
+}
+
+BufferPool::BufferPool(size_t nCacheLimit, bool bHugePages)
+: mCachedBytes(0)
+, mCacheLimit(nCacheLimit)
+, mHugePages(bHugePages)
+{
+}
+
+BufferPool::~BufferPool(void)
+{
+	trim();
+}
+
+BufferPool &BufferPool::getDefault(void)
+{
+	// Never destroyed, because static files may still hold buffers from it at exit.
+	static BufferPool *pool = new BufferPool();
+
+	BufferPool *p = gDefaultPool.load();
+	return (p) ? *p : *pool;
+}
+
+void BufferPool::setDefault(BufferPool *pPool)
+{
+	gDefaultPool.store(pPool);
+}
+
+size_t BufferPool::sizeClass(size_t nSize)
+{
+	size_t cls = 0;
+	size_t size = page_size;
+	while (size < nSize && cls < size_classes)
+	{
+		size <<= 1;
+		cls++;
+	}
+
+	return cls;
+}
+
+size_t BufferPool::roundSize(size_t nSize)
+{
+	size_t cls = sizeClass(nSize);
+	if (cls < size_classes)
+		return page_size << cls;
+
+	return (nSize + page_size - 1) & ~(page_size - 1);
+}
+
+char *BufferPool::allocateMemory(size_t nSize)
+{
+	size_t size = roundSize(nSize);
+	if (!mHugePages || size < huge_page_size)
+		return alignedAlloc(size, page_size);
+
+	char *p = alignedAlloc(size, huge_page_size);
+#ifdef MADV_HUGEPAGE
+	if (p)
+		madvise(p, size, MADV_HUGEPAGE);
+#endif
+
+	return p;
+}
+
+void BufferPool::freeMemory(char *pBuffer)
+{
+	alignedFree(pBuffer);
+}
+
+char *BufferPool::allocate(size_t nSize)
+{
+	size_t cls = sizeClass(nSize);
+	if (cls < thread_cache_classes && !gThreadCacheDestroyed)
+	{
+		char *p = gThreadCache.pop(cls);
+		if (p)
+			return p;
+	}
+
+	if (cls < size_classes)
+	{
+		lock_guard<mutex> lock(mLock);
+
+		vector<char *> &list = mFreeLists[cls];
+		if (!list.empty())
+		{
+			char *p = list.back();
+			list.pop_back();
+			mCachedBytes -= page_size << cls;
+
+			return p;
+		}
+	}
+
+	return allocateMemory(nSize);
+}
+
+void BufferPool::release(char *pBuffer, size_t nSize)
+{
+	if (!pBuffer)
+		return;
+
+	size_t cls = sizeClass(nSize);
+	if (cls < thread_cache_classes && !gThreadCacheDestroyed && gThreadCache.push(cls, pBuffer))
+		return;
+
+	if (cls < size_classes)
+	{
+		lock_guard<mutex> lock(mLock);
+
+		size_t size = page_size << cls;
+		if (mCachedBytes + size <= mCacheLimit)
+		{
+			mFreeLists[cls].push_back(pBuffer);
+			mCachedBytes += size;
+			return;
+		}
+	}
+
+	freeMemory(pBuffer);
+}
+
+void BufferPool::trim(void)
+{
+	lock_guard<mutex> lock(mLock);
+
+	for (size_t i = 0; i < size_classes; i++)
+	{
+		for (char *p : mFreeLists[i])
+			freeMemory(p);
+
+		mFreeLists[i].clear();
+	}
+
+	mCachedBytes = 0;
+}
+
+size_t BufferPool::getCachedBytes(void) const
+{
+	lock_guard<mutex> lock(mLock);
+	return mCachedBytes;
+}
+
+}
+
+}
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cstring>
+
+#include "toolslib/files/ByteStream.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+using namespace std;
+
+const size_t ByteStream::default_buffer_size;
+const size_t ByteStream::putback_size;
+
+ByteStream::ByteStream(IFile &oFile, size_t nBufferSize)
+: mFile(oFile)
+, mBuffer(putback_size + max(nBufferSize, putback_size))
+, mEOF(false)
+{
+	mBegin = mCur = mEnd = &mBuffer[putback_size];
+
+	mEndPos = mFile.tell();
+	if(mEndPos == invalid64_t)
+		mEndPos = 0;
+}
+
+ByteStream::~ByteStream(void)
+{
+}
+
+int ByteStream::underflow(bool bConsume)
+{
+	if(mEOF)
+		return EOF;
+
+	// Keep the last characters, so they can still be returned with unget().
+	char *buffer = &mBuffer[putback_size];
+	size_t keep = min((size_t)(mCur - mBegin), putback_size);
+	memmove(buffer - keep, mCur - keep, keep);
+
+	int64_t rd = mFile.read(buffer, mBuffer.size() - putback_size);
+	if(rd <= 0)
+	{
+		mEOF = true;
+		mBegin = buffer - keep;
+		mCur = mEnd = buffer;
+		return EOF;
+	}
+
+	mBegin = buffer - keep;
+	mCur = buffer;
+	mEnd = buffer + rd;
+	mEndPos += rd;
+
+	if(bConsume)
+		return (unsigned char)*mCur++;
+
+	return (unsigned char)*mCur;
+}
+
+int64_t ByteStream::skipSlow(int64_t nBytes)
+{
+	int64_t avail = mEnd - mCur;
+	mCur = mEnd;
+
+	int64_t skipped = mFile.consume(nBytes - avail);
+	if(skipped < 0)
+		skipped = 0;
+
+	mEndPos += skipped;
+	if(skipped < nBytes - avail)
+		mEOF = true;
+
+	// The old buffer content is no longer in front of the position.
+	mBegin = mCur;
+
+	return avail + skipped;
+}
+
+int64_t ByteStream::read(void *oBuffer, int64_t nLen)
+{
+	char *p = static_cast<char *>(oBuffer);
+	int64_t total = min(nLen, (int64_t)(mEnd - mCur));
+
+	memcpy(p, mCur, (size_t)total);
+	mCur += total;
+
+	if(total == nLen || mEOF)
+		return total;
+
+	// Whatever doesn't fit into the buffer is not worth to be copied twice.
+	int64_t remaining = nLen - total;
+	if(remaining >= (int64_t)(mBuffer.size() - putback_size))
+	{
+		int64_t rd = mFile.read(&p[total], remaining);
+		if(rd > 0)
+		{
+			total += rd;
+			mEndPos += rd;
+			mBegin = mCur;
+		}
+
+		if(rd < remaining)
+			mEOF = true;
+
+		return total;
+	}
+
+	while(total < nLen)
+	{
+		if(underflow(false) == EOF)
+			break;
+
+		int64_t n = min(nLen - total, (int64_t)(mEnd - mCur));
+		memcpy(&p[total], mCur, (size_t)n);
+		mCur += n;
+		total += n;
+	}
+
+	return total;
+}
+
+bool ByteStream::sync(void)
+{
+	int64_t ahead = mEnd - mCur;
+	if(ahead == 0)
+		return true;
+
+	if(mFile.seek(-ahead, IFile::cur) == invalid64_t)
+		return false;
+
+	mEndPos -= ahead;
+	mEnd = mCur;
+	mEOF = false;
+
+	return true;
+}
+
+}
+
+}
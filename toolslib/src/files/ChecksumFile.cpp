@@ -0,0 +1,454 @@
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+
+#include "toolslib/files/ChecksumFile.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+using namespace std;
+
+// zlib takes the length as uInt.
+static const int64_t MAX_ZLIB_UPDATE = 1024*1024*1024;
+
+// Buffer for consume() beyond the view of peek().
+static const int64_t SKIP_BUFFER_SIZE = 64*1024;
+
+static const uint64_t XXH_PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t XXH_PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t XXH_PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t XXH_PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t XXH_PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl64(uint64_t nValue, int nBits)
+{
+	return (nValue << nBits) | (nValue >> (64 - nBits));
+}
+
+// xxHash is defined on little endian input.
+static inline uint64_t read64(uint8_t const *pData)
+{
+	uint64_t v;
+	memcpy(&v, pData, sizeof(v));
+	return v;
+}
+
+static inline uint32_t read32(uint8_t const *pData)
+{
+	uint32_t v;
+	memcpy(&v, pData, sizeof(v));
+	return v;
+}
+
+static inline uint64_t xxhRound(uint64_t nAccumulator, uint64_t nInput)
+{
+	nAccumulator += nInput * XXH_PRIME64_2;
+	nAccumulator = rotl64(nAccumulator, 31);
+	return nAccumulator * XXH_PRIME64_1;
+}
+
+static inline uint64_t xxhMerge(uint64_t nAccumulator, uint64_t nLane)
+{
+	nAccumulator ^= xxhRound(0, nLane);
+	return nAccumulator * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+Checksum::Checksum(Algorithm nAlgorithm)
+{
+	reset(nAlgorithm);
+}
+
+void Checksum::reset(Algorithm nAlgorithm)
+{
+	mAlgorithm = nAlgorithm;
+	mLength = 0;
+	mPendingLength = 0;
+
+	switch(mAlgorithm)
+	{
+		case CS_ADLER32:
+			mChecksum = adler32(0, Z_NULL, 0);
+		break;
+
+		default:
+			mChecksum = zlib_crc32(0, Z_NULL, 0);
+		break;
+	}
+
+	mLanes[0] = XXH_PRIME64_1 + XXH_PRIME64_2;
+	mLanes[1] = XXH_PRIME64_2;
+	mLanes[2] = 0;
+	mLanes[3] = 0 - XXH_PRIME64_1;
+}
+
+void Checksum::update(void const *pData, int64_t nLen)
+{
+	Bytef const *p = static_cast<Bytef const *>(pData);
+	mLength += nLen;
+
+	switch(mAlgorithm)
+	{
+		case CS_CRC32:
+			while(nLen > 0)
+			{
+				uInt n = (uInt)min(nLen, MAX_ZLIB_UPDATE);
+				mChecksum = zlib_crc32((uLong)mChecksum, p, n);
+				p += n;
+				nLen -= n;
+			}
+		break;
+
+		case CS_ADLER32:
+			while(nLen > 0)
+			{
+				uInt n = (uInt)min(nLen, MAX_ZLIB_UPDATE);
+				mChecksum = adler32((uLong)mChecksum, p, n);
+				p += n;
+				nLen -= n;
+			}
+		break;
+
+		case CS_XXH64:
+			updateXXH64(p, (size_t)nLen);
+		break;
+
+		case CS_MAX:
+		break;
+	}
+}
+
+void Checksum::updateXXH64(uint8_t const *pData, size_t nLen)
+{
+	// Complete the pending stripe first.
+	if(mPendingLength)
+	{
+		size_t n = min(nLen, sizeof(mPending) - mPendingLength);
+		memcpy(&mPending[mPendingLength], pData, n);
+		mPendingLength += n;
+		pData += n;
+		nLen -= n;
+
+		if(mPendingLength < sizeof(mPending))
+			return;
+
+		for(size_t i = 0; i < 4; i++)
+			mLanes[i] = xxhRound(mLanes[i], read64(&mPending[i * 8]));
+
+		mPendingLength = 0;
+	}
+
+	uint64_t v0 = mLanes[0];
+	uint64_t v1 = mLanes[1];
+	uint64_t v2 = mLanes[2];
+	uint64_t v3 = mLanes[3];
+	while(nLen >= 32)
+	{
+		v0 = xxhRound(v0, read64(pData));
+		v1 = xxhRound(v1, read64(pData + 8));
+		v2 = xxhRound(v2, read64(pData + 16));
+		v3 = xxhRound(v3, read64(pData + 24));
+		pData += 32;
+		nLen -= 32;
+	}
+
+	mLanes[0] = v0;
+	mLanes[1] = v1;
+	mLanes[2] = v2;
+	mLanes[3] = v3;
+
+	memcpy(mPending, pData, nLen);
+	mPendingLength = nLen;
+}
+
+uint64_t Checksum::digestXXH64(void) const
+{
+	uint64_t h;
+	if(mLength >= 32)
+	{
+		h = rotl64(mLanes[0], 1) + rotl64(mLanes[1], 7) + rotl64(mLanes[2], 12) + rotl64(mLanes[3], 18);
+		for(size_t i = 0; i < 4; i++)
+			h = xxhMerge(h, mLanes[i]);
+	}
+	else
+		h = XXH_PRIME64_5;
+
+	h += (uint64_t)mLength;
+
+	uint8_t const *p = mPending;
+	size_t len = mPendingLength;
+	while(len >= 8)
+	{
+		h ^= xxhRound(0, read64(p));
+		h = rotl64(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+		p += 8;
+		len -= 8;
+	}
+
+	if(len >= 4)
+	{
+		h ^= (uint64_t)read32(p) * XXH_PRIME64_1;
+		h = rotl64(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+		p += 4;
+		len -= 4;
+	}
+
+	while(len > 0)
+	{
+		h ^= (*p) * XXH_PRIME64_5;
+		h = rotl64(h, 11) * XXH_PRIME64_1;
+		p++;
+		len--;
+	}
+
+	h ^= h >> 33;
+	h *= XXH_PRIME64_2;
+	h ^= h >> 29;
+	h *= XXH_PRIME64_3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+uint64_t Checksum::getDigest(void) const
+{
+	if(mAlgorithm == CS_XXH64)
+		return digestXXH64();
+
+	return mChecksum;
+}
+
+uint64_t Checksum::compute(Algorithm nAlgorithm, void const *pData, int64_t nLen)
+{
+	Checksum checksum(nAlgorithm);
+	checksum.update(pData, nLen);
+
+	return checksum.getDigest();
+}
+
+ChecksumFile::ChecksumFile(IFile &oFile, Checksum::Algorithm nAlgorithm)
+: mFile(oFile)
+, mChecksum(nAlgorithm)
+, mPeekView(NULL)
+, mPeekAvailable(0)
+{
+}
+
+ChecksumFile::~ChecksumFile(void)
+{
+}
+
+bool ChecksumFile::open(void)
+{
+	mPeekView = NULL;
+	mChecksum.reset();
+
+	return mFile.open();
+}
+
+bool ChecksumFile::open(open_mode const &oMode)
+{
+	mPeekView = NULL;
+	mChecksum.reset();
+
+	return mFile.open(oMode);
+}
+
+void ChecksumFile::close(void)
+{
+	mPeekView = NULL;
+	mFile.close();
+}
+
+void ChecksumFile::flush(void)
+{
+	mFile.flush();
+}
+
+bool ChecksumFile::isEOF(void) const
+{
+	return mFile.isEOF();
+}
+
+int64_t ChecksumFile::read(void *oBuffer, int64_t nLen)
+{
+	mPeekView = NULL;
+
+	int64_t rd = mFile.read(oBuffer, nLen);
+	if(rd > 0)
+		mChecksum.update(oBuffer, rd);
+
+	return rd;
+}
+
+int64_t ChecksumFile::write(const void *oBuffer, int64_t nLen)
+{
+	mPeekView = NULL;
+
+	int64_t wr = mFile.write(oBuffer, nLen);
+	if(wr > 0)
+		mChecksum.update(oBuffer, wr);
+
+	return wr;
+}
+
+int64_t ChecksumFile::seek(int64_t nOffset, IFile::seek_pos nPos)
+{
+	mPeekView = NULL;
+
+	return mFile.seek(nOffset, nPos);
+}
+
+int64_t ChecksumFile::tell(void)
+{
+	return mFile.tell();
+}
+
+int64_t ChecksumFile::length(void)
+{
+	return mFile.length();
+}
+
+int ChecksumFile::getChar(void)
+{
+	mPeekView = NULL;
+
+	int c = mFile.getChar();
+	if(c != EOF)
+	{
+		uint8_t b = (uint8_t)c;
+		mChecksum.update(&b, 1);
+	}
+
+	return c;
+}
+
+int64_t ChecksumFile::readAt(int64_t nOffset, void *oBuffer, int64_t nLen)
+{
+	return mFile.readAt(nOffset, oBuffer, nLen);
+}
+
+int64_t ChecksumFile::writeAt(int64_t nOffset, void const *oBuffer, int64_t nLen)
+{
+	mPeekView = NULL;
+
+	return mFile.writeAt(nOffset, oBuffer, nLen);
+}
+
+int64_t ChecksumFile::readv(buffer_span const *oSpans, size_t nCount)
+{
+	mPeekView = NULL;
+
+	int64_t rd = mFile.readv(oSpans, nCount);
+	int64_t remaining = rd;
+	for(size_t i = 0; i < nCount && remaining > 0; i++)
+	{
+		int64_t n = min(remaining, oSpans[i].Length);
+		mChecksum.update(oSpans[i].Data, n);
+		remaining -= n;
+	}
+
+	return rd;
+}
+
+int64_t ChecksumFile::writev(const_buffer_span const *oSpans, size_t nCount)
+{
+	mPeekView = NULL;
+
+	int64_t wr = mFile.writev(oSpans, nCount);
+	int64_t remaining = wr;
+	for(size_t i = 0; i < nCount && remaining > 0; i++)
+	{
+		int64_t n = min(remaining, oSpans[i].Length);
+		mChecksum.update(oSpans[i].Data, n);
+		remaining -= n;
+	}
+
+	return wr;
+}
+
+const char *ChecksumFile::peek(int64_t nMinBytes, int64_t &nAvailable)
+{
+	mPeekView = mFile.peek(nMinBytes, nAvailable);
+	mPeekAvailable = (mPeekView) ? nAvailable : 0;
+
+	return mPeekView;
+}
+
+int64_t ChecksumFile::consume(int64_t nBytes)
+{
+	if(mPeekView && nBytes <= mPeekAvailable)
+	{
+		const char *view = mPeekView;
+		mPeekView = NULL;
+
+		int64_t n = mFile.consume(nBytes);
+		if(n > 0)
+			mChecksum.update(view, n);
+
+		return n;
+	}
+
+	// The data we haven't seen has to be read, otherwise the checksum would have a gap.
+	mPeekView = NULL;
+
+	char buffer[SKIP_BUFFER_SIZE];
+	int64_t total = 0;
+	while(total < nBytes)
+	{
+		int64_t rd = read(buffer, min(nBytes - total, SKIP_BUFFER_SIZE));
+		if(rd <= 0)
+			break;
+
+		total += rd;
+	}
+
+	return total;
+}
+
+bool ChecksumFile::isOpen(void) const
+{
+	return mFile.isOpen();
+}
+
+void ChecksumFile::setFilename(Filename const &oFilename)
+{
+	mFile.setFilename(oFilename);
+}
+
+const Filename &ChecksumFile::getFilename(void) const
+{
+	return mFile.getFilename();
+}
+
+string const &ChecksumFile::getOpenpath(void) const
+{
+	return mFile.getOpenpath();
+}
+
+uint64_t ChecksumFile::getFileBufferSize(void) const
+{
+	return mFile.getFileBufferSize();
+}
+
+uint64_t ChecksumFile::setFileBufferSize(uint64_t nFileBufferSize)
+{
+	return mFile.setFileBufferSize(nFileBufferSize);
+}
+
+char *ChecksumFile::getFileBuffer(void) const
+{
+	return mFile.getFileBuffer();
+}
+
+void ChecksumFile::setOpenmode(open_mode const &oMode)
+{
+	mFile.setOpenmode(oMode);
+}
+
+}
+
+}
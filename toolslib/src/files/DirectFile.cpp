@@ -0,0 +1,330 @@
+#include <algorithm>
+#include <cstring>
+
+#include "toolslib/files/DirectFile.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+using namespace std;
+
+const size_t DirectFile::alignment;
+
+// Without the cache every transfer goes to the device, so they should never be small.
+static const uint64_t MIN_BUFFER_SIZE = 1024*1024;
+
+DirectFile::DirectFile(Filename const &oFilename)
+	: super(oFilename)
+{
+	init();
+	mWriteError = false;
+}
+
+DirectFile::~DirectFile(void)
+{
+	close();
+}
+
+void DirectFile::init(void)
+{
+	mFileHandle = sysio::invalid_handle;
+	mUnbuffered = false;
+	mFilePos = invalid64_t;
+	mFileLength = 0;
+	mBufferSize = 0;
+	mBufferPos = invalid64_t;
+	mBufferFill = 0;
+	mDirtyBegin = 0;
+	mDirtyEnd = 0;
+}
+
+uint64_t DirectFile::proposeFileBufferSize(void)
+{
+	if(mFileHandle == sysio::invalid_handle)
+		return max(super::proposeFileBufferSize(), MIN_BUFFER_SIZE);
+
+	return max(super::proposeFileBufferSize(mFileHandle, false), MIN_BUFFER_SIZE);
+}
+
+char *DirectFile::allocateFileBuffer(int64_t nSize)
+{
+	return super::allocateFileBuffer(alignUp(max(nSize, (int64_t)alignment)));
+}
+
+bool DirectFile::open(void)
+{
+	// The buffer is sized from the handle, once it is open.
+	beginOpen(false);
+	mWriteError = false;
+
+	// Blocks which are only partially written, have to be read first.
+	IFile::open_mode md = getOpenmode();
+	IFile::open_mode access = md;
+	if(md.write)
+		access.read = true;
+
+	mUnbuffered = true;
+	mFileHandle = sysio::openFile(getOpenpath(), access, true);
+	if(mFileHandle == sysio::invalid_handle)
+	{
+		mUnbuffered = false;
+		mFileHandle = sysio::openFile(getOpenpath(), access);
+	}
+
+	if(mFileHandle == sysio::invalid_handle)
+	{
+		close();
+		return false;
+	}
+
+	mFileLength = sysio::fileSize(mFileHandle);
+	if(mFileLength == invalid64_t)
+	{
+		close();
+		return false;
+	}
+
+	allocateFileBuffer(updateFileBufferSize());
+	mBufferSize = alignUp(max((int64_t)getFileBufferSize(), (int64_t)alignment));
+	mFilePos = (md.append) ? mFileLength : 0;
+	setIsOpen(true);
+
+	return true;
+}
+
+void DirectFile::close(void)
+{
+	super::close();
+
+	sysio::closeFile(mFileHandle);
+	init();
+}
+
+void DirectFile::flush(void)
+{
+	flushBuffer();
+}
+
+bool DirectFile::flushBuffer(void)
+{
+	if(mDirtyBegin == mDirtyEnd)
+		return true;
+
+	// Unbuffered writes must cover whole blocks. The buffer always holds the data of
+	// the file up to mBufferFill, so the partial blocks at the ends are complete.
+	int64_t begin = mDirtyBegin;
+	int64_t end = mDirtyEnd;
+	if(mUnbuffered)
+	{
+		begin = alignDown(begin);
+		end = alignUp(end);
+	}
+
+	// The padding behind the data must not write garbage into the file, not even for a moment.
+	char *buffer = getFileBuffer();
+	if(end > mBufferFill)
+		memset(&buffer[mBufferFill], 0, (size_t)(end - mBufferFill));
+
+	// A partial write of whole blocks can't be told apart from a complete failure, so
+	// the range stays modified as a whole.
+	int64_t wr = sysio::writeAt(mFileHandle, mBufferPos + begin, &buffer[begin], end - begin);
+	if(wr != end - begin)
+	{
+		mWriteError = true;
+		return false;
+	}
+
+	mDirtyBegin = 0;
+	mDirtyEnd = 0;
+
+	// Cut off the padding again.
+	if(mBufferPos + end > mFileLength && !sysio::truncateFile(mFileHandle, mFileLength))
+	{
+		mWriteError = true;
+		return false;
+	}
+
+	return true;
+}
+
+bool DirectFile::loadBuffer(int64_t nPosition)
+{
+	if(!flushBuffer())
+		return false;
+
+	mBufferPos = alignDown(nPosition);
+	mBufferFill = 0;
+
+	// Behind the end of the file there is nothing to read.
+	if(mBufferPos >= mFileLength)
+		return true;
+
+	int64_t rd = sysio::readAt(mFileHandle, mBufferPos, getFileBuffer(), mBufferSize);
+	if(rd < 0)
+	{
+		mBufferPos = invalid64_t;
+		return false;
+	}
+
+	mBufferFill = rd;
+
+	return true;
+}
+
+int64_t DirectFile::read(void *oBuffer, int64_t nLen)
+{
+	if(mFileHandle == sysio::invalid_handle || oBuffer == NULL)
+		return invalid64_t;
+
+	char *p = static_cast<char *>(oBuffer);
+	char *buffer = getFileBuffer();
+	int64_t total = 0;
+
+	setEOF(false);
+	while(total < nLen)
+	{
+		int64_t offset = mFilePos - mBufferPos;
+		if(mBufferPos != invalid64_t && offset >= 0 && offset < mBufferFill)
+		{
+			int64_t n = min(mBufferFill - offset, nLen - total);
+			memcpy(&p[total], &buffer[offset], (size_t)n);
+			total += n;
+			mFilePos += n;
+			continue;
+		}
+
+		if(mFilePos >= mFileLength)
+		{
+			setEOF();
+			break;
+		}
+
+		if(!loadBuffer(mFilePos))
+			return (total) ? total : invalid64_t;
+
+		// The file was shorter than expected.
+		if(mFilePos - mBufferPos >= mBufferFill)
+		{
+			setEOF();
+			break;
+		}
+	}
+
+	return total;
+}
+
+int64_t DirectFile::write(void const *oBuffer, int64_t nLen)
+{
+	if(mFileHandle == sysio::invalid_handle || oBuffer == NULL)
+		return invalid64_t;
+
+	IFile::open_mode md = getOpenmode();
+	if(!md.write || mWriteError)
+		return invalid64_t;
+
+	if(md.append)
+		mFilePos = mFileLength;
+
+	const char *p = static_cast<const char *>(oBuffer);
+	char *buffer = getFileBuffer();
+	int64_t total = 0;
+
+	while(total < nLen)
+	{
+		int64_t offset = mFilePos - mBufferPos;
+		if(mBufferPos == invalid64_t || offset < 0 || offset >= mBufferSize)
+		{
+			// A window which is overwritten completely doesn't need to be read.
+			if(mFilePos == alignDown(mFilePos) && nLen - total >= mBufferSize)
+			{
+				if(!flushBuffer())
+					return (total) ? total : invalid64_t;
+
+				mBufferPos = mFilePos;
+				mBufferFill = 0;
+			}
+			else if(!loadBuffer(mFilePos))
+				return (total) ? total : invalid64_t;
+
+			offset = mFilePos - mBufferPos;
+		}
+
+		// A gap behind the data reads as zeroes.
+		if(offset > mBufferFill)
+			memset(&buffer[mBufferFill], 0, (size_t)(offset - mBufferFill));
+
+		int64_t n = min(mBufferSize - offset, nLen - total);
+		memcpy(&buffer[offset], &p[total], (size_t)n);
+
+		if(mDirtyBegin == mDirtyEnd)
+		{
+			mDirtyBegin = offset;
+			mDirtyEnd = offset + n;
+		}
+		else
+		{
+			mDirtyBegin = min(mDirtyBegin, offset);
+			mDirtyEnd = max(mDirtyEnd, offset + n);
+		}
+
+		mBufferFill = max(mBufferFill, offset + n);
+		mFileLength = max(mFileLength, mBufferPos + mBufferFill);
+		total += n;
+		mFilePos += n;
+	}
+
+	return total;
+}
+
+int64_t DirectFile::seek(int64_t nOffset, IFile::seek_pos nPos)
+{
+	if(mFileHandle == sysio::invalid_handle)
+		return invalid64_t;
+
+	int64_t pos = invalid64_t;
+	switch(nPos)
+	{
+		case IFile::cur:
+			pos = mFilePos + nOffset;
+		break;
+
+		case IFile::set:
+			pos = nOffset;
+		break;
+
+		case IFile::end:
+			pos = mFileLength - nOffset;
+		break;
+	}
+
+	if(pos < 0)
+		return invalid64_t;
+
+	mFilePos = pos;
+	setEOF(false);
+
+	return mFilePos;
+}
+
+int64_t DirectFile::tell(void)
+{
+	if(mFileHandle == sysio::invalid_handle)
+		return invalid64_t;
+
+	return mFilePos;
+}
+
+int64_t DirectFile::length(void)
+{
+	if(mFileHandle == sysio::invalid_handle)
+		return invalid64_t;
+
+	return mFileLength;
+}
+
+}
+
+}
@@ -1,10 +1,25 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 #include <fcntl.h>
-#include <io.h>
 #include <sys/stat.h>
 
+#ifdef _WIN32
+#include <io.h>
+
+#define fseeko _fseeki64
+#define ftello _ftelli64
+#define fileno _fileno
+#define flockfile _lock_file
+#define funlockfile _unlock_file
+#define fread_unlocked _fread_nolock
+#define fwrite_unlocked _fwrite_nolock
+#elif !defined(__GLIBC__)
+#define fread_unlocked fread
+#define fwrite_unlocked fwrite
+#endif
+
 #include "toolslib/files/File.h"
+#include "toolslib/files/SystemIO.h"
 
 namespace toolslib
 {
@@ -14,28 +29,56 @@ namespace files
 
 using namespace std;
 
+// Reads which are not prefetched are dropped from the cache in steps of this size, if
+// the file is opened with dontneed.
+static const int64_t DROP_BEHIND_SIZE = 8*1024*1024;
+
+// The prefetching thread reads with positional reads on the native handle below the stream.
+static sysio::handle_t nativeHandle(FILE *oFile)
+{
+#ifdef _WIN32
+	return (sysio::handle_t)_get_osfhandle(fileno(oFile));
+#else
+	return fileno(oFile);
+#endif
+}
+
 File::File(Filename const &oFilename)
 	: super(oFilename)
 	, mDoClose(false)
+	, mReadAheadDepth(ReadAhead::default_depth)
+	, mReadAheadChunkSize(ReadAhead::default_chunk_size)
+	, mWriteBehindDepth(WriteBehind::default_depth)
+	, mWriteBehindBufferSize(WriteBehind::default_buffer_size)
+	, mWriteError(false)
+	, mDropPosition(invalid64_t)
 {
 	init();
 }
 
 File::File(Filename const &oFilename, FILE *oFile, const IFile::open_mode &mode, bool bDoClose)
+	: mReadAheadDepth(ReadAhead::default_depth)
+	, mReadAheadChunkSize(ReadAhead::default_chunk_size)
+	, mWriteBehindDepth(WriteBehind::default_depth)
+	, mWriteBehindBufferSize(WriteBehind::default_buffer_size)
+	, mWriteError(false)
+	, mDropPosition(invalid64_t)
 {
+	mFileHandle = oFile;
+
 	if (oFile)
 	{
 		setFilename(oFilename);
 		setOpenmode(mode);
 		setEOF(false);
-		allocateFileBuffer(setFileBufferSize());
+		allocateFileBuffer(updateFileBufferSize());
 		setIsOpen(true);
 		mDoClose = bDoClose;
+		startReadAhead();
+		startWriteBehind();
 	}
 	else
 		init();
-
-	mFileHandle = oFile;
 }
 
 File *File::setSTDIN(FILE *oStdIn)
@@ -54,10 +97,10 @@ File *File::setSTDIN(FILE *oStdIn)
 	setFilename("stdin");
 	setOpenmode(md);
 	setEOF(false);
-	allocateFileBuffer(setFileBufferSize());
+	mFileHandle = oStdIn;
+	allocateFileBuffer(updateFileBufferSize());
 	setIsOpen(true);
 	mDoClose = false;
-	mFileHandle = oStdIn;
 
 	return this;
 }
@@ -78,10 +121,10 @@ File *File::setSTDOUT(FILE *oStdOut)
 	setFilename("stdout");
 	setOpenmode(md);
 	setEOF(false);
-	allocateFileBuffer(setFileBufferSize());
+	mFileHandle = oStdOut;
+	allocateFileBuffer(updateFileBufferSize());
 	setIsOpen(true);
 	mDoClose = false;
-	mFileHandle = oStdOut;
 
 	return this;
 }
@@ -97,7 +140,74 @@ void File::init(void)
 
 File::~File(void)
 {
-	super::close();
+	close();
+}
+
+void File::setReadAhead(size_t nDepth, size_t nChunkSize)
+{
+	mReadAheadDepth = nDepth;
+	mReadAheadChunkSize = nChunkSize;
+}
+
+uint64_t File::proposeFileBufferSize(void)
+{
+	// The read ahead and the write behind transfer positionally with buffers of their
+	// own, so the data doesn't pass through the stream buffer.
+	IFile::open_mode md = getOpenmode();
+	if((md.readahead && !md.random && !md.write) || (md.writebehind && md.write && !md.read))
+		return 4096u;
+
+	if(!mFileHandle)
+		return super::proposeFileBufferSize();
+
+	return super::proposeFileBufferSize(nativeHandle(mFileHandle), false);
+}
+
+void File::startReadAhead(void)
+{
+	IFile::open_mode md = getOpenmode();
+	if(!md.readahead || md.random || md.write || !mFileHandle)
+		return;
+
+	// Pipes and terminals can't be read positionally, so they stay with the stream.
+	int64_t pos = ftello(mFileHandle);
+	if(pos < 0)
+		return;
+
+	mReadAhead.reset(new ReadAhead(nativeHandle(mFileHandle), pos, mReadAheadDepth, mReadAheadChunkSize, md.dontneed));
+}
+
+void File::setWriteBehind(size_t nDepth, size_t nBufferSize)
+{
+	mWriteBehindDepth = nDepth;
+	mWriteBehindBufferSize = nBufferSize;
+}
+
+void File::startWriteBehind(void)
+{
+	mWriteError = false;
+
+	IFile::open_mode md = getOpenmode();
+	if(!md.writebehind || !md.write || md.read || !mFileHandle)
+		return;
+
+	int64_t pos = ftello(mFileHandle);
+	if(pos < 0)
+		return;
+
+	// Positional writes ignore the append mode of the stream.
+	if(md.append)
+		pos = length();
+
+	mWriteBehind.reset(new WriteBehind(nativeHandle(mFileHandle), pos, mWriteBehindDepth, mWriteBehindBufferSize));
+}
+
+sysio::handle_t File::getNativeHandle(void) const
+{
+	if(!mFileHandle || getOpenmode().write)
+		return sysio::invalid_handle;
+
+	return nativeHandle(mFileHandle);
 }
 
 FILE *File::getFileHandle(void) const
@@ -145,15 +255,38 @@ IFile::open_mode File::openMode(string const &oMode)
 
 bool File::open(void)
 {
-	super::open();
-	mFileHandle = fopen(getOpenpath().c_str(), getFileOpenmode().c_str());
+	// The buffer is sized from the stream, once it is open.
+	beginOpen(false);
+
+	IFile::open_mode md = getOpenmode();
+	string mode = getFileOpenmode();
+#ifdef _WIN32
+	// The access hints can only be given when the file is opened.
+	if (md.random)
+		mode += "R";
+	else if (md.sequential || md.dontneed)
+		mode += "S";
+#endif
+
+	mFileHandle = fopen(getOpenpath().c_str(), mode.c_str());
 	if (mFileHandle == NULL)
 	{
 		setIsOpen(false);
 		return false;
 	}
 
+	allocateFileBuffer(updateFileBufferSize());
 	setvbuf(mFileHandle, getFileBuffer(), _IOFBF, (size_t)getFileBufferSize());
+	sysio::adviseFile(nativeHandle(mFileHandle), md);
+
+	// We opened it, so we have to close it as well.
+	mDoClose = true;
+	startReadAhead();
+	startWriteBehind();
+
+	mDropPosition = invalid64_t;
+	if (md.dontneed && !mReadAhead)
+		mDropPosition = 0;
 
 	setIsOpen(true);
 	return true;
@@ -161,14 +294,32 @@ bool File::open(void)
 
 void File::close(void)
 {
-	if (mDoClose)
+	mReadAhead.reset();
+
+	if (mWriteBehind)
 	{
-		super::close();
+		if (!mWriteBehind->flush())
+			mWriteError = true;
+
+		mWriteBehind.reset();
+	}
+
+	if (mFileHandle && getOpenmode().dontneed)
+	{
+		fflush(mFileHandle);
+		sysio::dropCache(nativeHandle(mFileHandle), 0, 0);
+	}
 
+	mDropPosition = invalid64_t;
+
+	if (mDoClose)
+	{
+		// The stream uses our buffer, so it has to be closed before the buffer is released.
 		if (mFileHandle)
 			fclose(mFileHandle);
 
 		mFileHandle = NULL;
+		super::close();
 	}
 	else
 		flush();
@@ -176,11 +327,24 @@ void File::close(void)
 
 void File::flush(void)
 {
-	fflush(mFileHandle);
+	if (mWriteBehind)
+	{
+		if (!mWriteBehind->flush())
+			mWriteError = true;
+
+		return;
+	}
+
+	// fflush(NULL) would flush all streams.
+	if (mFileHandle)
+		fflush(mFileHandle);
 }
 
 bool File::isEOF(void) const
 {
+	if (mReadAhead)
+		return mReadAhead->isEOF();
+
 	return feof(mFileHandle) != 0;
 }
 
@@ -204,12 +368,48 @@ int64_t File::seek(int64_t nOffset, IFile::seek_pos nPos)
 		break;
 	}
 
-	return _fseeki64(mFileHandle, nOffset, mode);
+	if (mReadAhead)
+	{
+		int64_t pos = nOffset;
+		if (mode == SEEK_CUR)
+			pos += mReadAhead->tell();
+		else if (mode == SEEK_END)
+			pos += length();
+
+		if (pos < 0)
+			return invalid64_t;
+
+		mReadAhead->seek(pos);
+		return 0;
+	}
+
+	if (mWriteBehind)
+	{
+		int64_t pos = nOffset;
+		if (mode == SEEK_CUR)
+			pos += mWriteBehind->tell();
+		else if (mode == SEEK_END)
+			pos += length();
+
+		if (pos < 0)
+			return invalid64_t;
+
+		mWriteBehind->seek(pos);
+		return 0;
+	}
+
+	return fseeko(mFileHandle, nOffset, mode);
 }
 
 int64_t File::tell(void)
 {
-	return _ftelli64(mFileHandle);
+	if (mReadAhead)
+		return mReadAhead->tell();
+
+	if (mWriteBehind)
+		return mWriteBehind->tell();
+
+	return ftello(mFileHandle);
 }
 
 int64_t File::length(void)
@@ -217,27 +417,187 @@ int64_t File::length(void)
 	if(!mFileHandle)
 		return invalid64_t;
 
-	struct _stati64 buffer;
+	// Pending data counts as well.
+	if(mWriteBehind)
+		flush();
+
+	// Use the open descriptor, instead of resolving the path again.
+#ifdef _WIN32
+	struct _stat64 buffer;
+	int rc = _fstat64(fileno(mFileHandle), &buffer);
+#else
+	struct stat buffer;
+	int rc = fstat(fileno(mFileHandle), &buffer);
+#endif
 
-	int rc = _stat64(getOpenpath().c_str(), &buffer);
 	return rc == 0 ? buffer.st_size : invalid64_t;
 }
 
+int64_t File::consume(int64_t nBytes)
+{
+	// The length of a file which is written may still be in the stream buffer.
+	int64_t pos = (mFileHandle && !getOpenmode().write) ? tell() : invalid64_t;
+	int64_t len = (pos >= 0) ? length() : invalid64_t;
+	if (pos < 0 || len == invalid64_t)
+		return super::consume(nBytes);
+
+	nBytes = max((int64_t)0, min(nBytes, len - pos));
+	if (seek(pos + nBytes, IFile::set) != 0)
+		return invalid64_t;
+
+	return nBytes;
+}
+
 int64_t File::read(void *oBuffer, int64_t nLen)
 {
-	return fread(oBuffer, 1, (size_t)nLen, mFileHandle);
+	if (mReadAhead)
+		return mReadAhead->read(oBuffer, nLen);
+
+	int64_t rd = fread(oBuffer, 1, (size_t)nLen, mFileHandle);
+	if (mDropPosition != invalid64_t)
+		dropBehind();
+
+	return rd;
+}
+
+void File::dropBehind(void)
+{
+	int64_t pos = ftello(mFileHandle);
+	if (pos < 0)
+	{
+		// Not a regular file, so there is nothing to drop.
+		mDropPosition = invalid64_t;
+		return;
+	}
+
+	if (pos < mDropPosition)			// After a seek backwards.
+		mDropPosition = pos;
+
+	// A system call for each read would cost more than it saves.
+	if (pos - mDropPosition < DROP_BEHIND_SIZE)
+		return;
+
+	sysio::dropCache(nativeHandle(mFileHandle), mDropPosition, pos - mDropPosition);
+	mDropPosition = pos;
 }
 
 int64_t File::write(void const *oBuffer, int64_t nLen)
 {
+	if (mWriteBehind)
+	{
+		int64_t wr = mWriteBehind->write(oBuffer, nLen);
+		if (wr < 0)
+			mWriteError = true;
+
+		return wr;
+	}
+
 	return fwrite(oBuffer, 1, (size_t)nLen, mFileHandle);
 }
 
 int File::getChar(void)
 {
+	if (mReadAhead)
+	{
+		unsigned char c;
+		if (mReadAhead->read(&c, 1) != 1)
+			return EOF;
+
+		return c;
+	}
+
 	return fgetc(mFileHandle);
 }
 
+int64_t File::readAt(int64_t nOffset, void *oBuffer, int64_t nLen)
+{
+#ifdef _WIN32
+	// A positional ReadFile() also moves the file pointer below the stream, so
+	// we have to go the safe way.
+	return super::readAt(nOffset, oBuffer, nLen);
+#else
+	if(!mFileHandle || oBuffer == NULL)
+		return invalid64_t;
+
+	// Data which is still in the stream buffer must be visible to the descriptor.
+	if(getOpenmode().write)
+		fflush(mFileHandle);
+
+	return sysio::readAt(fileno(mFileHandle), nOffset, oBuffer, nLen);
+#endif
+}
+
+int64_t File::writeAt(int64_t nOffset, void const *oBuffer, int64_t nLen)
+{
+#ifdef _WIN32
+	return super::writeAt(nOffset, oBuffer, nLen);
+#else
+	if(!mFileHandle || oBuffer == NULL || !getOpenmode().write)
+		return invalid64_t;
+
+	flush();
+
+	return sysio::writeAt(fileno(mFileHandle), nOffset, oBuffer, nLen);
+#endif
+}
+
+int64_t File::readv(buffer_span const *oSpans, size_t nCount)
+{
+	if(!mFileHandle)
+		return invalid64_t;
+
+	if(mReadAhead)
+		return super::readv(oSpans, nCount);
+
+	// The stream is locked only once for all buffers, and the stream buffer
+	// collects them into as few system calls as possible.
+	int64_t total = 0;
+	flockfile(mFileHandle);
+
+	for(size_t i = 0; i < nCount; i++)
+	{
+		size_t len = (size_t)oSpans[i].Length;
+		size_t rd = fread_unlocked(oSpans[i].Data, 1, len, mFileHandle);
+
+		total += rd;
+		if(rd < len)
+			break;
+	}
+
+	funlockfile(mFileHandle);
+
+	if (mDropPosition != invalid64_t)
+		dropBehind();
+
+	return total;
+}
+
+int64_t File::writev(const_buffer_span const *oSpans, size_t nCount)
+{
+	if(!mFileHandle)
+		return invalid64_t;
+
+	if(mWriteBehind)
+		return super::writev(oSpans, nCount);
+
+	int64_t total = 0;
+	flockfile(mFileHandle);
+
+	for(size_t i = 0; i < nCount; i++)
+	{
+		size_t len = (size_t)oSpans[i].Length;
+		size_t wr = fwrite_unlocked(oSpans[i].Data, 1, len, mFileHandle);
+
+		total += wr;
+		if(wr < len)
+			break;
+	}
+
+	funlockfile(mFileHandle);
+
+	return total;
+}
+
 }
 
 }
@@ -1,10 +1,20 @@
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
 #include <algorithm>
 #include <vector>
+#include <sys/stat.h>
 
 #include "toolslib/files/FileFactory.h"
 
+#include "toolslib/files/BufferPool.h"
+#include "toolslib/files/DirectFile.h"
 #include "toolslib/files/File.h"
 #include "toolslib/files/GZFile.h"
+#include "toolslib/files/HandleFile.h"
+#include "toolslib/files/MappedFile.h"
+#include "toolslib/files/SystemIO.h"
 #include "toolslib/files/ZIPFile.h"
 #include "toolslib/files/ZIPScanner.h"
 
@@ -26,7 +36,66 @@ static vector<FileFactory::FileType> gSupportedFileTypes;
 
 FileFactory *FileFactory::mInstance = NULL;
 
+// Below this size, the cost of setting up the mapping outweighs the copy through the stream buffer.
+static const int64_t DEFAULT_MAPPING_THRESHOLD = 64*1024*1024;
+
+// Buffer for copies which can't be done by the kernel.
+static const int64_t COPY_BUFFER_SIZE = 4*1024*1024;
+
+/**
+ * Returns the size of the file, if it is a regular file, otherwise invalid64_t.
+ */
+static int64_t regularFileSize(string const &oPath)
+{
+#ifdef _WIN32
+	struct _stat64 st;
+	if(_stat64(oPath.c_str(), &st) != 0 || (st.st_mode & _S_IFREG) == 0)
+		return invalid64_t;
+#else
+	struct stat st;
+	if(stat(oPath.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+		return invalid64_t;
+#endif
+
+	return st.st_size;
+}
+
+/**
+ * True if both paths refer to the same existing file, also through links.
+ */
+static bool isSameFile(string const &oPath1, string const &oPath2)
+{
+#ifdef _WIN32
+	BY_HANDLE_FILE_INFORMATION info[2];
+	string const *paths[2] = { &oPath1, &oPath2 };
+	for(int i = 0; i < 2; i++)
+	{
+		// Only the attributes are queried, so the file may be open elsewhere.
+		HANDLE h = CreateFileA(paths[i]->c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+		if(h == INVALID_HANDLE_VALUE)
+			return false;
+
+		BOOL ok = GetFileInformationByHandle(h, &info[i]);
+		CloseHandle(h);
+		if(!ok)
+			return false;
+	}
+
+	return info[0].dwVolumeSerialNumber == info[1].dwVolumeSerialNumber
+		&& info[0].nFileIndexHigh == info[1].nFileIndexHigh
+		&& info[0].nFileIndexLow == info[1].nFileIndexLow;
+#else
+	struct stat st1;
+	struct stat st2;
+	if(stat(oPath1.c_str(), &st1) != 0 || stat(oPath2.c_str(), &st2) != 0)
+		return false;
+
+	return st1.st_dev == st2.st_dev && st1.st_ino == st2.st_ino;
+#endif
+}
+
 FileFactory::FileFactory(void)
+: mMappingThreshold(DEFAULT_MAPPING_THRESHOLD)
 {
 }
 
@@ -112,6 +181,10 @@ IFile *FileFactory::createFileInstance(Filename const &oFilename, FileType oFile
 
 	switch(oFileType)
 	{
+		case FileFactory::FF_DIRECT:
+			fl = new HandleFile(oFilename);
+		break;
+
 		case FileFactory::FF_FILE:
 			fl = new File(oFilename);
 		break;
@@ -123,6 +196,14 @@ IFile *FileFactory::createFileInstance(Filename const &oFilename, FileType oFile
 		case FileFactory::FF_ZIP:
 			fl = new ZipFile(oFilename);
 		break;
+
+		case FileFactory::FF_MMAP:
+			fl = new MappedFile(oFilename);
+		break;
+
+		case FileFactory::FF_UNBUFFERED:
+			fl = new DirectFile(oFilename);
+		break;
 	}
 
 	return fl;
@@ -139,8 +220,17 @@ IFile *FileFactory::getFile(Filename const &oFilename, FileType oFileType, FileT
 		type = oFileType;
 
 	if (type == FileFactory::FF_UNKNOWN)
+	{
 		type = oDefault;
 
+		if(type == FileFactory::FF_FILE && mMappingThreshold != invalid64_t)
+		{
+			int64_t size = regularFileSize(fn.getOpenpath());
+			if(size != invalid64_t && size >= mMappingThreshold)
+				type = FileFactory::FF_MMAP;
+		}
+	}
+
 	fl = createFileInstance(fn, type);
 
 	return fl;
@@ -162,6 +252,167 @@ IFile *FileFactory::openFile(Filename const &oFilename, IFile::open_mode const &
 	return fl;
 }
 
+int64_t FileFactory::copy(Filename const &oSource, Filename const &oTarget) const
+{
+	FileFactory::FileType sourceType;
+	FileFactory::FileType targetType;
+	Filename source = detectFileType(oSource, sourceType);
+	Filename target = detectFileType(oTarget, targetType);
+
+	// The target is truncated before the source is read.
+	if(isSameFile(source.getOpenpath(), target.getOpenpath()))
+		return invalid64_t;
+
+	if(sourceType == FileFactory::FF_UNKNOWN && targetType == FileFactory::FF_UNKNOWN && regularFileSize(source.getOpenpath()) != invalid64_t)
+		return copyPlain(source.getOpenpath(), target.getOpenpath());
+
+	return copyStream(oSource, oTarget);
+}
+
+int64_t FileFactory::copyPlain(string const &oSource, string const &oTarget) const
+{
+	IFile::open_mode md = IFile::open_mode::init();
+	md.binary = true;
+	md.read = true;
+	md.sequential = true;
+
+	sysio::handle_t source = sysio::openFile(oSource, md);
+	if(source == sysio::invalid_handle)
+		return invalid64_t;
+
+	md = IFile::open_mode::init();
+	md.binary = true;
+	md.write = true;
+	md.create = true;
+	md.truncate = true;
+	md.sequential = true;
+
+	sysio::handle_t target = sysio::openFile(oTarget, md);
+	if(target == sysio::invalid_handle)
+	{
+		sysio::closeFile(source);
+		return invalid64_t;
+	}
+
+	int64_t size = sysio::fileSize(source);
+	bool ok = (size != invalid64_t);
+	if(ok && !sysio::cloneFile(source, target))
+	{
+		BufferPool &pool = BufferPool::getDefault();
+		char *buffer = NULL;
+		bool kernel = true;
+		int64_t pos = 0;
+		int64_t begin;
+		int64_t end;
+
+		// Only the data is copied. The holes are created by writing behind them, and
+		// by the final truncate for a hole at the end.
+		while(ok && pos < size && sysio::findData(source, pos, begin, end))
+		{
+			end = min(end, size);
+			while(begin < end)
+			{
+				int64_t n = invalid64_t;
+				if(kernel)
+				{
+					n = sysio::copyRange(source, begin, target, begin, end - begin);
+					if(n == invalid64_t)
+						kernel = false;
+				}
+
+				if(!kernel)
+				{
+					if(!buffer)
+						buffer = pool.allocate((size_t)COPY_BUFFER_SIZE);
+
+					n = sysio::readAt(source, begin, buffer, min(end - begin, COPY_BUFFER_SIZE));
+					if(n > 0 && sysio::writeAt(target, begin, buffer, n) != n)
+						n = invalid64_t;
+				}
+
+				if(n == invalid64_t)
+				{
+					ok = false;
+					break;
+				}
+
+				// The source was truncated meanwhile.
+				if(n == 0)
+					break;
+
+				begin += n;
+			}
+
+			pos = end;
+		}
+
+		if(buffer)
+			pool.release(buffer, (size_t)COPY_BUFFER_SIZE);
+
+		if(ok)
+			ok = sysio::truncateFile(target, size);
+	}
+
+	sysio::closeFile(target);
+	sysio::closeFile(source);
+
+	return (ok) ? size : invalid64_t;
+}
+
+int64_t FileFactory::copyStream(Filename const &oSource, Filename const &oTarget) const
+{
+	IFile::open_mode md = IFile::open_mode::init();
+	md.binary = true;
+	md.read = true;
+	md.sequential = true;
+
+	IFile *source = openFile(oSource, md);
+	if(!source)
+		return invalid64_t;
+
+	md = IFile::open_mode::init();
+	md.binary = true;
+	md.write = true;
+	md.create = true;
+	md.truncate = true;
+	md.sequential = true;
+
+	IFile *target = openFile(oTarget, md);
+	if(!target)
+	{
+		source->close();
+		delete source;
+		return invalid64_t;
+	}
+
+	BufferPool &pool = BufferPool::getDefault();
+	char *buffer = pool.allocate((size_t)COPY_BUFFER_SIZE);
+	int64_t total = 0;
+	int64_t rd;
+
+	while((rd = source->read(buffer, COPY_BUFFER_SIZE)) > 0)
+	{
+		if(target->write(buffer, rd) != rd)
+		{
+			rd = invalid64_t;
+			break;
+		}
+
+		total += rd;
+	}
+
+	pool.release(buffer, (size_t)COPY_BUFFER_SIZE);
+	if(rd < 0)
+		total = invalid64_t;
+
+	target->close();
+	source->close();
+	delete target;
+	delete source;
+
+	return total;
+}
+
 FilenameScanner *FileFactory::getScanner(Filename const &oFilename, bool bIncludeSubdirectories) const
 {
 	FileFactory::FileType type;
@@ -188,6 +439,8 @@ FilenameScanner *FileFactory::getScanner(Filename const &oFilename, bool bInclud
 	{
 		case FileFactory::FF_DIRECT:
 		case FileFactory::FF_FILE:
+		case FileFactory::FF_MMAP:
+		case FileFactory::FF_UNBUFFERED:
 			sc = new FilesystemScanner(archive, bIncludeSubdirectories);
 		break;
 
@@ -1,4 +1,8 @@
+#ifdef _WIN32
 #include <Windows.h>
+#else
+#include <unistd.h>
+#endif
 
 #include <algorithm>
 #include <string>
@@ -89,7 +93,7 @@ string Filename::getBaseDir(void) const
 	if(l == 0)
 		return mBasePath;
 
-	if(mBasePath[l-1] == '\\')
+	if(mBasePath[l-1] == mDelimiter)
 		return mBasePath.substr(0, l-1);
 
 	return mBasePath;
@@ -129,6 +133,7 @@ string Filename::findDrive(const string &oPath) const
 
 	size_t len = oPath.size();
 	char c = static_cast<char>(toupper(oPath[0]));
+#ifdef _WIN32
 	if(c >= 'A' && c <= 'Z')
 	{
 		drive += c;
@@ -137,6 +142,10 @@ string Filename::findDrive(const string &oPath) const
 
 		return drive;
 	}
+#else
+	if(c == '/')					// There are no drives, everything is below the root.
+		return "/";
+#endif
 	else if(c == '\\')
 	{
 		if(len > 0 && oPath[1] == '\\')		// UNC path is ok == Path starts with '\\'
@@ -183,8 +192,13 @@ string Filename::findDrive(const string &oPath) const
 		if(drive.size() == 0)
 		{
 			char path[4096];
+#ifdef _WIN32
 			if(GetCurrentDirectory(sizeof(path), path) != 0)
 				return findDrive(path);
+#else
+			if(getcwd(path, sizeof(path)) != NULL)
+				return findDrive(path);
+#endif
 		}
 	}
 
@@ -205,7 +219,7 @@ string Filename::getExtension(bool bCase, bool bUppercase) const
 		if(c == '.')
 			break;
 
-		if(c == '\\')
+		if(c == mDelimiter)
 			return "";
 
 		l--;
@@ -237,7 +251,7 @@ string Filename::getFileDir(void) const
 
 	while(--l)
 	{
-		if(d[l] == '\\')
+		if(d[l] == mDelimiter)
 			break;
 	}
 	return d.substr(0, l+1);
@@ -1,4 +1,9 @@
+#ifdef _WIN32
 #include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
 
 #include <iostream>
 
@@ -30,13 +35,13 @@ vector<string> FilenameScanner::scan(void)
 // ******************************************************************************
 FilesystemScanner::FilesystemScanner(Filename const &oRoot, bool bIncludeSubdirectories)
 	: super(oRoot, bIncludeSubdirectories)
+	, mRoot(oRoot)
+	, mIncludeSubdirectories(bIncludeSubdirectories)
 {
 }
 
 FilenameScanner::ScanState FilesystemScanner::scan(Filename const &oRoot)
 {
-	HANDLE hFind;
-	WIN32_FIND_DATA fd;
 	Filename root = oRoot;
 	root.normalize();
 	string dir = root.getBasePath();
@@ -45,6 +50,10 @@ FilenameScanner::ScanState FilesystemScanner::scan(Filename const &oRoot)
 	if(root.getFilename() == "")
 		root.setFilename("*");
 
+#ifdef _WIN32
+	HANDLE hFind;
+	WIN32_FIND_DATA fd;
+
 	if((hFind = FindFirstFile((dir+"*").c_str(), &fd)) != INVALID_HANDLE_VALUE)
 	{
 		do
@@ -74,6 +83,39 @@ FilenameScanner::ScanState FilesystemScanner::scan(Filename const &oRoot)
 
 		FindClose(hFind);
 	}
+#else
+	DIR *d = opendir((dir.empty()) ? "." : dir.c_str());
+	if(d)
+	{
+		struct dirent *entry;
+		while(state != SS_ABORT && (entry = readdir(d)) != NULL)
+		{
+			state = SS_OK;
+
+			// If the path is '.' or '..' we ignore it.
+			string const p = entry->d_name;
+			if(p == "." || p == "..")
+				continue;
+
+			bool isDir = (entry->d_type == DT_DIR);
+			if(entry->d_type == DT_UNKNOWN)
+			{
+				struct stat st;
+				isDir = stat((dir+p).c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+			}
+
+			if(isDir && includeSubdirectories())// If it is a directory we have to enter it on request
+				state = scan(dir + p + root.getDelimiter() + root.getFilename());
+			else
+			{
+				if(Filename::matchesWildcard(Pattern().c_str(), p.c_str(), p.c_str()+p.size(), false, false))
+					Files().push_back(dir+p);
+			}
+		}
+
+		closedir(d);
+	}
+#endif
 
 	return state;
 }
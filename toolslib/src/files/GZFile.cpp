@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <gzguts.h>
 
@@ -9,6 +10,8 @@ namespace toolslib
 namespace files
 {
 
+using namespace std;
+
 // *******************************************************************
 bool GZFile::isHeader(const char *pBuffer, size_t nBufferLen)
 {
@@ -35,16 +38,38 @@ GZFile::~GZFile(void)
 	close();
 }
 
+uint64_t GZFile::proposeFileBufferSize(void)
+{
+	return super::proposeFileBufferSize(getOpenpath(), true);
+}
+
+char *GZFile::allocateFileBuffer(int64_t nSize)
+{
+	UNUSED(nSize);
+
+	return NULL;
+}
+
 bool GZFile::open(void)
 {
 	mFilePos = -1;
 	super::open();
-	if ((mFileHandle = gzopen(getOpenpath().c_str(), getFileOpenmode().c_str())) == NULL)
+
+	// A gzip stream is either read or written, and "w" truncates anyway, so zlib
+	// rejects the '+' for truncate.
+	string md = getFileOpenmode();
+	md.erase(remove(md.begin(), md.end(), '+'), md.end());
+
+	if ((mFileHandle = gzopen(getOpenpath().c_str(), md.c_str())) == NULL)
 	{
 		setIsOpen(false);
 		return false;
 	}
 
+	// Must be set before the first read or write. The default of zlib is only 8 KB.
+	uint64_t size = min<uint64_t>(getFileBufferSize(), UINT_MAX);
+	gzbuffer(mFileHandle, (unsigned)size);
+
 	mFilePos = 0;
 	setIsOpen(true);
 
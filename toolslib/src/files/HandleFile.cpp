@@ -0,0 +1,477 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "toolslib/files/HandleFile.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+using namespace std;
+
+HandleFile::HandleFile(Filename const &oFilename)
+	: super(oFilename)
+{
+	mWriteError = false;
+	init();
+}
+
+HandleFile::~HandleFile(void)
+{
+	close();
+}
+
+void HandleFile::init(void)
+{
+	mFileHandle = sysio::invalid_handle;
+	mFilePos = invalid64_t;
+	mBufferPos = 0;
+	mBufferFill = 0;
+	mBufferDirty = false;
+}
+
+bool HandleFile::open(void)
+{
+	// The buffer is sized from the handle, once it is open.
+	beginOpen(false);
+	mWriteError = false;
+
+	IFile::open_mode md = getOpenmode();
+	mFileHandle = sysio::openFile(getOpenpath(), md);
+	if(mFileHandle == sysio::invalid_handle)
+	{
+		setIsOpen(false);
+		return false;
+	}
+
+	allocateFileBuffer(updateFileBufferSize());
+
+	mFilePos = 0;
+	if(md.append)
+		mFilePos = sysio::fileSize(mFileHandle);
+
+	setIsOpen(true);
+	return true;
+}
+
+void HandleFile::close(void)
+{
+	super::close();
+
+	// Drops what the reads left behind, and what was written in the meantime.
+	if(mFileHandle != sysio::invalid_handle && getOpenmode().dontneed)
+		sysio::dropCache(mFileHandle, 0, 0);
+
+	sysio::closeFile(mFileHandle);
+	init();
+}
+
+void HandleFile::flush(void)
+{
+	flushBuffer();
+}
+
+bool HandleFile::flushBuffer(void)
+{
+	if(!mBufferDirty)
+		return true;
+
+	char *buffer = getFileBuffer();
+	int64_t wr = sysio::writeAt(mFileHandle, mBufferPos, buffer, mBufferFill);
+	if(wr != mBufferFill)
+	{
+		// Whatever didn't make it stays pending, so it is not silently lost.
+		if(wr > 0)
+		{
+			memmove(buffer, &buffer[wr], (size_t)(mBufferFill - wr));
+			mBufferPos += wr;
+			mBufferFill -= wr;
+		}
+
+		mWriteError = true;
+		return false;
+	}
+
+	mBufferDirty = false;
+	mBufferFill = 0;
+
+	return true;
+}
+
+int64_t HandleFile::fillBuffer(void)
+{
+	int64_t rd = sysio::readAt(mFileHandle, mFilePos, getFileBuffer(), (int64_t)getFileBufferSize());
+
+	mBufferPos = mFilePos;
+	mBufferFill = (rd > 0) ? rd : 0;
+
+	// The data is in our buffer now, so the cache doesn't need it anymore.
+	if(mBufferFill && getOpenmode().dontneed)
+		sysio::dropCache(mFileHandle, mBufferPos, mBufferFill);
+
+	return rd;
+}
+
+int64_t HandleFile::read(void *oBuffer, int64_t nLen)
+{
+	if(mFileHandle == sysio::invalid_handle || oBuffer == NULL)
+		return invalid64_t;
+
+	if(!flushBuffer())
+		return invalid64_t;
+
+	char *p = static_cast<char *>(oBuffer);
+	char *buffer = getFileBuffer();
+	int64_t bufferSize = (int64_t)getFileBufferSize();
+	int64_t total = 0;
+
+	setEOF(false);
+	while(total < nLen)
+	{
+		int64_t avail = mBufferPos + mBufferFill - mFilePos;
+		if(mFilePos >= mBufferPos && avail > 0)
+		{
+			int64_t n = min(avail, nLen - total);
+			memcpy(&p[total], &buffer[mFilePos - mBufferPos], (size_t)n);
+			total += n;
+			mFilePos += n;
+			continue;
+		}
+
+		// Large reads go directly to the caller, there is no point in copying them twice.
+		int64_t remaining = nLen - total;
+		if(remaining >= bufferSize)
+		{
+			int64_t rd = sysio::readAt(mFileHandle, mFilePos, &p[total], remaining);
+			if(rd < 0)
+				return (total) ? total : invalid64_t;
+
+			if(rd > 0 && getOpenmode().dontneed)
+				sysio::dropCache(mFileHandle, mFilePos, rd);
+
+			total += rd;
+			mFilePos += rd;
+			if(rd < remaining)
+				setEOF();
+
+			break;
+		}
+
+		int64_t rd = fillBuffer();
+		if(rd <= 0)
+		{
+			if(rd < 0 && !total)
+				return invalid64_t;
+
+			setEOF();
+			break;
+		}
+	}
+
+	return total;
+}
+
+int64_t HandleFile::write(void const *oBuffer, int64_t nLen)
+{
+	if(mFileHandle == sysio::invalid_handle || oBuffer == NULL)
+		return invalid64_t;
+
+	IFile::open_mode md = getOpenmode();
+	if(!md.write)
+		return invalid64_t;
+
+	if(md.append)
+		mFilePos = length();
+
+	// A write which doesn't continue the pending data, starts a new block.
+	if(mBufferDirty && mFilePos != mBufferPos + mBufferFill)
+	{
+		if(!flushBuffer())
+			return invalid64_t;
+	}
+
+	// Data from previous reads may be stale now.
+	if(!mBufferDirty)
+	{
+		mBufferPos = mFilePos;
+		mBufferFill = 0;
+	}
+
+	int64_t bufferSize = (int64_t)getFileBufferSize();
+	if(mBufferFill + nLen > bufferSize)
+	{
+		if(!flushBuffer())
+			return invalid64_t;
+
+		if(nLen >= bufferSize)
+		{
+			int64_t wr = sysio::writeAt(mFileHandle, mFilePos, oBuffer, nLen);
+			if(wr < 0)
+				return invalid64_t;
+
+			mFilePos += wr;
+			return wr;
+		}
+
+		mBufferPos = mFilePos;
+	}
+
+	memcpy(&getFileBuffer()[mBufferFill], oBuffer, (size_t)nLen);
+	mBufferFill += nLen;
+	mBufferDirty = true;
+	mFilePos += nLen;
+
+	return nLen;
+}
+
+int64_t HandleFile::seek(int64_t nOffset, IFile::seek_pos nPos)
+{
+	if(mFileHandle == sysio::invalid_handle)
+		return invalid64_t;
+
+	int64_t pos = invalid64_t;
+	switch(nPos)
+	{
+		case IFile::cur:
+			pos = mFilePos + nOffset;
+		break;
+
+		case IFile::set:
+			pos = nOffset;
+		break;
+
+		case IFile::end:
+			pos = length() - nOffset;
+		break;
+	}
+
+	if(pos < 0)
+		return invalid64_t;
+
+	mFilePos = pos;
+	setEOF(false);
+
+	return mFilePos;
+}
+
+int64_t HandleFile::tell(void)
+{
+	if(mFileHandle == sysio::invalid_handle)
+		return invalid64_t;
+
+	return mFilePos;
+}
+
+int64_t HandleFile::length(void)
+{
+	if(mFileHandle == sysio::invalid_handle)
+		return invalid64_t;
+
+	int64_t size = sysio::fileSize(mFileHandle);
+	if(mBufferDirty && size != invalid64_t)
+		size = max(size, mBufferPos + mBufferFill);
+
+	return size;
+}
+
+int64_t HandleFile::readAt(int64_t nOffset, void *oBuffer, int64_t nLen)
+{
+	if(mFileHandle == sysio::invalid_handle || oBuffer == NULL || nOffset < 0)
+		return invalid64_t;
+
+	// Pending writes in the range have to be in the file first.
+	{
+		lock_guard<mutex> lock(mBufferLock);
+		if(mBufferDirty && isBuffered(nOffset, nLen) && !flushBuffer())
+			return invalid64_t;
+	}
+
+	return sysio::readAt(mFileHandle, nOffset, oBuffer, nLen);
+}
+
+int64_t HandleFile::writeAt(int64_t nOffset, void const *oBuffer, int64_t nLen)
+{
+	if(mFileHandle == sysio::invalid_handle || oBuffer == NULL || nOffset < 0 || !getOpenmode().write)
+		return invalid64_t;
+
+	// The buffer must neither return the old data, nor overwrite the new data when
+	// it is flushed later.
+	{
+		lock_guard<mutex> lock(mBufferLock);
+		if(isBuffered(nOffset, nLen))
+		{
+			if(!flushBuffer())
+				return invalid64_t;
+
+			mBufferFill = 0;
+		}
+	}
+
+	return sysio::writeAt(mFileHandle, nOffset, oBuffer, nLen);
+}
+
+int64_t HandleFile::readv(buffer_span const *oSpans, size_t nCount)
+{
+	if(mFileHandle == sysio::invalid_handle)
+		return invalid64_t;
+
+	int64_t remaining = 0;
+	for(size_t i = 0; i < nCount; i++)
+		remaining += oSpans[i].Length;
+
+	int64_t bufferSize = (int64_t)getFileBufferSize();
+	int64_t total = 0;
+	for(size_t i = 0; i < nCount; i++)
+	{
+		// As soon as the buffer is drained and the rest doesn't fit into it, all
+		// remaining buffers are read with a single call.
+		int64_t buffered = mBufferPos + mBufferFill - mFilePos;
+		bool drained = mFilePos < mBufferPos || buffered <= 0;
+		if(!mBufferDirty && drained && remaining >= bufferSize)
+		{
+			int64_t rd = sysio::readAt(mFileHandle, mFilePos, &oSpans[i], nCount - i);
+			if(rd < 0)
+				return (total) ? total : invalid64_t;
+
+			total += rd;
+			mFilePos += rd;
+			setEOF(rd < remaining);
+			break;
+		}
+
+		int64_t rd = HandleFile::read(oSpans[i].Data, oSpans[i].Length);
+		if(rd < 0)
+			return (total) ? total : invalid64_t;
+
+		total += rd;
+		remaining -= rd;
+		if(rd < oSpans[i].Length)
+			break;
+	}
+
+	return total;
+}
+
+int64_t HandleFile::writev(const_buffer_span const *oSpans, size_t nCount)
+{
+	if(mFileHandle == sysio::invalid_handle)
+		return invalid64_t;
+
+	IFile::open_mode md = getOpenmode();
+	if(!md.write)
+		return invalid64_t;
+
+	int64_t size = 0;
+	for(size_t i = 0; i < nCount; i++)
+		size += oSpans[i].Length;
+
+	// Small records are collected in the buffer, just like single writes.
+	if(size < (int64_t)getFileBufferSize())
+		return BaseFile::writev(oSpans, nCount);
+
+	if(md.append)
+		mFilePos = length();
+
+	// The pending data and all buffers go out with a single call.
+	vector<const_buffer_span> spans;
+	spans.reserve(nCount + 1);
+
+	int64_t pos = mFilePos;
+	int64_t pending = 0;
+	if(mBufferDirty && mBufferPos + mBufferFill == mFilePos)
+	{
+		pending = mBufferFill;
+		pos = mBufferPos;
+		spans.push_back({ getFileBuffer(), pending });
+	}
+	else if(!flushBuffer())
+		return invalid64_t;
+
+	spans.insert(spans.end(), oSpans, oSpans + nCount);
+
+	int64_t wr = sysio::writeAt(mFileHandle, pos, &spans[0], spans.size());
+	if(wr < pending)
+	{
+		// Keep what is left of the pending data, like flushBuffer() does.
+		if(wr > 0)
+		{
+			char *buffer = getFileBuffer();
+			memmove(buffer, &buffer[wr], (size_t)(pending - wr));
+			mBufferPos += wr;
+			mBufferFill -= wr;
+		}
+
+		mWriteError = true;
+		return invalid64_t;
+	}
+
+	mBufferDirty = false;
+	mBufferFill = 0;
+
+	wr -= pending;
+	mFilePos += wr;
+
+	return wr;
+}
+
+const char *HandleFile::peek(int64_t nMinBytes, int64_t &nAvailable)
+{
+	nAvailable = 0;
+	if(mFileHandle == sysio::invalid_handle || !flushBuffer())
+		return NULL;
+
+	// Refill if the buffer doesn't hold enough. More than the buffersize can never
+	// be provided, so the client gets as much as fits.
+	int64_t avail = mBufferPos + mBufferFill - mFilePos;
+	if(mFilePos < mBufferPos || avail <= 0 || avail < min(nMinBytes, (int64_t)getFileBufferSize()))
+	{
+		if(fillBuffer() <= 0)
+			return NULL;
+
+		avail = mBufferFill;
+	}
+
+	nAvailable = avail;
+
+	return &getFileBuffer()[mFilePos - mBufferPos];
+}
+
+int64_t HandleFile::consume(int64_t nBytes)
+{
+	if(mFileHandle == sysio::invalid_handle)
+		return invalid64_t;
+
+	// Beyond the buffer we have to check against the end of the file.
+	int64_t avail = mBufferPos + mBufferFill - mFilePos;
+	if(mFilePos < mBufferPos || nBytes > avail)
+		avail = max((int64_t)0, length() - mFilePos);
+
+	nBytes = min(nBytes, avail);
+	mFilePos += nBytes;
+	setEOF(false);
+
+	return nBytes;
+}
+
+int HandleFile::getChar(void)
+{
+	int64_t offset = mFilePos - mBufferPos;
+	if(!mBufferDirty && offset >= 0 && offset < mBufferFill)
+	{
+		mFilePos++;
+		return (unsigned char)getFileBuffer()[offset];
+	}
+
+	unsigned char c;
+	if(read(&c, 1) != 1)
+		return EOF;
+
+	return c;
+}
+
+}
+
+}
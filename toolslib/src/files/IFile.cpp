@@ -22,24 +22,40 @@ size_t IFile::printf(const char *oFormat, ...)
 	char buffer[4096];
 	char *p = buffer;
 	va_list   ap;
+	va_list   retry;
 	va_start(ap, oFormat);
+	va_copy(retry, ap);
 
-	size_t len = vsnprintf(p, sizeof(buffer)-1, oFormat, ap);
-	if(len == -1)
+	// If it doesn't fit, the length is returned, only older runtimes return -1.
+	int len = vsnprintf(p, sizeof(buffer), oFormat, ap);
+#ifdef _WIN32
+	if(len < 0)
+	{
+		va_list count;
+		va_copy(count, retry);
+		len = _vscprintf(oFormat, count);
+		va_end(count);
+	}
+#endif
+
+	if(len >= (int)sizeof(buffer))
 	{
-		len = _vscprintf(oFormat, ap);
 		p = new char[len+1];
-		vsnprintf(p, len, oFormat, ap);
+		vsnprintf(p, len+1, oFormat, retry);
 	}
 
+	va_end(retry);
 	va_end(ap);
 
-	len = (size_t)write(p, len);
+	if(len < 0)
+		return 0;
+
+	size_t wr = (size_t)write(p, len);
 
 	if(p != buffer)
 		delete [] p;
 
-	return len;
+	return wr;
 }
 
 }
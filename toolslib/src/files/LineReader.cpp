@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <cstring>
+
+#include "toolslib/files/LineReader.h"
+#include "toolslib/utils/CPUFeatures.h"
+
+#ifdef TOOLSLIB_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace toolslib
+{
+
+namespace files
+{
+
+using namespace std;
+using namespace toolslib::utils;
+
+const size_t LineReader::default_buffer_size;
+
+namespace
+{
+
+typedef const char *(*find_newline_t)(const char *p, const char *pEnd);
+
+const char *findNewlineScalar(const char *p, const char *pEnd)
+{
+	return static_cast<const char *>(memchr(p, '\n', (size_t)(pEnd - p)));
+}
+
+#ifdef TOOLSLIB_X86
+
+inline uint32_t lowestBit(uint32_t nMask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, nMask);
+	return index;
+#else
+	return (uint32_t)__builtin_ctz(nMask);
+#endif
+}
+
+const char *findNewlineSSE2(const char *p, const char *pEnd)
+{
+	const __m128i nl = _mm_set1_epi8('\n');
+
+	while (pEnd - p >= 16)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+		if (mask)
+			return p + lowestBit(mask);
+
+		p += 16;
+	}
+
+	return findNewlineScalar(p, pEnd);
+}
+
+TARGET_AVX2 const char *findNewlineAVX2(const char *p, const char *pEnd)
+{
+	const __m256i nl = _mm256_set1_epi8('\n');
+
+	// Two vectors per iteration, so long lines are scanned at full load bandwidth.
+	while (pEnd - p >= 64)
+	{
+		__m256i v0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+		__m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32));
+		__m256i c0 = _mm256_cmpeq_epi8(v0, nl);
+		__m256i c1 = _mm256_cmpeq_epi8(v1, nl);
+		if (!_mm256_testz_si256(_mm256_or_si256(c0, c1), _mm256_or_si256(c0, c1)))
+		{
+			uint32_t mask = (uint32_t)_mm256_movemask_epi8(c0);
+			if (mask)
+				return p + lowestBit(mask);
+
+			return p + 32 + lowestBit((uint32_t)_mm256_movemask_epi8(c1));
+		}
+
+		p += 64;
+	}
+
+	while (pEnd - p >= 32)
+	{
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+		uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+		if (mask)
+			return p + lowestBit(mask);
+
+		p += 32;
+	}
+
+	return findNewlineSSE2(p, pEnd);
+}
+
+#endif // TOOLSLIB_X86
+
+find_newline_t selectFindNewline(void)
+{
+#ifdef TOOLSLIB_X86
+	CPUFeatures const &cpu = CPUFeatures::get();
+	if (cpu.hasAVX2())
+		return findNewlineAVX2;
+
+	if (cpu.hasSSE2())
+		return findNewlineSSE2;
+#endif
+
+	return findNewlineScalar;
+}
+
+const find_newline_t findNewline = selectFindNewline();
+
+}
+
+LineReader::LineReader(IFile &oFile, bool bStripCR, size_t nBufferSize)
+: mFile(oFile)
+, mBuffer(max(nBufferSize, (size_t)64))
+, mCur(NULL)
+, mEnd(NULL)
+, mViewLength(0)
+, mLineNumber(0)
+, mUseViews(false)
+, mViewsChecked(false)
+, mEOF(false)
+, mStripCR(bStripCR)
+{
+}
+
+LineReader::~LineReader(void)
+{
+}
+
+bool LineReader::makeLine(const char *pLine, size_t nLength, string_view &oLine)
+{
+	if (mStripCR && nLength && pLine[nLength - 1] == '\r')
+		nLength--;
+
+	oLine = string_view(pLine, nLength);
+	mLineNumber++;
+
+	return true;
+}
+
+bool LineReader::readLine(string_view &oLine)
+{
+	mCarry.clear();
+
+	const char *scan = mCur;
+	while (!mEOF)
+	{
+		const char *nl = (scan < mEnd) ? findNewline(scan, mEnd) : NULL;
+		if (nl)
+		{
+			const char *line = mCur;
+			mCur = nl + 1;
+
+			if (mCarry.empty())
+				return makeLine(line, nl - line, oLine);
+
+			mCarry.insert(mCarry.end(), line, nl);
+			return makeLine(&mCarry[0], mCarry.size(), oLine);
+		}
+
+		// Only the new data has to be searched after the refill.
+		size_t scanned = mEnd - mCur;
+		if (!refill())
+		{
+			mEOF = true;
+			break;
+		}
+
+		scan = (mUseViews) ? mCur : mCur + scanned;
+	}
+
+	// The last line may not be terminated.
+	if (!mCarry.empty())
+		return makeLine(&mCarry[0], mCarry.size(), oLine);
+
+	if (mCur < mEnd)
+	{
+		const char *line = mCur;
+		mCur = mEnd;
+		return makeLine(line, mEnd - line, oLine);
+	}
+
+	return false;
+}
+
+bool LineReader::refill(void)
+{
+	if (!mViewsChecked)
+	{
+		mViewsChecked = true;
+
+		int64_t avail;
+		const char *view = mFile.peek(1, avail);
+		if (view)
+		{
+			mUseViews = true;
+			mCur = view;
+			mEnd = view + avail;
+			mViewLength = avail;
+			return true;
+		}
+	}
+
+	if (mUseViews)
+	{
+		mCarry.insert(mCarry.end(), mCur, mEnd);
+		mFile.consume(mViewLength);
+
+		int64_t avail;
+		const char *view = mFile.peek(1, avail);
+		mViewLength = (view) ? avail : 0;
+		mCur = view;
+		mEnd = (view) ? view + avail : view;
+
+		return view != NULL;
+	}
+
+	// Move the unfinished line to the front, and grow the buffer if it is completely filled by it.
+	size_t partial = mEnd - mCur;
+	if (partial)
+		memmove(&mBuffer[0], mCur, partial);
+
+	if (partial == mBuffer.size())
+		mBuffer.resize(mBuffer.size() * 2);
+
+	int64_t rd = mFile.read(&mBuffer[partial], mBuffer.size() - partial);
+	mCur = &mBuffer[0];
+	mEnd = mCur + partial;
+	if (rd <= 0)
+		return false;
+
+	mEnd += rd;
+
+	return true;
+}
+
+}
+
+}
@@ -0,0 +1,457 @@
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+
+#include "toolslib/files/MappedFile.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+using namespace std;
+
+// Growing a writeable mapping is expensive, so we never grow by less than this.
+static const int64_t MAPPING_GROWTH = 1024*1024;
+
+MappedFile::MappedFile(Filename const &oFilename)
+	: super(oFilename)
+{
+	init();
+}
+
+MappedFile::~MappedFile(void)
+{
+	close();
+}
+
+void MappedFile::init(void)
+{
+	mFileHandle = sysio::invalid_handle;
+#ifdef _WIN32
+	mMappingHandle = NULL;
+#endif
+	mMapping = NULL;
+	mMappedLength = 0;
+	mFileLength = 0;
+	mFilePos = invalid64_t;
+}
+
+char *MappedFile::allocateFileBuffer(int64_t nSize)
+{
+	UNUSED(nSize);
+
+	return NULL;
+}
+
+void MappedFile::freeFileBuffer(char *oFileBuffer)
+{
+	UNUSED(oFileBuffer);
+}
+
+char *MappedFile::getFileBuffer(void) const
+{
+	return mMapping;
+}
+
+uint64_t MappedFile::getFileBufferSize(void) const
+{
+	if(mMapping)
+		return (uint64_t)mFileLength;
+
+	return super::getFileBufferSize();
+}
+
+sysio::handle_t MappedFile::getNativeHandle(void) const
+{
+	if(getOpenmode().write)
+		return sysio::invalid_handle;
+
+	return mFileHandle;
+}
+
+bool MappedFile::open(void)
+{
+	super::open();
+
+	// A mapping always needs read access, even if the file is only written.
+	IFile::open_mode md = getOpenmode();
+	IFile::open_mode access = md;
+	access.read = true;
+
+	mFileHandle = sysio::openFile(getOpenpath(), access);
+	if(mFileHandle == sysio::invalid_handle)
+	{
+		close();
+		return false;
+	}
+
+	mFileLength = sysio::fileSize(mFileHandle);
+	if(mFileLength == invalid64_t || !map(mFileLength))
+	{
+		mFileLength = 0;
+		close();
+		return false;
+	}
+
+	mFilePos = (md.append) ? mFileLength : 0;
+	setIsOpen(true);
+
+	return true;
+}
+
+void MappedFile::close(void)
+{
+	// The mapping may have been grown beyond the data written, so we cut it back.
+	bool shrink = getOpenmode().write && mMappedLength > mFileLength;
+
+	super::close();
+	unmap();
+
+	if(mFileHandle != sysio::invalid_handle)
+	{
+		if(shrink && !sysio::truncateFile(mFileHandle, mFileLength))
+			setEOF();
+
+		if(getOpenmode().dontneed)
+			sysio::dropCache(mFileHandle, 0, 0);
+
+		sysio::closeFile(mFileHandle);
+	}
+
+	init();
+}
+
+bool MappedFile::map(int64_t nLength)
+{
+	bool writeable = getOpenmode().write;
+
+	unmap();
+
+	// An empty file can not be mapped, but this is not an error.
+	if(nLength == 0)
+		return true;
+
+#ifdef _WIN32
+	// For a writeable file, CreateFileMapping() extends the file to the requested size.
+	DWORD protect = (writeable) ? PAGE_READWRITE : PAGE_READONLY;
+	mMappingHandle = CreateFileMappingA((HANDLE)mFileHandle, NULL, protect, (DWORD)(nLength >> 32), (DWORD)(nLength & 0xffffffff), NULL);
+	if(mMappingHandle == NULL)
+		return false;
+
+	mMapping = (char *)MapViewOfFile(mMappingHandle, (writeable) ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, (SIZE_T)nLength);
+	if(mMapping == NULL)
+	{
+		CloseHandle(mMappingHandle);
+		mMappingHandle = NULL;
+		return false;
+	}
+
+#if _WIN32_WINNT >= 0x0602
+	if(getOpenmode().willneed)
+	{
+		WIN32_MEMORY_RANGE_ENTRY range = { mMapping, (SIZE_T)nLength };
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+	}
+#endif
+#else
+	if(writeable && nLength > mFileLength)
+	{
+		if(!sysio::truncateFile(mFileHandle, nLength))
+			return false;
+	}
+
+	int prot = PROT_READ;
+	if(writeable)
+		prot |= PROT_WRITE;
+
+	void *p = mmap(NULL, (size_t)nLength, prot, MAP_SHARED, (int)mFileHandle, 0);
+	if(p == MAP_FAILED)
+		return false;
+
+	mMapping = static_cast<char *>(p);
+
+	// The hints belong to the mapping, so a new mapping needs them again.
+	IFile::open_mode md = getOpenmode();
+	if(md.random)
+		madvise(p, (size_t)nLength, MADV_RANDOM);
+	else if(md.sequential || md.dontneed)
+		madvise(p, (size_t)nLength, MADV_SEQUENTIAL);
+
+	if(md.willneed)
+		madvise(p, (size_t)nLength, MADV_WILLNEED);
+#endif
+
+	mMappedLength = nLength;
+
+	return true;
+}
+
+void MappedFile::unmap(void)
+{
+#ifdef _WIN32
+	if(mMapping)
+		UnmapViewOfFile(mMapping);
+
+	if(mMappingHandle)
+		CloseHandle(mMappingHandle);
+
+	mMappingHandle = NULL;
+#else
+	if(mMapping)
+		munmap(mMapping, (size_t)mMappedLength);
+#endif
+
+	mMapping = NULL;
+	mMappedLength = 0;
+}
+
+void MappedFile::flush(void)
+{
+	if(!mMapping || !getOpenmode().write)
+		return;
+
+	// Only schedule the writeback, so flush() stays as cheap as fflush() is for File.
+#ifdef _WIN32
+	FlushViewOfFile(mMapping, (SIZE_T)mFileLength);
+#else
+	msync(mMapping, (size_t)mMappedLength, MS_ASYNC);
+#endif
+}
+
+int64_t MappedFile::read(void *oBuffer, int64_t nLen)
+{
+	if(!isOpen() || oBuffer == NULL)
+		return invalid64_t;
+
+	int64_t avail = mFileLength - mFilePos;
+	if(avail < 0)
+		avail = 0;
+
+	setEOF(false);
+	if(nLen > avail)
+	{
+		nLen = avail;
+		setEOF();
+	}
+
+	if(nLen > 0)
+	{
+		memcpy(oBuffer, &mMapping[mFilePos], (size_t)nLen);
+		mFilePos += nLen;
+	}
+
+	return nLen;
+}
+
+int64_t MappedFile::write(void const *oBuffer, int64_t nLen)
+{
+	if(!isOpen() || oBuffer == NULL)
+		return invalid64_t;
+
+	IFile::open_mode md = getOpenmode();
+	if(!md.write)
+		return invalid64_t;
+
+	if(md.append)
+		mFilePos = mFileLength;
+
+	int64_t end = mFilePos + nLen;
+	if(end > mMappedLength)
+	{
+		// Grow geometrically so that many small writes don't remap each time.
+		int64_t size = max(end, max(mMappedLength * 2, MAPPING_GROWTH));
+		if(!map(size))
+			return invalid64_t;
+	}
+
+	memcpy(&mMapping[mFilePos], oBuffer, (size_t)nLen);
+	mFilePos = end;
+	if(mFilePos > mFileLength)
+		mFileLength = mFilePos;
+
+	return nLen;
+}
+
+int64_t MappedFile::seek(int64_t nOffset, IFile::seek_pos nPos)
+{
+	if(!isOpen())
+		return invalid64_t;
+
+	int64_t pos = invalid64_t;
+	switch(nPos)
+	{
+		case IFile::cur:
+			pos = mFilePos + nOffset;
+		break;
+
+		case IFile::set:
+			pos = nOffset;
+		break;
+
+		case IFile::end:
+			pos = mFileLength - nOffset;
+		break;
+	}
+
+	// Positioning beyond the end is only allowed if the file can grow.
+	if(pos < 0 || (pos > mFileLength && !getOpenmode().write))
+		return invalid64_t;
+
+	mFilePos = pos;
+	setEOF(false);
+
+	return mFilePos;
+}
+
+int64_t MappedFile::tell(void)
+{
+	if(!isOpen())
+		return invalid64_t;
+
+	return mFilePos;
+}
+
+int64_t MappedFile::length(void)
+{
+	if(!isOpen())
+		return invalid64_t;
+
+	return mFileLength;
+}
+
+int64_t MappedFile::readAt(int64_t nOffset, void *oBuffer, int64_t nLen)
+{
+	if(!isOpen() || oBuffer == NULL || nOffset < 0 || nLen < 0)
+		return invalid64_t;
+
+	if(nOffset >= mFileLength)
+		return 0;
+
+	nLen = min(nLen, mFileLength - nOffset);
+	memcpy(oBuffer, &mMapping[nOffset], (size_t)nLen);
+
+	return nLen;
+}
+
+int64_t MappedFile::writeAt(int64_t nOffset, void const *oBuffer, int64_t nLen)
+{
+	if(!isOpen() || oBuffer == NULL || nOffset < 0 || nLen < 0 || !getOpenmode().write)
+		return invalid64_t;
+
+	// Growing the file remaps it, so this must not happen concurrently (see MappedFile.h).
+	int64_t end = nOffset + nLen;
+	if(end > mMappedLength)
+	{
+		int64_t size = max(end, max(mMappedLength * 2, MAPPING_GROWTH));
+		if(!map(size))
+			return invalid64_t;
+	}
+
+	memcpy(&mMapping[nOffset], oBuffer, (size_t)nLen);
+	if(end > mFileLength)
+		mFileLength = end;
+
+	return nLen;
+}
+
+int64_t MappedFile::readv(buffer_span const *oSpans, size_t nCount)
+{
+	if(!isOpen())
+		return invalid64_t;
+
+	int64_t total = 0;
+	for(size_t i = 0; i < nCount; i++)
+	{
+		int64_t rd = MappedFile::read(oSpans[i].Data, oSpans[i].Length);
+
+		total += rd;
+		if(rd < oSpans[i].Length)
+			break;
+	}
+
+	return total;
+}
+
+int64_t MappedFile::writev(const_buffer_span const *oSpans, size_t nCount)
+{
+	if(!isOpen())
+		return invalid64_t;
+
+	IFile::open_mode md = getOpenmode();
+	if(!md.write)
+		return invalid64_t;
+
+	if(md.append)
+		mFilePos = mFileLength;
+
+	// Grow only once for all buffers.
+	int64_t end = mFilePos;
+	for(size_t i = 0; i < nCount; i++)
+		end += oSpans[i].Length;
+
+	if(end > mMappedLength)
+	{
+		int64_t size = max(end, max(mMappedLength * 2, MAPPING_GROWTH));
+		if(!map(size))
+			return invalid64_t;
+	}
+
+	int64_t total = end - mFilePos;
+	for(size_t i = 0; i < nCount; i++)
+	{
+		memcpy(&mMapping[mFilePos], oSpans[i].Data, (size_t)oSpans[i].Length);
+		mFilePos += oSpans[i].Length;
+	}
+
+	if(mFilePos > mFileLength)
+		mFileLength = mFilePos;
+
+	return total;
+}
+
+const char *MappedFile::peek(int64_t nMinBytes, int64_t &nAvailable)
+{
+	UNUSED(nMinBytes);
+
+	nAvailable = 0;
+	if(!isOpen() || mFilePos >= mFileLength)
+		return NULL;
+
+	// The whole rest of the file is available.
+	nAvailable = mFileLength - mFilePos;
+
+	return &mMapping[mFilePos];
+}
+
+int64_t MappedFile::consume(int64_t nBytes)
+{
+	if(!isOpen())
+		return invalid64_t;
+
+	nBytes = max((int64_t)0, min(nBytes, mFileLength - mFilePos));
+	mFilePos += nBytes;
+
+	return nBytes;
+}
+
+int MappedFile::getChar(void)
+{
+	if(!isOpen() || mFilePos >= mFileLength)
+	{
+		setEOF();
+		return EOF;
+	}
+
+	return (unsigned char)mMapping[mFilePos++];
+}
+
+}
+
+}
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstring>
 
 #include "toolslib/files/MemoryFile.h"
 
@@ -9,11 +11,26 @@ namespace files
 
 using namespace std;
 
+const int64_t MemoryFile::chunk_size;
+
 MemoryFile::MemoryFile(Filename const &oFilename)
 	: super(oFilename)
-	, mFilePos(-1)
-	, mEndPos(0)
 {
+	init();
+}
+
+MemoryFile::MemoryFile(vector<uint8_t> &&oData, Filename const &oFilename)
+	: super(oFilename)
+{
+	init();
+	adopt(move(oData));
+}
+
+MemoryFile::MemoryFile(void const *pData, int64_t nLength, Filename const &oFilename)
+	: super(oFilename)
+{
+	init();
+	wrap(pData, nLength);
 }
 
 MemoryFile::~MemoryFile(void)
@@ -21,24 +38,286 @@ MemoryFile::~MemoryFile(void)
 	close();
 }
 
+void MemoryFile::init(void)
+{
+	mStorage = make_shared<storage_t>();
+	mStorage->Head = NULL;
+	mStorage->HeadSize = 0;
+	mStorage->Length = 0;
+	mStorage->Wrapped = false;
+
+	mFilePos = invalid64_t;
+	mEndPos = 0;
+	mSnapshot = false;
+}
+
+void MemoryFile::setHead(shared_ptr<vector<uint8_t>> const &oHead)
+{
+	storage_t &st = *mStorage;
+
+	st.HeadMem = oHead;
+	st.Head = (oHead && !oHead->empty()) ? &(*oHead)[0] : NULL;
+	st.HeadSize = (oHead) ? oHead->size() : 0;
+}
+
+MemoryFile::storage_t &MemoryFile::writable(void)
+{
+	if (mStorage.use_count() > 1)
+		mStorage = make_shared<storage_t>(*mStorage);
+
+	return *mStorage;
+}
+
+uint8_t *MemoryFile::locateWritable(int64_t nOffset, int64_t &nAvailable)
+{
+	storage_t &st = writable();
+
+	if (nOffset < st.HeadSize)
+	{
+		if (st.HeadMem.use_count() > 1)
+			setHead(make_shared<vector<uint8_t>>(*st.HeadMem));
+	}
+	else
+	{
+		shared_ptr<uint8_t> &chunk = st.Chunks[(size_t)((nOffset - st.HeadSize) / chunk_size)];
+		if (chunk.use_count() > 1)
+		{
+			shared_ptr<uint8_t> copy(new uint8_t[(size_t)chunk_size], default_delete<uint8_t[]>());
+			memcpy(copy.get(), chunk.get(), (size_t)chunk_size);
+			chunk = copy;
+		}
+	}
+
+	return const_cast<uint8_t *>(locate(nOffset, nAvailable));
+}
+
+unique_ptr<MemoryFile> MemoryFile::snapshot(void) const
+{
+	unique_ptr<MemoryFile> file(new MemoryFile(getFilename()));
+
+	file->mStorage = mStorage;
+	file->mSnapshot = true;
+	file->open(IFile::open_default);
+
+	return file;
+}
+
+void MemoryFile::adopt(vector<uint8_t> &&oData)
+{
+	if (mSnapshot)
+		return;
+
+	init();
+	setHead(make_shared<vector<uint8_t>>(move(oData)));
+	mStorage->Length = mStorage->HeadSize;
+
+	if (isOpen())
+		seek(0, IFile::set);
+}
+
+void MemoryFile::wrap(void const *pData, int64_t nLength)
+{
+	if (mSnapshot)
+		return;
+
+	int64_t pos = mFilePos;
+	init();
+	mFilePos = pos;
+
+	storage_t &st = *mStorage;
+	st.Head = static_cast<uint8_t *>(const_cast<void *>(pData));
+	st.HeadSize = nLength;
+	st.Length = nLength;
+	st.Wrapped = true;
+
+	if (isOpen())
+		seek(0, IFile::set);
+}
+
+vector<uint8_t> MemoryFile::release(void)
+{
+	vector<uint8_t> data;
+	if (mSnapshot)
+		return data;
+
+	if (mStorage->Wrapped)
+		data.assign(mStorage->Head, mStorage->Head + mStorage->Length);
+	else
+	{
+		contiguous();
+
+		// Shared memory has to stay where it is.
+		if (mStorage->HeadMem && mStorage->HeadMem.use_count() == 1 && mStorage.use_count() == 1)
+		{
+			mStorage->HeadMem->resize((size_t)mStorage->Length);
+			data.swap(*mStorage->HeadMem);
+		}
+		else if (mStorage->Length)
+			data.assign(mStorage->Head, mStorage->Head + mStorage->Length);
+	}
+
+	int64_t pos = mFilePos;
+	init();
+	mFilePos = pos;
+
+	if (isOpen())
+		seek(0, IFile::set);
+
+	return data;
+}
+
 void MemoryFile::reserve(int64_t nLen)
 {
-	mFileMem.reserve((size_t)nLen);
+	if (!isReadOnly())
+		allocate(nLen);
 }
 
 void MemoryFile::resize(int64_t nLen)
 {
-	mFileMem.resize((size_t)nLen);
+	if (mSnapshot)
+		return;
+
+	// The foreign buffer can only be made shorter.
+	storage_t &st = writable();
+	if (st.Wrapped)
+	{
+		st.Length = min(st.Length, max(nLen, (int64_t)0));
+		return;
+	}
+
+	if (nLen >= st.Length)
+	{
+		extend(nLen, nLen);
+		return;
+	}
+
+	// Chunks which are completely beyond the end are released.
+	size_t chunks = 0;
+	if (nLen > st.HeadSize)
+		chunks = (size_t)((nLen - st.HeadSize + chunk_size - 1) / chunk_size);
+
+	st.Chunks.resize(chunks);
+	st.Length = nLen;
+}
+
+void MemoryFile::allocate(int64_t nLength)
+{
+	storage_t &st = writable();
+	if (nLength <= st.HeadSize + (int64_t)st.Chunks.size() * chunk_size)
+		return;
+
+	if (st.Chunks.empty())
+	{
+		// A shared head is copied anyway, so it can be resized while copying.
+		int64_t size = (nLength <= chunk_size) ? nLength : max(st.HeadSize, chunk_size);
+		if (size > st.HeadSize)
+		{
+			if (!st.HeadMem)
+				setHead(make_shared<vector<uint8_t>>((size_t)size));
+			else if (st.HeadMem.use_count() > 1)
+			{
+				shared_ptr<vector<uint8_t>> head = make_shared<vector<uint8_t>>((size_t)size);
+				memcpy(&(*head)[0], st.Head, (size_t)st.HeadSize);
+				setHead(head);
+			}
+			else
+			{
+				st.HeadMem->resize((size_t)size);
+				setHead(st.HeadMem);
+			}
+		}
+
+		// From here on the head doesn't grow anymore, so nothing is relocated later.
+		if (nLength <= chunk_size)
+			return;
+	}
+
+	while (st.HeadSize + (int64_t)st.Chunks.size() * chunk_size < nLength)
+		st.Chunks.emplace_back(new uint8_t[(size_t)chunk_size], default_delete<uint8_t[]>());
+}
+
+void MemoryFile::extend(int64_t nLength, int64_t nFill)
+{
+	if (nLength <= mStorage->Length)
+		return;
+
+	allocate(nLength);
+
+	// The space may contain old data from before a shrink, or it is uninitialized.
+	storage_t &st = writable();
+	int64_t pos = st.Length;
+	int64_t fill = min(nFill, nLength);
+	while (pos < fill)
+	{
+		int64_t avail;
+		uint8_t *p = locateWritable(pos, avail);
+		int64_t n = min(avail, fill - pos);
+
+		memset(p, 0, (size_t)n);
+		pos += n;
+	}
+
+	st.Length = nLength;
+}
+
+void MemoryFile::copyIn(int64_t nOffset, void const *oBuffer, int64_t nLen)
+{
+	uint8_t const *src = static_cast<uint8_t const *>(oBuffer);
+	while (nLen > 0)
+	{
+		int64_t avail;
+		uint8_t *p = locateWritable(nOffset, avail);
+		int64_t n = min(avail, nLen);
+
+		memcpy(p, src, (size_t)n);
+		src += n;
+		nOffset += n;
+		nLen -= n;
+	}
+}
+
+void MemoryFile::copyOut(int64_t nOffset, void *oBuffer, int64_t nLen) const
+{
+	uint8_t *dst = static_cast<uint8_t *>(oBuffer);
+	while (nLen > 0)
+	{
+		int64_t avail;
+		uint8_t const *p = locate(nOffset, avail);
+		int64_t n = min(avail, nLen);
+
+		memcpy(dst, p, (size_t)n);
+		dst += n;
+		nOffset += n;
+		nLen -= n;
+	}
+}
+
+const uint8_t *MemoryFile::contiguous(void)
+{
+	if (mStorage->Chunks.empty())
+		return mStorage->Head;
+
+	shared_ptr<vector<uint8_t>> flat = make_shared<vector<uint8_t>>((size_t)mStorage->Length);
+	copyOut(0, &(*flat)[0], mStorage->Length);
+
+	storage_t &st = writable();
+	st.Chunks.clear();
+	setHead(flat);
+
+	return st.Head;
 }
 
 bool MemoryFile::open(void)
 {
+	IFile::open_mode md = getOpenmode();
+	if (isReadOnly() && md.write)
+		return false;
+
 	super::open();
 	mFilePos = 0;
 
-	IFile::open_mode md = getOpenmode();
 	if (md.truncate)
-		mFileMem.resize(0);
+		resize(0);
 
 	return true;
 }
@@ -63,7 +342,7 @@ bool MemoryFile::isEOF(void) const
 	if (!isOpen())
 		return true;
 
-	if ((size_t)(mFilePos+mEndPos) > mFileMem.size())
+	if (mFilePos + mEndPos > mStorage->Length)
 		return true;
 
 	return false;
@@ -85,10 +364,10 @@ int64_t MemoryFile::seek(int64_t nOffset, IFile::seek_pos nPos)
 
 			if (mFilePos >= 0)
 			{
-				if ((size_t)mFilePos > mFileMem.size())
+				if (mFilePos > mStorage->Length)
 					mEndPos = 1;
 
-				mFilePos = mFileMem.size();
+				mFilePos = mStorage->Length;
 			}
 			else
 				mFilePos = 0;
@@ -104,10 +383,10 @@ int64_t MemoryFile::seek(int64_t nOffset, IFile::seek_pos nPos)
 
 			if (nOffset >= 0)
 			{
-				if ((size_t)mFilePos > mFileMem.size())
+				if (mFilePos > mStorage->Length)
 					mEndPos = 1;
 
-				mFilePos = mFileMem.size();
+				mFilePos = mStorage->Length;
 			}
 			else
 				mFilePos = 0;
@@ -116,7 +395,7 @@ int64_t MemoryFile::seek(int64_t nOffset, IFile::seek_pos nPos)
 
 		case IFile::end:
 		{
-			mFilePos = mFileMem.size() - nOffset;
+			mFilePos = mStorage->Length - nOffset;
 			mEndPos = 0;
 			if (mFilePos >= 0)
 				return mFilePos;
@@ -140,7 +419,7 @@ int64_t MemoryFile::tell(void)
 int64_t MemoryFile::length(void)
 {
 	if(isOpen())
-		return mFileMem.size();
+		return mStorage->Length;
 
 	return invalid64_t;
 }
@@ -155,11 +434,11 @@ int64_t MemoryFile::read(void *oBuffer, int64_t nLen)
 	int64_t pos = mFilePos;
 	mFilePos += end;
 
-	if ((size_t)mFilePos > mFileMem.size())
+	if (mFilePos > mStorage->Length)
 	{
-		mFilePos = mFileMem.size();
+		mFilePos = mStorage->Length;
 		mEndPos = 1;
-		end = mFileMem.size() - pos;
+		end = mStorage->Length - pos;
 	}
 	else
 		mEndPos = 0;
@@ -167,7 +446,7 @@ int64_t MemoryFile::read(void *oBuffer, int64_t nLen)
 	if (end <= 0)
 		return 0;
 
-	memcpy(oBuffer, &mFileMem[(size_t)pos], (size_t)end);
+	copyOut(pos, oBuffer, (int64_t)end);
 
 	return end;
 }
@@ -178,7 +457,7 @@ int64_t MemoryFile::write(const void *oBuffer, int64_t nLen)
 		return invalid64_t;
 
 	IFile::open_mode md = getOpenmode();
-	if(!md.write)
+	if(!md.write || isReadOnly())
 		return invalid64_t;
 
 	if (md.append)
@@ -186,25 +465,140 @@ int64_t MemoryFile::write(const void *oBuffer, int64_t nLen)
 
 	uint64_t end = (uint64_t)nLen;
 
-	if ((size_t)mFilePos + end > mFileMem.size())
-		mFileMem.resize((size_t)(mFilePos + end));
-
-	memcpy(&mFileMem[(size_t)mFilePos], oBuffer, (size_t)end);
+	extend(mFilePos + end, mFilePos);
+	copyIn(mFilePos, oBuffer, (int64_t)end);
 	mFilePos += end;
 	mEndPos = 0;
 
 	return end;
 }
 
-int MemoryFile::getChar(void)
+int64_t MemoryFile::readAt(int64_t nOffset, void *oBuffer, int64_t nLen)
+{
+	if (!isOpen() || nOffset < 0)
+		return invalid64_t;
+
+	if (nOffset >= mStorage->Length)
+		return 0;
+
+	int64_t end = mStorage->Length - nOffset;
+	if (nLen < end)
+		end = nLen;
+
+	copyOut(nOffset, oBuffer, end);
+
+	return end;
+}
+
+int64_t MemoryFile::writeAt(int64_t nOffset, void const *oBuffer, int64_t nLen)
+{
+	if (!isOpen() || nOffset < 0)
+		return invalid64_t;
+
+	if(!getOpenmode().write || isReadOnly())
+		return invalid64_t;
+
+	// Growing the file changes the list of chunks, so this must not happen concurrently.
+	extend(nOffset + nLen, nOffset);
+	copyIn(nOffset, oBuffer, nLen);
+
+	return nLen;
+}
+
+int64_t MemoryFile::readv(buffer_span const *oSpans, size_t nCount)
 {
 	if (!isOpen())
 		return invalid64_t;
 
-	if(!isEOF())
-		return (int)mFileMem[(size_t)mFilePos];
+	int64_t total = 0;
+	for (size_t i = 0; i < nCount; i++)
+	{
+		int64_t rd = MemoryFile::read(oSpans[i].Data, oSpans[i].Length);
+
+		total += rd;
+		if (rd < oSpans[i].Length)
+			break;
+	}
+
+	return total;
+}
+
+int64_t MemoryFile::writev(const_buffer_span const *oSpans, size_t nCount)
+{
+	if (!isOpen())
+		return invalid64_t;
+
+	IFile::open_mode md = getOpenmode();
+	if(!md.write || isReadOnly())
+		return invalid64_t;
+
+	if (md.append)
+		seek(0, end);
+
+	// Grow only once for all buffers.
+	int64_t total = 0;
+	for (size_t i = 0; i < nCount; i++)
+		total += oSpans[i].Length;
+
+	extend(mFilePos + total, mFilePos);
+
+	for (size_t i = 0; i < nCount; i++)
+	{
+		copyIn(mFilePos, oSpans[i].Data, oSpans[i].Length);
+		mFilePos += oSpans[i].Length;
+	}
+
+	mEndPos = 0;
+
+	return total;
+}
+
+const char *MemoryFile::peek(int64_t nMinBytes, int64_t &nAvailable)
+{
+	UNUSED(nMinBytes);
+
+	nAvailable = 0;
+	if (!isOpen() || mFilePos >= mStorage->Length)
+		return NULL;
+
+	// The rest of the segment is available.
+	int64_t avail;
+	const uint8_t *p = locate(mFilePos, avail);
+	nAvailable = min(avail, mStorage->Length - mFilePos);
+
+	return reinterpret_cast<const char *>(p);
+}
+
+int64_t MemoryFile::consume(int64_t nBytes)
+{
+	if (!isOpen())
+		return invalid64_t;
+
+	int64_t avail = mStorage->Length - mFilePos;
+	if (nBytes > avail)
+		nBytes = avail;
+
+	mFilePos += nBytes;
+	mEndPos = 0;
+
+	return nBytes;
+}
+
+int MemoryFile::getChar(void)
+{
+	if (!isOpen())
+		return EOF;
+
+	if(mFilePos >= mStorage->Length)
+	{
+		mEndPos = 1;
+		return EOF;
+	}
+
+	mEndPos = 0;
 
-	return 0;
+	int64_t avail;
+	return *locate(mFilePos++, avail);
 }
 
 }
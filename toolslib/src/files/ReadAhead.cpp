@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <cstring>
+
+#include "toolslib/files/ReadAhead.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+using namespace std;
+
+const size_t ReadAhead::default_depth;
+const size_t ReadAhead::default_chunk_size;
+
+ReadAhead::ReadAhead(sysio::handle_t nHandle, int64_t nPosition, size_t nDepth, size_t nChunkSize, bool bDropBehind)
+: mHandle(nHandle)
+, mChunks(max(nDepth, (size_t)1))
+, mHead(0)
+, mFilled(0)
+, mHeadOffset(0)
+, mPosition(nPosition)
+, mFetchPosition(nPosition)
+, mGeneration(0)
+, mFetchEnd(false)
+, mFetchError(false)
+, mEOF(false)
+, mStop(false)
+, mDropBehind(bDropBehind)
+{
+	for(chunk_t &chunk : mChunks)
+	{
+		chunk.Data.resize(max(nChunkSize, (size_t)4096));
+		chunk.Length = 0;
+	}
+
+	mThread = thread(&ReadAhead::run, this);
+}
+
+ReadAhead::~ReadAhead(void)
+{
+	{
+		lock_guard<mutex> lock(mLock);
+		mStop = true;
+	}
+
+	mDrainedSignal.notify_all();
+	mThread.join();
+}
+
+void ReadAhead::run(void)
+{
+	unique_lock<mutex> lock(mLock);
+
+	while(!mStop)
+	{
+		if(mFetchEnd || mFilled == mChunks.size())
+		{
+			mDrainedSignal.wait(lock);
+			continue;
+		}
+
+		// The slot behind the filled chunks is never touched by the consumer, so
+		// it can be filled without holding the lock.
+		chunk_t &chunk = mChunks[(mHead + mFilled) % mChunks.size()];
+		int64_t position = mFetchPosition;
+		uint64_t generation = mGeneration;
+
+		lock.unlock();
+		int64_t rd = sysio::readAt(mHandle, position, &chunk.Data[0], (int64_t)chunk.Data.size());
+		if(mDropBehind && rd > 0)
+			sysio::dropCache(mHandle, position, rd);
+		lock.lock();
+
+		if(generation != mGeneration)
+			continue;
+
+		if(rd < 0)
+		{
+			mFetchError = true;
+			mFetchEnd = true;
+		}
+		else
+		{
+			if(rd > 0)
+			{
+				chunk.Length = rd;
+				mFilled++;
+				mFetchPosition += rd;
+			}
+
+			if(rd < (int64_t)chunk.Data.size())
+				mFetchEnd = true;
+		}
+
+		mFilledSignal.notify_one();
+	}
+}
+
+int64_t ReadAhead::read(void *oBuffer, int64_t nLen)
+{
+	char *p = static_cast<char *>(oBuffer);
+	int64_t total = 0;
+
+	unique_lock<mutex> lock(mLock);
+	while(total < nLen)
+	{
+		if(!mFilled)
+		{
+			if(mFetchEnd)
+			{
+				mEOF = true;
+				if(mFetchError && !total)
+					return invalid64_t;
+
+				break;
+			}
+
+			mFilledSignal.wait(lock);
+			continue;
+		}
+
+		// The thread doesn't touch filled chunks, so we can copy without the lock.
+		chunk_t &chunk = mChunks[mHead];
+		int64_t n = min(chunk.Length - mHeadOffset, nLen - total);
+
+		lock.unlock();
+		memcpy(&p[total], &chunk.Data[(size_t)mHeadOffset], (size_t)n);
+		lock.lock();
+
+		total += n;
+		mPosition += n;
+		mHeadOffset += n;
+		if(mHeadOffset == chunk.Length)
+		{
+			mHead = (mHead + 1) % mChunks.size();
+			mFilled--;
+			mHeadOffset = 0;
+			mDrainedSignal.notify_one();
+		}
+	}
+
+	return total;
+}
+
+void ReadAhead::seek(int64_t nPosition)
+{
+	unique_lock<mutex> lock(mLock);
+
+	mEOF = false;
+
+	// Skipping forward within the prefetched data keeps the ring.
+	if(nPosition >= mPosition)
+	{
+		int64_t skip = nPosition - mPosition;
+		while(mFilled)
+		{
+			chunk_t &chunk = mChunks[mHead];
+			int64_t n = min(chunk.Length - mHeadOffset, skip);
+
+			skip -= n;
+			mHeadOffset += n;
+			mPosition += n;
+			if(mHeadOffset < chunk.Length)
+				break;
+
+			mHead = (mHead + 1) % mChunks.size();
+			mFilled--;
+			mHeadOffset = 0;
+		}
+
+		if(!skip && (mFilled || mFetchPosition == nPosition))
+		{
+			mDrainedSignal.notify_one();
+			return;
+		}
+	}
+
+	mGeneration++;
+	mFilled = 0;
+	mHeadOffset = 0;
+	mPosition = nPosition;
+	mFetchPosition = nPosition;
+	mFetchEnd = false;
+	mFetchError = false;
+
+	mDrainedSignal.notify_one();
+}
+
+}
+
+}
@@ -0,0 +1,597 @@
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/sendfile.h>
+#endif
+#endif
+
+#include <algorithm>
+#include <climits>
+#include <vector>
+
+#include "toolslib/files/SystemIO.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+namespace sysio
+{
+
+using namespace std;
+
+// Largest single transfer, which is accepted by all platforms.
+static const int64_t MAX_TRANSFER = 1024*1024*1024;
+
+#ifdef _WIN32
+
+handle_t openFile(string const &oPath, IFile::open_mode const &oMode, bool bUnbuffered)
+{
+	DWORD access = GENERIC_READ;
+	if(oMode.write)
+	{
+		access = GENERIC_WRITE;
+		if(oMode.read)
+			access |= GENERIC_READ;
+	}
+
+	bool create = oMode.create || (oMode.write && oMode.truncate);
+	DWORD disposition = OPEN_EXISTING;
+	if(create)
+		disposition = (oMode.truncate) ? CREATE_ALWAYS : OPEN_ALWAYS;
+	else if(oMode.truncate)
+		disposition = TRUNCATE_EXISTING;
+
+	DWORD flags = FILE_ATTRIBUTE_NORMAL;
+	if(oMode.random)
+		flags |= FILE_FLAG_RANDOM_ACCESS;
+	else if(oMode.sequential || oMode.dontneed)
+		flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+
+	if(bUnbuffered)
+		flags |= FILE_FLAG_NO_BUFFERING;
+
+	HANDLE h = CreateFileA(oPath.c_str(), access, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, disposition, flags, NULL);
+
+	return (handle_t)h;
+}
+
+void adviseFile(handle_t nHandle, IFile::open_mode const &oMode)
+{
+	UNUSED(nHandle);
+	UNUSED(oMode);
+}
+
+void dropCache(handle_t nHandle, int64_t nOffset, int64_t nLength)
+{
+	UNUSED(nHandle);
+	UNUSED(nOffset);
+	UNUSED(nLength);
+}
+
+void closeFile(handle_t nHandle)
+{
+	if(nHandle != invalid_handle)
+		CloseHandle((HANDLE)nHandle);
+}
+
+int64_t readAt(handle_t nHandle, int64_t nOffset, void *oBuffer, int64_t nLen)
+{
+	char *p = static_cast<char *>(oBuffer);
+	int64_t total = 0;
+
+	while(total < nLen)
+	{
+		OVERLAPPED ov = { 0 };
+		int64_t pos = nOffset + total;
+		ov.Offset = (DWORD)(pos & 0xffffffff);
+		ov.OffsetHigh = (DWORD)(pos >> 32);
+
+		DWORD chunk = (DWORD)min(nLen - total, MAX_TRANSFER);
+		DWORD rd = 0;
+		if(!ReadFile((HANDLE)nHandle, &p[total], chunk, &rd, &ov))
+		{
+			if(GetLastError() == ERROR_HANDLE_EOF)
+				break;
+
+			return (total) ? total : invalid64_t;
+		}
+
+		if(rd == 0)
+			break;
+
+		total += rd;
+	}
+
+	return total;
+}
+
+int64_t writeAt(handle_t nHandle, int64_t nOffset, void const *oBuffer, int64_t nLen)
+{
+	const char *p = static_cast<const char *>(oBuffer);
+	int64_t total = 0;
+
+	while(total < nLen)
+	{
+		OVERLAPPED ov = { 0 };
+		int64_t pos = nOffset + total;
+		ov.Offset = (DWORD)(pos & 0xffffffff);
+		ov.OffsetHigh = (DWORD)(pos >> 32);
+
+		DWORD chunk = (DWORD)min(nLen - total, MAX_TRANSFER);
+		DWORD wr = 0;
+		if(!WriteFile((HANDLE)nHandle, &p[total], chunk, &wr, &ov))
+			return (total) ? total : invalid64_t;
+
+		total += wr;
+	}
+
+	return total;
+}
+
+int64_t readAt(handle_t nHandle, int64_t nOffset, IFile::buffer_span const *oSpans, size_t nCount)
+{
+	int64_t total = 0;
+
+	for(size_t i = 0; i < nCount; i++)
+	{
+		int64_t rd = readAt(nHandle, nOffset + total, oSpans[i].Data, oSpans[i].Length);
+		if(rd < 0)
+			return (total) ? total : invalid64_t;
+
+		total += rd;
+		if(rd < oSpans[i].Length)
+			break;
+	}
+
+	return total;
+}
+
+int64_t writeAt(handle_t nHandle, int64_t nOffset, IFile::const_buffer_span const *oSpans, size_t nCount)
+{
+	int64_t total = 0;
+
+	for(size_t i = 0; i < nCount; i++)
+	{
+		int64_t wr = writeAt(nHandle, nOffset + total, oSpans[i].Data, oSpans[i].Length);
+		if(wr < 0)
+			return (total) ? total : invalid64_t;
+
+		total += wr;
+		if(wr < oSpans[i].Length)
+			break;
+	}
+
+	return total;
+}
+
+int64_t fileSize(handle_t nHandle)
+{
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx((HANDLE)nHandle, &size))
+		return invalid64_t;
+
+	return size.QuadPart;
+}
+
+bool fileInfo(handle_t nHandle, int64_t &nLength, int64_t &nBlockSize)
+{
+	nLength = -1;
+	nBlockSize = -1;
+
+	if(GetFileType((HANDLE)nHandle) != FILE_TYPE_DISK)
+		return GetLastError() == NO_ERROR;
+
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx((HANDLE)nHandle, &size))
+		return false;
+
+	nLength = size.QuadPart;
+	return true;
+}
+
+bool truncateFile(handle_t nHandle, int64_t nLength)
+{
+	FILE_END_OF_FILE_INFO info;
+	info.EndOfFile.QuadPart = nLength;
+
+	return SetFileInformationByHandle((HANDLE)nHandle, FileEndOfFileInfo, &info, sizeof(info)) != 0;
+}
+
+bool findData(handle_t nHandle, int64_t nOffset, int64_t &nDataBegin, int64_t &nDataEnd)
+{
+	int64_t size = fileSize(nHandle);
+	if(size == invalid64_t || nOffset >= size)
+		return false;
+
+	nDataBegin = nOffset;
+	nDataEnd = size;
+
+	FILE_ALLOCATED_RANGE_BUFFER query;
+	FILE_ALLOCATED_RANGE_BUFFER range;
+	DWORD rd = 0;
+	query.FileOffset.QuadPart = nOffset;
+	query.Length.QuadPart = size - nOffset;
+
+	// Only the first range is of interest, so ERROR_MORE_DATA is fine.
+	if(!DeviceIoControl((HANDLE)nHandle, FSCTL_QUERY_ALLOCATED_RANGES, &query, sizeof(query), &range, sizeof(range), &rd, NULL) && GetLastError() != ERROR_MORE_DATA)
+		return true;
+
+	if(rd < sizeof(range))
+		return false;
+
+	nDataBegin = max(nOffset, (int64_t)range.FileOffset.QuadPart);
+	nDataEnd = min(size, (int64_t)(range.FileOffset.QuadPart + range.Length.QuadPart));
+
+	return true;
+}
+
+bool cloneFile(handle_t nSource, handle_t nTarget)
+{
+	UNUSED(nSource);
+	UNUSED(nTarget);
+
+	return false;
+}
+
+int64_t copyRange(handle_t nSource, int64_t nSourceOffset, handle_t nTarget, int64_t nTargetOffset, int64_t nLen)
+{
+	UNUSED(nSource);
+	UNUSED(nSourceOffset);
+	UNUSED(nTarget);
+	UNUSED(nTargetOffset);
+	UNUSED(nLen);
+
+	return invalid64_t;
+}
+
+#else
+
+handle_t openFile(string const &oPath, IFile::open_mode const &oMode, bool bUnbuffered)
+{
+	int flags = O_RDONLY;
+	if(oMode.write)
+		flags = (oMode.read) ? O_RDWR : O_WRONLY;
+
+	if(oMode.create || (oMode.write && oMode.truncate))
+		flags |= O_CREAT;
+	if(oMode.truncate)
+		flags |= O_TRUNC;
+
+#ifdef O_DIRECT
+	if(bUnbuffered)
+		flags |= O_DIRECT;
+#endif
+
+	int fd;
+	do
+	{
+		fd = ::open(oPath.c_str(), flags | O_CLOEXEC, 0666);
+	}
+	while(fd == -1 && errno == EINTR);
+
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+	if(fd != -1 && bUnbuffered)
+		fcntl(fd, F_NOCACHE, 1);
+#endif
+
+	if(fd != -1)
+		adviseFile(fd, oMode);
+
+	return fd;
+}
+
+void adviseFile(handle_t nHandle, IFile::open_mode const &oMode)
+{
+#ifdef POSIX_FADV_NORMAL
+	int fd = (int)nHandle;
+
+	// Random access disables the read-ahead of the kernel, sequential access doubles it.
+	if(oMode.random)
+		posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+	else if(oMode.sequential || oMode.dontneed)
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	if(oMode.dontneed)
+		posix_fadvise(fd, 0, 0, POSIX_FADV_NOREUSE);
+
+	if(oMode.willneed)
+		posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#else
+	UNUSED(nHandle);
+	UNUSED(oMode);
+#endif
+}
+
+void dropCache(handle_t nHandle, int64_t nOffset, int64_t nLength)
+{
+#ifdef POSIX_FADV_DONTNEED
+	posix_fadvise((int)nHandle, (off_t)nOffset, (off_t)nLength, POSIX_FADV_DONTNEED);
+#else
+	UNUSED(nHandle);
+	UNUSED(nOffset);
+	UNUSED(nLength);
+#endif
+}
+
+void closeFile(handle_t nHandle)
+{
+	if(nHandle != invalid_handle)
+		::close((int)nHandle);
+}
+
+int64_t readAt(handle_t nHandle, int64_t nOffset, void *oBuffer, int64_t nLen)
+{
+	char *p = static_cast<char *>(oBuffer);
+	int64_t total = 0;
+
+	while(total < nLen)
+	{
+		size_t chunk = (size_t)min(nLen - total, MAX_TRANSFER);
+		ssize_t rd = ::pread((int)nHandle, &p[total], chunk, (off_t)(nOffset + total));
+		if(rd < 0)
+		{
+			if(errno == EINTR)
+				continue;
+
+			return (total) ? total : invalid64_t;
+		}
+
+		if(rd == 0)
+			break;
+
+		total += rd;
+	}
+
+	return total;
+}
+
+int64_t writeAt(handle_t nHandle, int64_t nOffset, void const *oBuffer, int64_t nLen)
+{
+	const char *p = static_cast<const char *>(oBuffer);
+	int64_t total = 0;
+
+	while(total < nLen)
+	{
+		size_t chunk = (size_t)min(nLen - total, MAX_TRANSFER);
+		ssize_t wr = ::pwrite((int)nHandle, &p[total], chunk, (off_t)(nOffset + total));
+		if(wr < 0)
+		{
+			if(errno == EINTR)
+				continue;
+
+			return (total) ? total : invalid64_t;
+		}
+
+		total += wr;
+	}
+
+	return total;
+}
+
+/**
+ * Removes nBytes which were transferred from the front of the vector.
+ */
+static void consumeVector(vector<iovec> &oVector, size_t &nFirst, size_t nBytes)
+{
+	while(nFirst < oVector.size() && nBytes >= oVector[nFirst].iov_len)
+	{
+		nBytes -= oVector[nFirst].iov_len;
+		nFirst++;
+	}
+
+	if(nFirst < oVector.size())
+	{
+		oVector[nFirst].iov_base = static_cast<char *>(oVector[nFirst].iov_base) + nBytes;
+		oVector[nFirst].iov_len -= nBytes;
+	}
+}
+
+int64_t readAt(handle_t nHandle, int64_t nOffset, IFile::buffer_span const *oSpans, size_t nCount)
+{
+	vector<iovec> iov;
+	iov.reserve(nCount);
+	for(size_t i = 0; i < nCount; i++)
+	{
+		if(oSpans[i].Length > 0)
+			iov.push_back({ oSpans[i].Data, (size_t)oSpans[i].Length });
+	}
+
+	int64_t total = 0;
+	size_t first = 0;
+	while(first < iov.size())
+	{
+		int cnt = (int)min(iov.size() - first, (size_t)IOV_MAX);
+		ssize_t rd = ::preadv((int)nHandle, &iov[first], cnt, (off_t)(nOffset + total));
+		if(rd < 0)
+		{
+			if(errno == EINTR)
+				continue;
+
+			return (total) ? total : invalid64_t;
+		}
+
+		if(rd == 0)
+			break;
+
+		total += rd;
+		consumeVector(iov, first, (size_t)rd);
+	}
+
+	return total;
+}
+
+int64_t writeAt(handle_t nHandle, int64_t nOffset, IFile::const_buffer_span const *oSpans, size_t nCount)
+{
+	vector<iovec> iov;
+	iov.reserve(nCount);
+	for(size_t i = 0; i < nCount; i++)
+	{
+		if(oSpans[i].Length > 0)
+			iov.push_back({ const_cast<void *>(oSpans[i].Data), (size_t)oSpans[i].Length });
+	}
+
+	int64_t total = 0;
+	size_t first = 0;
+	while(first < iov.size())
+	{
+		int cnt = (int)min(iov.size() - first, (size_t)IOV_MAX);
+		ssize_t wr = ::pwritev((int)nHandle, &iov[first], cnt, (off_t)(nOffset + total));
+		if(wr < 0)
+		{
+			if(errno == EINTR)
+				continue;
+
+			return (total) ? total : invalid64_t;
+		}
+
+		total += wr;
+		consumeVector(iov, first, (size_t)wr);
+	}
+
+	return total;
+}
+
+int64_t fileSize(handle_t nHandle)
+{
+	struct stat st;
+	if(fstat((int)nHandle, &st) != 0)
+		return invalid64_t;
+
+	return st.st_size;
+}
+
+bool fileInfo(handle_t nHandle, int64_t &nLength, int64_t &nBlockSize)
+{
+	nLength = -1;
+	nBlockSize = -1;
+
+	struct stat st;
+	if(fstat((int)nHandle, &st) != 0)
+		return false;
+
+	nBlockSize = st.st_blksize;
+	if(S_ISREG(st.st_mode))
+		nLength = st.st_size;
+
+	return true;
+}
+
+bool truncateFile(handle_t nHandle, int64_t nLength)
+{
+	return ftruncate((int)nHandle, (off_t)nLength) == 0;
+}
+
+bool findData(handle_t nHandle, int64_t nOffset, int64_t &nDataBegin, int64_t &nDataEnd)
+{
+	int64_t size = fileSize(nHandle);
+	if(size == invalid64_t || nOffset >= size)
+		return false;
+
+	nDataBegin = nOffset;
+	nDataEnd = size;
+
+#ifdef SEEK_DATA
+	off_t begin = lseek((int)nHandle, (off_t)nOffset, SEEK_DATA);
+	if(begin < 0)
+	{
+		// ENXIO means that only a hole follows, otherwise the filesystem doesn't know.
+		return errno != ENXIO;
+	}
+
+	off_t end = lseek((int)nHandle, begin, SEEK_HOLE);
+	nDataBegin = begin;
+	if(end > begin)
+		nDataEnd = min(size, (int64_t)end);
+#endif
+
+	return nDataBegin < nDataEnd;
+}
+
+bool cloneFile(handle_t nSource, handle_t nTarget)
+{
+#ifdef FICLONE
+	return ioctl((int)nTarget, FICLONE, (int)nSource) == 0;
+#else
+	UNUSED(nSource);
+	UNUSED(nTarget);
+
+	return false;
+#endif
+}
+
+int64_t copyRange(handle_t nSource, int64_t nSourceOffset, handle_t nTarget, int64_t nTargetOffset, int64_t nLen)
+{
+#ifdef __linux__
+	int64_t total = 0;
+	bool sendFile = false;
+	while(total < nLen)
+	{
+		size_t chunk = (size_t)min(nLen - total, MAX_TRANSFER);
+		ssize_t n;
+		if(!sendFile)
+		{
+			loff_t in = nSourceOffset + total;
+			loff_t out = nTargetOffset + total;
+			n = copy_file_range((int)nSource, &in, (int)nTarget, &out, chunk, 0);
+		}
+		else
+		{
+			// sendfile() writes at the position of the target.
+			off_t in = nSourceOffset + total;
+			n = -1;
+			if(lseek((int)nTarget, nTargetOffset + total, SEEK_SET) >= 0)
+				n = sendfile((int)nTarget, (int)nSource, &in, chunk);
+		}
+
+		if(n < 0)
+		{
+			if(errno == EINTR)
+				continue;
+
+			// Older kernels can't copy across filesystems or don't have copy_file_range
+			// at all, so sendfile is tried for the rest.
+			if(!sendFile && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP))
+			{
+				sendFile = true;
+				continue;
+			}
+
+			return (total) ? total : invalid64_t;
+		}
+
+		if(n == 0)
+			break;
+
+		total += n;
+	}
+
+	return total;
+#else
+	UNUSED(nSource);
+	UNUSED(nSourceOffset);
+	UNUSED(nTarget);
+	UNUSED(nTargetOffset);
+	UNUSED(nLen);
+
+	return invalid64_t;
+#endif
+}
+
+#endif
+
+}
+
+}
+
+}
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <cstring>
+
+#include "toolslib/files/WriteBehind.h"
+
+namespace toolslib
+{
+
+namespace files
+{
+
+using namespace std;
+
+const size_t WriteBehind::default_depth;
+const size_t WriteBehind::default_buffer_size;
+
+WriteBehind::WriteBehind(sysio::handle_t nHandle, int64_t nPosition, size_t nDepth, size_t nBufferSize)
+: mHandle(nHandle)
+, mBuffers(max(nDepth, (size_t)2))
+, mHead(0)
+, mQueued(0)
+, mPosition(nPosition)
+, mError(false)
+, mStop(false)
+{
+	for(buffer_t &buffer : mBuffers)
+	{
+		buffer.Data.resize(max(nBufferSize, (size_t)4096));
+		buffer.Length = 0;
+		buffer.Position = nPosition;
+	}
+
+	mThread = thread(&WriteBehind::run, this);
+}
+
+WriteBehind::~WriteBehind(void)
+{
+	flush();
+
+	{
+		lock_guard<mutex> lock(mLock);
+		mStop = true;
+	}
+
+	mQueuedSignal.notify_all();
+	mThread.join();
+}
+
+void WriteBehind::run(void)
+{
+	vector<IFile::const_buffer_span> spans;
+	unique_lock<mutex> lock(mLock);
+
+	while(!mStop || mQueued)
+	{
+		if(!mQueued)
+		{
+			mQueuedSignal.wait(lock);
+			continue;
+		}
+
+		// Everything which is queued now goes out together, as long as the buffers
+		// are contiguous in the file. The producer only appends behind them.
+		size_t count = 0;
+		int64_t position = mBuffers[mHead].Position;
+		int64_t end = position;
+		spans.clear();
+		while(count < mQueued)
+		{
+			buffer_t &buffer = mBuffers[(mHead + count) % mBuffers.size()];
+			if(buffer.Position != end)
+				break;
+
+			spans.push_back({ &buffer.Data[0], buffer.Length });
+			end += buffer.Length;
+			count++;
+		}
+
+		lock.unlock();
+		int64_t wr = sysio::writeAt(mHandle, position, &spans[0], spans.size());
+		lock.lock();
+
+		if(wr != end - position)
+			mError = true;
+
+		mHead = (mHead + count) % mBuffers.size();
+		mQueued -= count;
+		mWrittenSignal.notify_all();
+	}
+}
+
+void WriteBehind::submit(unique_lock<mutex> &oLock)
+{
+	size_t current = (mHead + mQueued) % mBuffers.size();
+	if(mBuffers[current].Length == 0)
+		return;
+
+	mQueued++;
+	mQueuedSignal.notify_one();
+
+	// The next buffer must not be waiting for the thread.
+	while(mQueued == mBuffers.size())
+		mWrittenSignal.wait(oLock);
+
+	buffer_t &next = mBuffers[(mHead + mQueued) % mBuffers.size()];
+	next.Length = 0;
+	next.Position = mPosition;
+}
+
+int64_t WriteBehind::write(void const *oBuffer, int64_t nLen)
+{
+	char const *p = static_cast<char const *>(oBuffer);
+	int64_t total = 0;
+
+	unique_lock<mutex> lock(mLock);
+	if(mError)
+		return invalid64_t;
+
+	while(total < nLen)
+	{
+		// The current buffer belongs to the producer, so it can be filled without the lock.
+		buffer_t &buffer = mBuffers[(mHead + mQueued) % mBuffers.size()];
+		int64_t n = min((int64_t)buffer.Data.size() - buffer.Length, nLen - total);
+
+		lock.unlock();
+		memcpy(&buffer.Data[(size_t)buffer.Length], &p[total], (size_t)n);
+		lock.lock();
+
+		buffer.Length += n;
+		total += n;
+		mPosition += n;
+
+		if(buffer.Length == (int64_t)buffer.Data.size())
+			submit(lock);
+	}
+
+	return total;
+}
+
+bool WriteBehind::flush(void)
+{
+	unique_lock<mutex> lock(mLock);
+
+	submit(lock);
+	while(mQueued)
+		mWrittenSignal.wait(lock);
+
+	return !mError;
+}
+
+bool WriteBehind::hasError(void) const
+{
+	lock_guard<mutex> lock(mLock);
+
+	return mError;
+}
+
+bool WriteBehind::seek(int64_t nPosition)
+{
+	unique_lock<mutex> lock(mLock);
+
+	// Buffers are written in order, so the current one can simply start at the new position.
+	submit(lock);
+	mPosition = nPosition;
+	mBuffers[(mHead + mQueued) % mBuffers.size()].Position = nPosition;
+
+	return !mError;
+}
+
+}
+
+}
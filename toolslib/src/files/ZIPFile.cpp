@@ -46,6 +46,19 @@ ZipFile::~ZipFile(void)
 	close();
 }
 
+uint64_t ZipFile::proposeFileBufferSize(void)
+{
+	// The archive is read, not the file inside it.
+	return super::proposeFileBufferSize(getFilename().getBaseDir(), true);
+}
+
+char *ZipFile::allocateFileBuffer(int64_t nSize)
+{
+	UNUSED(nSize);
+
+	return NULL;
+}
+
 void ZipFile::setFilename(Filename const &oFilename)
 {
 	Filename f = oFilename;
@@ -120,7 +133,7 @@ bool ZipFile::open(void)
 		// from the archive.
 		unz_file_info64 file_info;
 		char filename[2001];
-		if (unzGetCurrentFileInfo64(mFileHandle, &file_info, filename, sizeof(filename), NULL, NULL, NULL, NULL) != UNZ_OK)
+		if (unzGetCurrentFileInfo64(mFileHandle, &file_info, filename, sizeof(filename), NULL, 0, NULL, 0) != UNZ_OK)
 		{
 			setIsOpen(false);
 			return false;
@@ -142,6 +155,9 @@ bool ZipFile::open(void)
 		return false;
 	}
 
+	uint64_t size = min<uint64_t>(getFileBufferSize(), UINT_MAX);
+	unzSetReadBufferSize(mFileHandle, (uInt)size);
+
 	// Open the current file inside the ZIP
 	if(unzOpenCurrentFile(mFileHandle) != UNZ_OK)
 	{
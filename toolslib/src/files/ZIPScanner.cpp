@@ -1,5 +1,3 @@
-#include <windows.h>
-
 #include <iostream>
 #include <algorithm>
 
@@ -66,7 +64,7 @@ FilenameScanner::ScanState ZIPScanner::scan(Filename const &oRoot)
 		if(!isDir)
 		{
 			// Create the full filename with the archive and the path inside the archive
-			if(Filename::matchesWildcard(Pattern().c_str(), file.c_str(), false, false))
+			if(Filename::matchesWildcard(Pattern().c_str(), file.c_str(), NULL, false, false))
 				Files().push_back(archive+file);
 		}
 	}
@@ -108,7 +106,7 @@ FilenameScanner::ScanState ZIPScanner::collectFiles(Filename const &oRoot, vecto
 	int rc = UNZ_OK;
 	while(rc == UNZ_OK)
 	{
-		if(unzGetCurrentFileInfo64(mFileHandle, &file_info, filename, sizeof(filename), NULL, NULL, NULL, NULL) != UNZ_OK)
+		if(unzGetCurrentFileInfo64(mFileHandle, &file_info, filename, sizeof(filename), NULL, 0, NULL, 0) != UNZ_OK)
 			return FilenameScanner::SS_ABORT;
 
 		// The pattern will likely be in DOS style but the ZIP contains internally Unix style
@@ -1,4 +1,11 @@
-#include <windows.h>
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#define strncasecmp _strnicmp
+#else
+#include <strings.h>
+#endif
 
 #include <toolslib/strings/Helpers.h>
 
@@ -22,7 +29,7 @@ size_t TOOLSLIB_API filter(std::vector<std::string> &oArray, std::string const &
 		if (bCaseSensitive)
 			match = std::equal(oFilter.begin(), oFilter.end(), oArray[i].begin());
 		else
-			match = _strnicmp(oArray[i].c_str(), oFilter.c_str(), l) == 0;
+			match = strncasecmp(oArray[i].c_str(), oFilter.c_str(), l) == 0;
 
 		if ((match && bExclude) || (!match && !bExclude))
 		{
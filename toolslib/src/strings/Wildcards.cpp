@@ -1,4 +1,6 @@
 
+#include <cstring>
+
 #include <toolslib/strings/Wildcards.h>
 
 namespace toolslib
@@ -29,22 +29,22 @@ namespace toolslib
 		}
 
 		// ******************************************************************************
-		int8_t TOOLSLIB_API fromDecimal<int8_t>(const char *str, const char *end, const char **pScanned)
+		template<> int8_t TOOLSLIB_API fromDecimal<int8_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strto8(str, end, pScanned, 10);
 		}
 
-		int16_t TOOLSLIB_API fromDecimal<int16_t>(const char *str, const char *end, const char **pScanned)
+		template<> int16_t TOOLSLIB_API fromDecimal<int16_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strto16(str, end, pScanned, 10);
 		}
 
-		int32_t TOOLSLIB_API fromDecimal<int32_t>(const char *str, const char *end, const char **pScanned)
+		template<> int32_t TOOLSLIB_API fromDecimal<int32_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strto32(str, end, pScanned, 10);
 		}
 
-		int64_t TOOLSLIB_API fromDecimal<int64_t>(const char *str, const char *end, const char **pScanned)
+		template<> int64_t TOOLSLIB_API fromDecimal<int64_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strto64(str, end, pScanned, 10);
 		}
@@ -71,126 +71,126 @@ namespace toolslib
 		}
 
 		// ******************************************************************************
-		uint8_t TOOLSLIB_API fromDecimal<uint8_t>(const char *str, const char *end, const char **pScanned)
+		template<> uint8_t TOOLSLIB_API fromDecimal<uint8_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strtou8(str, end, pScanned, 10, true);
 		}
 
-		uint16_t TOOLSLIB_API fromDecimal<uint16_t>(const char *str, const char *end, const char **pScanned)
+		template<> uint16_t TOOLSLIB_API fromDecimal<uint16_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strtou16(str, end, pScanned, 10, true);
 		}
 
-		uint32_t TOOLSLIB_API fromDecimal<uint32_t>(const char *str, const char *end, const char **pScanned)
+		template<> uint32_t TOOLSLIB_API fromDecimal<uint32_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strtou32(str, end, pScanned, 10, true);
 		}
 
-		uint64_t TOOLSLIB_API fromDecimal<uint64_t>(const char *str, const char *end, const char **pScanned)
+		template<> uint64_t TOOLSLIB_API fromDecimal<uint64_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strtou64(str, end, pScanned, 10, true);
 		}
 
-		uint8_t TOOLSLIB_API fromUnsignedDecimal<uint8_t>(const char *str, const char *end, const char **pScanned)
+		template<> uint8_t TOOLSLIB_API fromUnsignedDecimal<uint8_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strtou8(str, end, pScanned, 10, false);
 		}
 
-		uint16_t TOOLSLIB_API fromUnsignedDecimal<uint16_t>(const char *str, const char *end, const char **pScanned)
+		template<> uint16_t TOOLSLIB_API fromUnsignedDecimal<uint16_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strtou16(str, end, pScanned, 10, false);
 		}
 
-		uint32_t TOOLSLIB_API fromUnsignedDecimal<uint32_t>(const char *str, const char *end, const char **pScanned)
+		template<> uint32_t TOOLSLIB_API fromUnsignedDecimal<uint32_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strtou32(str, end, pScanned, 10, false);
 		}
 
-		uint64_t TOOLSLIB_API fromUnsignedDecimal<uint64_t>(const char *str, const char *end, const char **pScanned)
+		template<> uint64_t TOOLSLIB_API fromUnsignedDecimal<uint64_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strtou64(str, end, pScanned, 10, false);
 		}
 
 		// ******************************************************************************
-		int8_t TOOLSLIB_API fromHex<int8_t>(const char *str, const char *end, const char **pScanned)
+		template<> int8_t TOOLSLIB_API fromHex<int8_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strto8(str, end, pScanned, 16);
 		}
 
-		int16_t TOOLSLIB_API fromHex<int16_t>(const char *str, const char *end, const char **pScanned)
+		template<> int16_t TOOLSLIB_API fromHex<int16_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strto16(str, end, pScanned, 16);
 		}
 
-		int32_t TOOLSLIB_API fromHex<int32_t>(const char *str, const char *end, const char **pScanned)
+		template<> int32_t TOOLSLIB_API fromHex<int32_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strto32(str, end, pScanned, 16);
 		}
 
-		int64_t TOOLSLIB_API fromHex<int64_t>(const char *str, const char *end, const char **pScanned)
+		template<> int64_t TOOLSLIB_API fromHex<int64_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strto64(str, end, pScanned, 16);
 		}
 
 		// ******************************************************************************
-		uint8_t TOOLSLIB_API fromHex<uint8_t>(const char *str, const char *end, const char **pScanned)
+		template<> uint8_t TOOLSLIB_API fromHex<uint8_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strtou8(str, end, pScanned, 16, true);
 		}
 
-		uint16_t TOOLSLIB_API fromHex<uint16_t>(const char *str, const char *end, const char **pScanned)
+		template<> uint16_t TOOLSLIB_API fromHex<uint16_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strtou16(str, end, pScanned, 16, true);
 		}
 
-		uint32_t TOOLSLIB_API fromHex<uint32_t>(const char *str, const char *end, const char **pScanned)
+		template<> uint32_t TOOLSLIB_API fromHex<uint32_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strtou32(str, end, pScanned, 16, true);
 		}
 
-		uint64_t TOOLSLIB_API fromHex<uint64_t>(const char *str, const char *end, const char **pScanned)
+		template<> uint64_t TOOLSLIB_API fromHex<uint64_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strtou64(str, end, pScanned, 16, true);
 		}
 
 		// ******************************************************************************
-		int8_t TOOLSLIB_API fromBinary<int8_t>(const char *str, const char *end, const char **pScanned)
+		template<> int8_t TOOLSLIB_API fromBinary<int8_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strto8(str, end, pScanned, 2);
 		}
 
-		int16_t TOOLSLIB_API fromBinary<int16_t>(const char *str, const char *end, const char **pScanned)
+		template<> int16_t TOOLSLIB_API fromBinary<int16_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strto16(str, end, pScanned, 2);
 		}
 
-		int32_t TOOLSLIB_API fromBinary<int32_t>(const char *str, const char *end, const char **pScanned)
+		template<> int32_t TOOLSLIB_API fromBinary<int32_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strto32(str, end, pScanned, 2);
 		}
 
-		int64_t TOOLSLIB_API fromBinary<int64_t>(const char *str, const char *end, const char **pScanned)
+		template<> int64_t TOOLSLIB_API fromBinary<int64_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strto64(str, end, pScanned, 2);
 		}
 
 		// ******************************************************************************
-		uint8_t TOOLSLIB_API fromBinary<uint8_t>(const char *str, const char *end, const char **pScanned)
+		template<> uint8_t TOOLSLIB_API fromBinary<uint8_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strtou8(str, end, pScanned, 2, true);
 		}
 
-		uint16_t TOOLSLIB_API fromBinary<uint16_t>(const char *str, const char *end, const char **pScanned)
+		template<> uint16_t TOOLSLIB_API fromBinary<uint16_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strtou16(str, end, pScanned, 2, true);
 		}
 
-		uint32_t TOOLSLIB_API fromBinary<uint32_t>(const char *str, const char *end, const char **pScanned)
+		template<> uint32_t TOOLSLIB_API fromBinary<uint32_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strtou32(str, end, pScanned, 2, true);
 		}
 
-		uint64_t TOOLSLIB_API fromBinary<uint64_t>(const char *str, const char *end, const char **pScanned)
+		template<> uint64_t TOOLSLIB_API fromBinary<uint64_t>(const char *str, const char *end, const char **pScanned)
 		{
 			return strtou64(str, end, pScanned, 2, true);
 		}
@@ -0,0 +1,83 @@
+/*******************************************************************************
+ *
+ * ToolsLib (c) by Gerhard W. Gruber in 2014
+ *
+ ******************************************************************************/
+
+#include "toolslib/utils/CPUFeatures.h"
+
+#ifdef TOOLSLIB_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace toolslib
+{
+	namespace utils
+	{
+#ifdef TOOLSLIB_X86
+		static void cpuid(uint32_t nLeaf, uint32_t nSubLeaf, uint32_t oRegs[4])
+		{
+#ifdef _MSC_VER
+			int regs[4];
+			__cpuidex(regs, (int)nLeaf, (int)nSubLeaf);
+			for (int i = 0; i < 4; i++)
+				oRegs[i] = (uint32_t)regs[i];
+#else
+			__cpuid_count(nLeaf, nSubLeaf, oRegs[0], oRegs[1], oRegs[2], oRegs[3]);
+#endif
+		}
+
+		static uint64_t xgetbv(void)
+		{
+#ifdef _MSC_VER
+			return _xgetbv(0);
+#else
+			uint32_t eax, edx;
+			__asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+			return ((uint64_t)edx << 32) | eax;
+#endif
+		}
+#endif
+
+		CPUFeatures::CPUFeatures(void)
+		: mSSE2(false)
+		, mSSSE3(false)
+		, mSSE42(false)
+		, mPCLMUL(false)
+		, mAVX2(false)
+		{
+#ifdef TOOLSLIB_X86
+			uint32_t regs[4];
+
+			cpuid(0, 0, regs);
+			uint32_t maxLeaf = regs[0];
+			if (maxLeaf < 1)
+				return;
+
+			cpuid(1, 0, regs);
+			mSSE2 = (regs[3] & (1u << 26)) != 0;
+			mSSSE3 = (regs[2] & (1u << 9)) != 0;
+			mSSE42 = (regs[2] & (1u << 20)) != 0;
+			mPCLMUL = (regs[2] & (1u << 1)) != 0;
+
+			// AVX needs OSXSAVE and the OS must have enabled the XMM and YMM state.
+			bool avx = (regs[2] & (1u << 28)) != 0 && (regs[2] & (1u << 27)) != 0 && (xgetbv() & 0x6) == 0x6;
+			if (avx && maxLeaf >= 7)
+			{
+				cpuid(7, 0, regs);
+				mAVX2 = (regs[1] & (1u << 5)) != 0;
+			}
+#endif
+		}
+
+		CPUFeatures const &CPUFeatures::get(void)
+		{
+			static const CPUFeatures features;
+			return features;
+		}
+	}
+}